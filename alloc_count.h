@@ -0,0 +1,44 @@
+/*
+ * File: alloc_count.h
+ * Description: Header file for the heap allocation counters.
+ *
+ * The counters are kept by wrappers around malloc, calloc, realloc and free
+ * that the linker substitutes for the C library functions when a program is
+ * linked with `-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free`
+ * (ALLOC_WRAP in the makefile). `make bench` always links them in, and
+ * `make STATS=1` links them into the calculator and the test suite for the
+ * statistics. Only blocks allocated by the program's own objects are seen, not
+ * those allocated inside the C library (e.g. by getline). Sizes are the usable
+ * sizes of the blocks.
+ *
+ * Data Structures:
+ * - AllocCounts: Allocations, bytes allocated, bytes held and the most bytes held.
+ *
+ * Function Declarations:
+ * - void alloc_totals(AllocCounts *c): Counts of the whole process so far.
+ * - void alloc_thread(AllocCounts *c):
+ *     Counts of the calling thread so far. A thread that frees blocks allocated
+ *     by another one may hold a negative number of bytes.
+ * The bytes held and their peak are only tracked in the statistics build
+ * (APC_STATS); otherwise they stay 0.
+ * - void alloc_reset_peak(void): Restarts the peak of the calling thread at what it holds now.
+*/
+
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <stddef.h>
+
+typedef struct AllocCounts {
+    size_t count;           // Allocations, reallocations included
+    size_t bytes;           // Bytes allocated
+    long long live;         // Bytes held
+    long long peak;         // Most bytes held (for a thread, since alloc_reset_peak)
+} AllocCounts;
+
+// Function declarations
+void alloc_totals(AllocCounts *c);
+void alloc_thread(AllocCounts *c);
+void alloc_reset_peak(void);
+
+#endif // ALLOC_COUNT_H
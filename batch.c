@@ -0,0 +1,306 @@
+/*
+ * File: batch.c
+ * Description: Batch evaluation of an expression file on a pool of threads.
+ *
+ * The main thread splits the input into lines and appends them, a group at a
+ * time, to a fixed-size ring of jobs. Worker threads claim runs of consecutive
+ * jobs, parse and evaluate them with their own reusable expression trees and
+ * temporaries, and render the output: a decimal line or a binary record per
+ * input line. Since lines are evaluated out of order, batch lines cannot use
+ * variables.
+ * The main thread writes finished jobs strictly in input order and recycles
+ * their slots, so memory use is bounded by the ring size however long the
+ * input is.
+ *
+ * Memory-mapped input is handed to the workers as slices of the mapping, so
+ * lines are parsed in parallel without being copied. Input that cannot be
+ * mapped (e.g. a pipe) is read line by line into owned buffers.
+ *
+ * Functions:
+ * - int run_batch(const char *path, int threads, int width, const char *cache, int binary, FILE *out):
+ *     Evaluates every line of a file and writes the results in input order.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "batch.h"
+#include "bignum.h"
+#include "input.h"
+#include "expr.h"
+
+#define BATCH_RING_SIZE 4096    // Jobs in flight at once
+#define BATCH_MAX_CLAIM 64      // Most jobs a worker claims (and the reader queues) at a time
+
+// One input line and, once evaluated, its output
+typedef struct BatchJob {
+    const char *line;       // Expression text (without the newline)
+    size_t len;             // Length of `line`
+    char *owned;            // Storage of `line` for streamed input, NULL for mapped input
+    char *output;           // Rendered result (a line or a binary record), or NULL
+    char short_output[64];  // Storage for `output` when the result is short
+    size_t output_len;      // Length of `output`
+    const char *error;      // Static error message when `output` is NULL
+    int ok;                 // 1 if the expression was evaluated successfully
+    int done;               // Set by the worker once the job is complete
+} BatchJob;
+
+typedef struct Batch {
+    BatchJob jobs[BATCH_RING_SIZE];
+    size_t head;            // Oldest job not yet written
+    size_t next;            // Next job to hand to a worker
+    size_t tail;            // One past the newest job read
+    int finished;           // Set once the whole input has been read
+    int workers;            // Number of worker threads
+    int width;              // Fixed width in bits, or 0 for BigNums
+    const char *cache;      // Directory of the result cache, or NULL
+    int binary;             // 1 to write binary records instead of lines
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;  // Jobs were added or the input ended
+    pthread_cond_t job_done;    // A worker completed some jobs
+} Batch;
+
+// Parse, evaluate and render one job using the worker's reusable expression and temporaries
+static void batch_run_job(BatchJob *job, Expr *expr, ExprEnv *env, int binary) {
+    InputSource src;
+    const BigNum *r = &env->ans;
+
+    job->output = NULL;
+    job->ok = 0;
+    input_open_memory(&src, job->line, job->len);
+    if (input_read_expression(&src, expr) != 1) {
+        job->error = "Invalid Input Format.";
+        return;
+    }
+    if (expr->uses_variables) {
+        // Lines are evaluated out of order, so they cannot share variables
+        job->error = "Error: Variables are not supported in batch mode";
+        return;
+    }
+    if (!expr_evaluate(expr, env, &job->error)) {
+        return;
+    }
+    size_t size = binary ? bn_binary_size(r) : bn_decimal_size(r) + 1;
+    job->output = (size <= sizeof(job->short_output)) ? job->short_output : (char *)malloc(size);
+    if (job->output == NULL) {
+        job->error = "Error: Out of memory";
+        return;
+    }
+    if (binary) {
+        job->output_len = bn_to_binary(job->output, r);
+    } else {
+        job->output_len = bn_to_chars(job->output, r);
+        job->output[job->output_len++] = '\n';
+    }
+    job->ok = 1;
+}
+
+// Worker thread: claim runs of pending jobs until the input is exhausted
+static void *batch_worker(void *arg) {
+    Batch *batch = (Batch *)arg;
+    Expr expr;
+    ExprEnv env;
+    expr_init(&expr);
+    expr_env_init(&env);
+    expr_env_set_width(&env, batch->width);
+    expr_env_set_cache(&env, batch->cache);
+
+    pthread_mutex_lock(&batch->lock);
+    for (;;) {
+        while (batch->next == batch->tail && !batch->finished) {
+            pthread_cond_wait(&batch->work_ready, &batch->lock);
+        }
+        size_t pending = batch->tail - batch->next;
+        if (pending == 0) {
+            break; // Finished and nothing left to claim
+        }
+
+        // Claim a share of the pending jobs, leaving work for the other threads
+        size_t claim = pending / (2 * (size_t)batch->workers);
+        if (claim == 0) {
+            claim = 1;
+        } else if (claim > BATCH_MAX_CLAIM) {
+            claim = BATCH_MAX_CLAIM;
+        }
+        size_t first = batch->next;
+        batch->next += claim;
+        pthread_mutex_unlock(&batch->lock);
+
+        for (size_t i = first; i < first + claim; i++) {
+            batch_run_job(&batch->jobs[i % BATCH_RING_SIZE], &expr, &env, batch->binary);
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        for (size_t i = first; i < first + claim; i++) {
+            batch->jobs[i % BATCH_RING_SIZE].done = 1;
+        }
+        pthread_cond_signal(&batch->job_done);
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    expr_free(&expr);
+    expr_env_free(&env);
+    return NULL;
+}
+
+/*
+ * Write completed jobs in order, starting at the oldest. Called with the lock
+ * held; the lock is dropped while writing since only the main thread touches
+ * finished slots. With `wait` set, blocks until the oldest job is written.
+ */
+static int batch_write_ready(Batch *batch, FILE *out, int wait) {
+    int all_ok = 1;
+
+    while (batch->head < batch->tail) {
+        BatchJob *job = &batch->jobs[batch->head % BATCH_RING_SIZE];
+        if (!job->done) {
+            if (!wait) {
+                break;
+            }
+            pthread_cond_wait(&batch->job_done, &batch->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&batch->lock);
+        if (job->output != NULL) {
+            fwrite(job->output, 1, job->output_len, out);
+        } else {
+            // Binary output holds only records, so messages go to standard error
+            fprintf(batch->binary ? stderr : out, "%s\n", job->error);
+        }
+        all_ok = all_ok && job->ok;
+        if (job->output != job->short_output) {
+            free(job->output);
+        }
+        free(job->owned);
+        pthread_mutex_lock(&batch->lock);
+        batch->head++;
+        wait = 0; // One slot is free now
+    }
+    return all_ok;
+}
+
+// Fetch the next input line; returns 0 at the end of the input
+static int batch_next_line(InputSource *src, BatchJob *job) {
+    job->owned = NULL;
+    if (src->fp == NULL) {
+        // Mapped input: hand out a slice of the mapping
+        if (src->pos >= src->len) {
+            return 0;
+        }
+        const char *start = src->data + src->pos;
+        const char *newline = memchr(start, '\n', src->len - src->pos);
+        size_t len = (newline != NULL) ? (size_t)(newline - start) : src->len - src->pos;
+        job->line = start;
+        job->len = len;
+        src->pos += len + (newline != NULL);
+        return 1;
+    }
+
+    size_t size = 0;
+    ssize_t len = getline(&job->owned, &size, src->fp);
+    if (len < 0) {
+        free(job->owned);
+        job->owned = NULL;
+        return 0;
+    }
+    if (len > 0 && job->owned[len - 1] == '\n') {
+        len--;
+    }
+    job->line = job->owned;
+    job->len = (size_t)len;
+    return 1;
+}
+
+// Evaluate every line of a file on a pool of threads, writing results in input order
+int run_batch(const char *path, int threads, int width, const char *cache, int binary, FILE *out) {
+    InputSource src;
+    pthread_t *pool;
+    Batch *batch;
+    int all_ok = 1;
+    int started = 0;
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int)cpus : 1;
+    }
+    if (!input_open_file(&src, path)) {
+        return 0;
+    }
+    batch = (Batch *)calloc(1, sizeof(Batch));
+    pool = (pthread_t *)malloc((size_t)threads * sizeof(pthread_t));
+    if (batch == NULL || pool == NULL) {
+        printf("Error: Out of memory\n");
+        free(batch);
+        free(pool);
+        input_close(&src);
+        return 0;
+    }
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->work_ready, NULL);
+    pthread_cond_init(&batch->job_done, NULL);
+    batch->workers = threads;
+    batch->width = width;
+    batch->cache = cache;
+    batch->binary = binary;
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool[started], NULL, batch_worker, batch) == 0) {
+            started++;
+        }
+    }
+
+    if (started == 0) {
+        printf("Error: Cannot start worker threads\n");
+        all_ok = 0;
+    } else {
+        BatchJob group[BATCH_MAX_CLAIM];
+        int more = 1;
+        pthread_mutex_lock(&batch->lock);
+        while (more) {
+            // Read a group of lines without holding the lock
+            pthread_mutex_unlock(&batch->lock);
+            size_t count = 0;
+            while (count < BATCH_MAX_CLAIM && (more = batch_next_line(&src, &group[count]))) {
+                group[count].done = 0;
+                count++;
+            }
+            pthread_mutex_lock(&batch->lock);
+
+            // Make room in the ring, writing finished results along the way
+            all_ok = batch_write_ready(batch, out, 0) && all_ok;
+            while (BATCH_RING_SIZE - (batch->tail - batch->head) < count) {
+                all_ok = batch_write_ready(batch, out, 1) && all_ok;
+            }
+            for (size_t i = 0; i < count; i++) {
+                batch->jobs[batch->tail % BATCH_RING_SIZE] = group[i];
+                batch->tail++;
+            }
+            if (count > 0) {
+                pthread_cond_broadcast(&batch->work_ready);
+            }
+        }
+        batch->finished = 1;
+        pthread_cond_broadcast(&batch->work_ready);
+        while (batch->head < batch->tail) {
+            all_ok = batch_write_ready(batch, out, 1) && all_ok;
+        }
+        pthread_mutex_unlock(&batch->lock);
+    }
+
+    // Workers exit once the input is finished and every job has been claimed
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+
+    pthread_mutex_destroy(&batch->lock);
+    pthread_cond_destroy(&batch->work_ready);
+    pthread_cond_destroy(&batch->job_done);
+    free(batch);
+    free(pool);
+    input_close(&src);
+    fflush(out);
+    return all_ok;
+}
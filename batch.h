@@ -0,0 +1,29 @@
+/*
+ * File: batch.h
+ * Description: Header file for the non-interactive batch mode.
+ *
+ * Batch mode reads one expression per line (see `expr.h`; variables are not
+ * available) and evaluates the lines on a pool of worker threads. Results are written in input
+ * order, one line of output per line of input (a result or an error message),
+ * or one binary record (see `bignum.h`) per successful line.
+ *
+ * Function Declarations:
+ * - int run_batch(const char *path, int threads, int width, const char *cache, int binary, FILE *out):
+ *     Evaluates every line of the file at `path` with `threads` worker threads
+ *     (0 picks one per online CPU) and writes the results to `out`. A nonzero
+ *     `width` evaluates on fixed-width values (see `expr_env_set_width`), and
+ *     a non-NULL `cache` keeps large results in that directory (see
+ *     `cache.h`). With `binary` set, results are written as binary records
+ *     and error messages go to standard error.
+ *     Returns 1 if every line was evaluated successfully.
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+// Function declarations
+int run_batch(const char *path, int threads, int width, const char *cache, int binary, FILE *out);
+
+#endif // BATCH_H
@@ -0,0 +1,385 @@
+/*
+ * File: bench.c
+ * Description: Benchmark suite for the arithmetic, parsing and printing code.
+ *
+ * Each benchmark times one operation on random operands of a given size,
+ * repeating it until a minimum measuring time has passed, and reports the time
+ * per operation, the time per digit of the larger operand and the number of
+ * heap allocations (and bytes) per operation. Results are written as JSON so
+ * runs can be diffed or plotted.
+ *
+ * The operations are those behind the calculator's operators: addition,
+ * subtraction, multiplication, division, modulus, comparison and GCD on
+ * BigNums (the DList functions in `operations.c` are thin wrappers that convert
+ * to and from BigNums), plus decimal parsing and printing. Sizes run from 10 to
+ * 10^7 digits by powers of ten (GCD stops at 10^6), followed by unbalanced
+ * shapes such as 1,000,000 x 100 digits.
+ *
+ * With `--sweep NAME` the benchmark instead times a range of candidate values
+ * for one algorithm crossover threshold (karatsuba, toom3, ntt, newton or hgcd)
+ * over operand sizes around it and reports the fastest; this is how the
+ * defaults in `bn_mul.c`, `bn_div.c` and `bn_gcd.c` are chosen.
+ *
+ * Allocations are counted by the allocator wrappers of `alloc_count.c`, which
+ * the `bench` target always links in (`-Wl,--wrap=...`, see the makefile).
+ *
+ * Usage:
+ *   make bench
+ *   ./apc_bench [--max-digits N] [--min-time SECONDS] [--simd LEVEL] [--threads N]
+ *   ./apc_bench --sweep karatsuba|toom3|ntt|newton|hgcd
+ *
+ * Functions:
+ * - int main(int argc, char *argv[]): Parses options and runs the benchmarks.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bignum.h"
+#include "alloc_count.h"
+
+#define SWEEP_MAX 16            // Most candidates or sizes in one sweep
+
+// Allocations and bytes allocated so far, from the wrapped allocator
+static size_t allocations(size_t *bytes) {
+    AllocCounts heap;
+    alloc_totals(&heap);
+    *bytes = heap.bytes;
+    return heap.count;
+}
+
+// Operands and scratch shared by the benchmark bodies
+typedef struct BenchCase {
+    BigNum a, b, r;
+    char *text;             // Decimal form of a, for the parse benchmark
+    size_t text_len;
+    FILE *sink;             // /dev/null, for the print benchmark
+} BenchCase;
+
+typedef int (*BenchBody)(BenchCase *c);
+
+// Result of timing one body
+typedef struct BenchResult {
+    size_t reps;
+    double seconds;         // Per operation
+    double allocs;          // Allocations per operation
+    double bytes;           // Bytes allocated per operation
+} BenchResult;
+
+static double min_time = 0.2;
+static FILE *json;
+static int first_record = 1;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// A random number with exactly `digits` decimal digits
+static int random_number(BigNum *n, size_t digits) {
+    size_t len = (digits + BN_BASE_DIGITS - 1) / BN_BASE_DIGITS;
+    size_t top_digits = digits - (len - 1) * BN_BASE_DIGITS;
+    limb_t top_limit = 1;
+
+    if (!bn_reserve(n, len)) {
+        return 0;
+    }
+    for (int i = 0; i < (int)top_digits; i++) {
+        top_limit *= 10;
+    }
+    for (size_t i = 0; i + 1 < len; i++) {
+        n->limbs[i] = (limb_t)(((uint64_t)rand() * RAND_MAX + rand()) % BN_BASE);
+    }
+    n->limbs[len - 1] = top_limit / 10 + (limb_t)rand() % (top_limit - top_limit / 10);
+    n->len = len;
+    return 1;
+}
+
+static int bench_add(BenchCase *c) { return bn_add(&c->r, &c->a, &c->b); }
+static int bench_sub(BenchCase *c) { return bn_sub(&c->r, &c->a, &c->b); }
+static int bench_mul(BenchCase *c) { return bn_mul(&c->r, &c->a, &c->b); }
+static int bench_div(BenchCase *c) { return bn_divmod(&c->r, NULL, &c->a, &c->b); }
+static int bench_mod(BenchCase *c) { return bn_divmod(NULL, &c->r, &c->a, &c->b); }
+static int bench_gcd(BenchCase *c) { return bn_gcd(&c->r, &c->a, &c->b); }
+static int bench_compare(BenchCase *c) { return bn_compare(&c->a, &c->b) == 0; }
+static int bench_parse(BenchCase *c) { return bn_from_string(&c->r, c->text, c->text_len); }
+static int bench_print(BenchCase *c) { return bn_print(c->sink, &c->a); }
+
+/*
+ * Run body until `limit` seconds have passed (at least once) and average the
+ * cost. Repetitions are timed in batches that double in size, so the clock is
+ * read rarely enough not to distort the fastest operations.
+ */
+static int time_body(BenchBody body, BenchCase *c, double limit, BenchResult *result) {
+    size_t reps = 0;
+    size_t batch = 1;
+    size_t bytes;
+    size_t count = allocations(&bytes);
+    double start = now();
+    double elapsed;
+
+    do {
+        for (size_t i = 0; i < batch; i++) {
+            if (!body(c)) {
+                return 0;
+            }
+        }
+        reps += batch;
+        batch *= 2;
+        elapsed = now() - start;
+    } while (elapsed < limit);
+
+    result->reps = reps;
+    result->seconds = elapsed / reps;
+    size_t end_bytes;
+    size_t end_count = allocations(&end_bytes);
+    result->allocs = (double)(end_count - count) / reps;
+    result->bytes = (double)(end_bytes - bytes) / reps;
+    return 1;
+}
+
+static void json_record_begin(void) {
+    fprintf(json, first_record ? "\n    " : ",\n    ");
+    first_record = 0;
+}
+
+// Time one operation on operands of the given sizes and write a JSON record
+static int run_benchmark(const char *name, BenchBody body, size_t digits_a, size_t digits_b) {
+    BenchCase c;
+    BenchResult result;
+    int status;
+
+    bn_init(&c.a);
+    bn_init(&c.b);
+    bn_init(&c.r);
+    c.text = NULL;
+    c.sink = NULL;
+
+    status = random_number(&c.a, digits_a) && random_number(&c.b, digits_b);
+    if (status && body == bench_sub && bn_compare(&c.a, &c.b) < 0) {
+        bn_swap(&c.a, &c.b);
+    }
+    if (status && body == bench_compare) {
+        status = bn_copy(&c.b, &c.a); // Equal operands: the whole number is scanned
+    }
+    if (status && body == bench_parse) {
+        c.text = (char *)malloc(bn_decimal_size(&c.a));
+        status = (c.text != NULL);
+        if (status) {
+            c.text_len = bn_to_chars(c.text, &c.a);
+        }
+    }
+    if (status && body == bench_print) {
+        c.sink = fopen("/dev/null", "w");
+        status = (c.sink != NULL);
+    }
+    status = status && time_body(body, &c, min_time, &result);
+
+    if (status) {
+        size_t digits = (digits_a > digits_b) ? digits_a : digits_b;
+        json_record_begin();
+        fprintf(json, "{\"op\": \"%s\", \"digits_a\": %zu, \"digits_b\": %zu, \"reps\": %zu, "
+                      "\"ns_per_op\": %.1f, \"ns_per_digit\": %.4f, \"allocs_per_op\": %.2f, "
+                      "\"bytes_per_op\": %.0f}",
+                name, digits_a, digits_b, result.reps, result.seconds * 1e9,
+                result.seconds * 1e9 / digits, result.allocs, result.bytes);
+        fflush(json);
+        fprintf(stderr, "%-10s %9zu x %-9zu %14.1f ns  %9.3f ns/digit  %8.2f allocs\n",
+                name, digits_a, digits_b, result.seconds * 1e9, result.seconds * 1e9 / digits,
+                result.allocs);
+    } else {
+        fprintf(stderr, "%-10s %9zu x %-9zu failed\n", name, digits_a, digits_b);
+    }
+
+    if (c.sink != NULL) {
+        fclose(c.sink);
+    }
+    free(c.text);
+    bn_free(&c.a);
+    bn_free(&c.b);
+    bn_free(&c.r);
+    return status;
+}
+
+// The full suite: every operation over sizes from 10 digits up to max_digits
+static int run_suite(size_t max_digits) {
+    int status = 1;
+
+    fprintf(json, "  \"results\": [");
+    for (size_t d = 10; d <= max_digits; d *= 10) {
+        status = run_benchmark("add", bench_add, d, d) && status;
+        status = run_benchmark("sub", bench_sub, d, d) && status;
+        status = run_benchmark("mul", bench_mul, d, d) && status;
+        status = run_benchmark("div", bench_div, 2 * d, d) && status;
+        status = run_benchmark("mod", bench_mod, 2 * d, d) && status;
+        if (d <= 1000000) {
+            status = run_benchmark("gcd", bench_gcd, d, d) && status;
+        }
+        status = run_benchmark("compare", bench_compare, d, d) && status;
+        status = run_benchmark("parse", bench_parse, d, d) && status;
+        status = run_benchmark("print", bench_print, d, d) && status;
+    }
+
+    // Unbalanced shapes
+    static const size_t shapes[][2] = { { 1000000, 100 }, { 1000000, 10000 }, { 100000, 1000 } };
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        if (shapes[i][0] <= max_digits) {
+            status = run_benchmark("mul", bench_mul, shapes[i][0], shapes[i][1]) && status;
+            status = run_benchmark("div", bench_div, shapes[i][0], shapes[i][1]) && status;
+        }
+    }
+    fprintf(json, "\n  ]\n");
+    return status;
+}
+
+// Sweep description: the threshold variable, candidates and operand sizes (in limbs)
+typedef struct Sweep {
+    const char *name;
+    size_t *threshold;
+    BenchBody body;
+    int dividend_twice;     // Division: dividend has twice the limbs of the divisor
+    size_t candidates[SWEEP_MAX];
+    size_t sizes[SWEEP_MAX];
+} Sweep;
+
+/*
+ * Time every candidate value of a threshold on every size. A candidate's score
+ * is the sum over the sizes of its time divided by the best time for that
+ * size, so each size counts equally; the lowest score wins.
+ */
+static int run_sweep(Sweep *sweep) {
+    double times[SWEEP_MAX][SWEEP_MAX];
+    size_t saved = *sweep->threshold;
+    size_t nc = 0, ns = 0;
+
+    while (nc < SWEEP_MAX && sweep->candidates[nc] != 0) {
+        nc++;
+    }
+    while (ns < SWEEP_MAX && sweep->sizes[ns] != 0) {
+        ns++;
+    }
+
+    fprintf(json, "  \"sweep\": \"%s\",\n  \"default\": %zu,\n  \"results\": [", sweep->name, saved);
+    for (size_t s = 0; s < ns; s++) {
+        BenchCase c;
+        size_t limbs = sweep->sizes[s];
+        bn_init(&c.a);
+        bn_init(&c.b);
+        bn_init(&c.r);
+        int status = random_number(&c.a, (sweep->dividend_twice ? 2 : 1) * limbs * BN_BASE_DIGITS) &&
+                     random_number(&c.b, limbs * BN_BASE_DIGITS);
+        for (size_t k = 0; status && k < nc; k++) {
+            BenchResult result;
+            *sweep->threshold = sweep->candidates[k];
+            status = time_body(sweep->body, &c, min_time / 4, &result);
+            if (!status) {
+                break;
+            }
+            times[k][s] = result.seconds;
+            json_record_begin();
+            fprintf(json, "{\"threshold\": %zu, \"limbs\": %zu, \"ns_per_op\": %.1f}",
+                    sweep->candidates[k], limbs, result.seconds * 1e9);
+            fprintf(stderr, "%s=%-6zu %6zu limbs %14.1f ns\n", sweep->name, sweep->candidates[k],
+                    limbs, result.seconds * 1e9);
+        }
+        bn_free(&c.a);
+        bn_free(&c.b);
+        bn_free(&c.r);
+        if (!status) {
+            *sweep->threshold = saved;
+            return 0;
+        }
+    }
+    *sweep->threshold = saved;
+
+    size_t best = 0;
+    double best_score = 0;
+    for (size_t k = 0; k < nc; k++) {
+        double score = 0;
+        for (size_t s = 0; s < ns; s++) {
+            double fastest = times[0][s];
+            for (size_t j = 1; j < nc; j++) {
+                fastest = (times[j][s] < fastest) ? times[j][s] : fastest;
+            }
+            score += times[k][s] / fastest;
+        }
+        if (k == 0 || score < best_score) {
+            best = k;
+            best_score = score;
+        }
+    }
+    fprintf(json, "\n  ],\n  \"best\": %zu\n", sweep->candidates[best]);
+    fprintf(stderr, "best %s threshold: %zu (default %zu)\n", sweep->name, sweep->candidates[best], saved);
+    return 1;
+}
+
+static Sweep sweeps[] = {
+    { "karatsuba", &bn_karatsuba_threshold, bench_mul, 0,
+      { 8, 12, 16, 24, 32, 48, 64, 96 }, { 16, 24, 32, 48, 64, 96, 128, 192, 256 } },
+    { "toom3", &bn_toom3_threshold, bench_mul, 0,
+      { 60, 90, 120, 150, 200, 300, 400 }, { 100, 150, 200, 300, 400, 550 } },
+    { "ntt", &bn_ntt_threshold, bench_mul, 0,
+      { 200, 300, 400, 600, 900, 1200, 2000 }, { 300, 500, 800, 1200, 2000, 4000 } },
+    { "newton", &bn_newton_threshold, bench_div, 1,
+      { 200, 400, 600, 800, 1200, 2000, 4000 }, { 400, 800, 1200, 2000, 4000, 8000 } },
+    { "hgcd", &bn_hgcd_threshold, bench_gcd, 0,
+      { 16, 24, 32, 48, 64, 96, 128, 200 }, { 50, 100, 200, 300, 500, 800, 1200, 2000 } },
+};
+
+int main(int argc, char *argv[]) {
+    size_t max_digits = 10000000;
+    const char *sweep_name = NULL;
+    Sweep *sweep = NULL;
+    int threads = 1;
+    int status;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-digits") == 0 && i + 1 < argc) {
+            max_digits = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            bn_set_simd(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_name = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--max-digits N] [--min-time SECONDS] [--simd LEVEL] [--threads N] "
+                            "[--sweep karatsuba|toom3|ntt|newton|hgcd]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (sweep_name != NULL) {
+        for (size_t i = 0; i < sizeof(sweeps) / sizeof(sweeps[0]); i++) {
+            if (strcmp(sweeps[i].name, sweep_name) == 0) {
+                sweep = &sweeps[i];
+            }
+        }
+        if (sweep == NULL) {
+            fprintf(stderr, "Unknown sweep '%s'\n", sweep_name);
+            return EXIT_FAILURE;
+        }
+    }
+    bn_set_threads(threads);
+    srand(12345);
+    json = stdout;
+
+    fprintf(json, "{\n  \"simd_level\": %d,\n  \"threads\": %d,\n", bn_simd_level(), threads);
+    fprintf(json, "  \"thresholds\": {\"karatsuba\": %zu, \"toom3\": %zu, \"ntt\": %zu, \"newton\": %zu, "
+                  "\"hgcd\": %zu, \"parallel\": %zu},\n",
+            bn_karatsuba_threshold, bn_toom3_threshold, bn_ntt_threshold, bn_newton_threshold,
+            bn_hgcd_threshold, bn_parallel_threshold);
+
+    if (sweep != NULL) {
+        status = run_sweep(sweep);
+    } else {
+        status = run_suite(max_digits);
+    }
+    fprintf(json, "}\n");
+
+    bn_set_threads(1);
+    return status ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,411 @@
+/*
+ * File: bignum.c
+ * Description: Implementation of the contiguous big-number representation and the
+ *              core arithmetic kernels that operate on it.
+ *
+ * Numbers are stored as arrays of base 10^9 limbs, least significant first. The
+ * kernels below walk these arrays directly, so the cost of an operation is a
+ * handful of machine instructions per nine digits instead of a heap node (and a
+ * pointer dereference) per digit.
+ *
+ * The sign is kept apart from the limbs (sign-magnitude). Addition and
+ * subtraction look at the signs once, then either add the magnitudes or
+ * subtract the smaller magnitude from the larger, so a negative result costs
+ * no more than a positive one.
+ *
+ * Multiplication lives in `bn_mul.c` and division in `bn_div.c`; the limb-array
+ * kernels shared by these files are declared in `bn_internal.h`. The add,
+ * subtract and compare kernels hand whole vectors to the AVX2/AVX-512 code in
+ * `bn_simd.c` when the CPU supports it and finish the remainder here.
+ *
+ * Functions:
+ * - void bn_init(BigNum *n): Initializes an empty (zero) number.
+ * - void bn_free(BigNum *n): Releases the limb storage of a number.
+ * - int bn_reserve(BigNum *n, size_t cap): Grows the limb storage.
+ * - void bn_swap(BigNum *a, BigNum *b): Exchanges two numbers.
+ * - int bn_copy(BigNum *dst, const BigNum *src): Copies a number.
+ * - void bn_normalize(BigNum *n): Drops leading zero limbs.
+ * - BigNum bn_view(const limb_t *limbs, size_t len): Read-only number over existing limbs.
+ * - int bn_from_dlist(BigNum *n, DList *list, Node *tail): Packs DList digits into limbs.
+ * - int bn_to_dlist(const BigNum *n, DList **list): Unpacks limbs into DList digits.
+ * - int bn_compare(const BigNum *a, const BigNum *b): Signed comparison.
+ * - int bn_compare_abs(const BigNum *a, const BigNum *b): Magnitude comparison.
+ * - void bn_negate(BigNum *n): Flips the sign.
+ * - int bn_add(BigNum *r, const BigNum *a, const BigNum *b): Signed addition.
+ * - int bn_sub(BigNum *r, const BigNum *a, const BigNum *b): Signed subtraction.
+ * - int bn_add_inplace(BigNum *a, const BigNum *b): a += b.
+ * - int bn_sub_inplace(BigNum *a, const BigNum *b): a -= b.
+ * - int bn_mul_small_inplace(BigNum *a, limb_t m): a *= m for a single limb.
+ * - int bn_addmul_small(BigNum *r, const BigNum *a, limb_t m): r += a * m for a single limb.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+
+// Powers of ten used to address single decimal digits inside a limb
+static const limb_t pow10_table[BN_BASE_DIGITS] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u
+};
+
+// Initialize a number to zero without allocating
+void bn_init(BigNum *n) {
+    n->limbs = NULL;
+    n->len = 0;
+    n->cap = 0;
+    n->neg = 0;
+}
+
+// Release the limb storage and reset the number to zero
+void bn_free(BigNum *n) {
+    free(n->limbs);
+    bn_init(n);
+}
+
+// Make sure the number can hold at least `cap` limbs
+int bn_reserve(BigNum *n, size_t cap) {
+    if (cap <= n->cap) {
+        return 1;
+    }
+    if (cap < 2 * n->cap) {
+        cap = 2 * n->cap; // Grow geometrically so repeated appends stay linear
+    }
+    limb_t *limbs = (limb_t *)realloc(n->limbs, cap * sizeof(limb_t));
+    if (limbs == NULL) {
+        return 0;
+    }
+    n->limbs = limbs;
+    n->cap = cap;
+    return 1;
+}
+
+// Exchange two numbers by swapping their storage
+void bn_swap(BigNum *a, BigNum *b) {
+    BigNum tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+// Copy the value of src into dst
+int bn_copy(BigNum *dst, const BigNum *src) {
+    if (dst == src) {
+        return 1;
+    }
+    if (!bn_reserve(dst, src->len)) {
+        return 0;
+    }
+    if (src->len > 0) {
+        memcpy(dst->limbs, src->limbs, src->len * sizeof(limb_t));
+    }
+    dst->len = src->len;
+    dst->neg = src->neg;
+    return 1;
+}
+
+// Strip leading zero limbs so that `len` reflects the true size; zero is never negative
+void bn_normalize(BigNum *n) {
+    while (n->len > 0 && n->limbs[n->len - 1] == 0) {
+        n->len--;
+    }
+    if (n->len == 0) {
+        n->neg = 0;
+    }
+}
+
+// A read-only, non-negative BigNum looking at len limbs of an existing array
+BigNum bn_view(const limb_t *limbs, size_t len) {
+    BigNum view;
+    view.limbs = (limb_t *)limbs;
+    view.len = len;
+    view.cap = 0;
+    view.neg = 0;
+    bn_normalize(&view);
+    return view;
+}
+
+// Pack the digits of a DList (walking from its tail) into base 10^9 limbs
+int bn_from_dlist(BigNum *n, DList *list, Node *tail) {
+    Node *ptr = tail;
+    limb_t limb = 0;
+    int position = 0;
+    size_t digits = 0;
+
+    // Size the limb array once up front; a whole list knows its length
+    if (tail == list->tail) {
+        digits = list->length;
+    } else {
+        for (Node *node = tail; node != NULL; node = node->prev) {
+            digits++;
+        }
+    }
+    if (!bn_reserve(n, (digits + BN_BASE_DIGITS - 1) / BN_BASE_DIGITS)) {
+        return 0;
+    }
+
+    n->len = 0;
+    while (ptr != NULL) {
+        limb += (limb_t)ptr->data * pow10_table[position];
+        if (++position == BN_BASE_DIGITS) {
+            n->limbs[n->len++] = limb;
+            limb = 0;
+            position = 0;
+        }
+        ptr = ptr->prev;
+    }
+    if (position > 0) {
+        n->limbs[n->len++] = limb;
+    }
+    n->neg = list->sign;
+    bn_normalize(n);
+    return 1;
+}
+
+// Append the decimal digits of a number to the tail of a DList
+int bn_to_dlist(const BigNum *n, DList **list) {
+    if (*list == NULL) {
+        *list = create_empty_list();
+    }
+    (*list)->sign = n->neg;
+    if (n->len == 0) {
+        insert_at_tail(list, create_node(0));
+        return 1;
+    }
+
+    // The most significant limb is printed without leading zeros
+    int position = BN_BASE_DIGITS - 1;
+    limb_t top = n->limbs[n->len - 1];
+    while (position > 0 && top < pow10_table[position]) {
+        position--;
+    }
+    for (; position >= 0; position--) {
+        insert_at_tail(list, create_node((top / pow10_table[position]) % 10));
+    }
+
+    for (size_t i = n->len - 1; i-- > 0;) {
+        limb_t limb = n->limbs[i];
+        for (position = BN_BASE_DIGITS - 1; position >= 0; position--) {
+            insert_at_tail(list, create_node((limb / pow10_table[position]) % 10));
+        }
+    }
+    return 1;
+}
+
+// Compare two numbers; only numbers of the same sign and length look at their limbs
+int bn_compare(const BigNum *a, const BigNum *b) {
+    if (a->neg != b->neg) {
+        return a->neg ? -1 : 1;
+    }
+    return a->neg ? -bn_compare_abs(a, b) : bn_compare_abs(a, b);
+}
+
+// Compare the magnitudes of two numbers
+int bn_compare_abs(const BigNum *a, const BigNum *b) {
+    if (a->len != b->len) {
+        return (a->len > b->len) ? 1 : -1;
+    }
+    return limbs_cmp(a->limbs, b->limbs, a->len);
+}
+
+// n = -n
+void bn_negate(BigNum *n) {
+    n->neg = !n->neg && n->len > 0;
+}
+
+// r[0..an) = a[0..an) + b[0..bn) for an >= bn, returning the carry out; r may equal a or b
+limb_t limbs_add(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn) {
+    limb_t carry = 0;
+    size_t i = (bn_simd.add != NULL) ? bn_simd.add(r, a, b, bn, &carry) : 0;
+    for (; i < bn; i++) {
+        limb_t sum = a[i] + b[i] + carry;
+        carry = (sum >= BN_BASE);
+        r[i] = carry ? sum - BN_BASE : sum;
+    }
+    for (; i < an && carry; i++) {
+        limb_t sum = a[i] + 1;
+        carry = (sum == BN_BASE);
+        r[i] = carry ? 0 : sum;
+    }
+    if (r != a && i < an) {
+        memcpy(r + i, a + i, (an - i) * sizeof(limb_t));
+    }
+    return carry;
+}
+
+// r[0..an) = a[0..an) - b[0..bn) for an >= bn, returning the borrow out; r may equal a or b
+limb_t limbs_sub(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn) {
+    limb_t borrow = 0;
+    size_t i = (bn_simd.sub != NULL) ? bn_simd.sub(r, a, b, bn, &borrow) : 0;
+    for (; i < bn; i++) {
+        limb_t sub = b[i] + borrow;
+        limb_t limb = a[i];
+        borrow = (limb < sub);
+        r[i] = borrow ? limb + BN_BASE - sub : limb - sub;
+    }
+    for (; i < an && borrow; i++) {
+        borrow = (a[i] == 0);
+        r[i] = borrow ? BN_BASE - 1 : a[i] - 1;
+    }
+    if (r != a && i < an) {
+        memcpy(r + i, a + i, (an - i) * sizeof(limb_t));
+    }
+    return borrow;
+}
+
+// Compare two limb arrays of the same length
+int limbs_cmp(const limb_t *a, const limb_t *b, size_t n) {
+    if (bn_simd.cmp != NULL) {
+        n = bn_simd.cmp(a, b, n); // Skip equal high blocks
+    }
+    for (size_t i = n; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return (a[i] > b[i]) ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+// Multiply the limbs src[0..n) by a single limb, writing n limbs to dst and returning the carry
+limb_t limbs_mul_small(limb_t *dst, const limb_t *src, size_t n, limb_t m) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t cur = (uint64_t)src[i] * m + carry;
+        carry = cur / BN_BASE;
+        dst[i] = (limb_t)(cur % BN_BASE);
+    }
+    return (limb_t)carry;
+}
+
+// Divide the limbs src[0..n) by a single limb, writing the quotient to dst and returning the remainder
+limb_t limbs_div_small(limb_t *dst, const limb_t *src, size_t n, limb_t d) {
+    uint64_t rem = 0;
+    for (size_t i = n; i-- > 0;) {
+        uint64_t cur = rem * BN_BASE + src[i];
+        dst[i] = (limb_t)(cur / d);
+        rem = cur % d;
+    }
+    return (limb_t)rem;
+}
+
+// |r| = |a| + |b|; r may alias a or b
+static int add_magnitudes(BigNum *r, const BigNum *a, const BigNum *b) {
+    if (a->len < b->len) {
+        const BigNum *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    size_t alen = a->len;
+
+    // Reserving first keeps this safe when r aliases a or b
+    if (!bn_reserve(r, alen + 1)) {
+        return 0;
+    }
+    limb_t carry = limbs_add(r->limbs, a->limbs, alen, b->limbs, b->len);
+    r->limbs[alen] = carry;
+    r->len = alen + carry;
+    return 1;
+}
+
+// |r| = |a| - |b| for |a| >= |b|; r may alias a or b
+static int sub_magnitudes(BigNum *r, const BigNum *a, const BigNum *b) {
+    size_t alen = a->len;
+
+    if (!bn_reserve(r, alen)) {
+        return 0;
+    }
+    limbs_sub(r->limbs, a->limbs, alen, b->limbs, b->len);
+    r->len = alen;
+    return 1;
+}
+
+// r = a + b when bneg is the sign of b, r = a - b when it is the opposite sign
+static int add_signed(BigNum *r, const BigNum *a, const BigNum *b, int bneg) {
+    int aneg = a->neg;
+    int status;
+
+    if (aneg == bneg) {
+        status = add_magnitudes(r, a, b);
+        r->neg = aneg;
+    } else if (bn_compare_abs(a, b) >= 0) {
+        status = sub_magnitudes(r, a, b);
+        r->neg = aneg;
+    } else {
+        status = sub_magnitudes(r, b, a);
+        r->neg = bneg;
+    }
+    bn_normalize(r);
+    return status;
+}
+
+// r = a + b
+int bn_add(BigNum *r, const BigNum *a, const BigNum *b) {
+    return add_signed(r, a, b, b->neg);
+}
+
+// r = a - b
+int bn_sub(BigNum *r, const BigNum *a, const BigNum *b) {
+    return add_signed(r, a, b, !b->neg);
+}
+
+// r[0..n) += a[0..n) * m, returning the carry limb; r may equal a
+limb_t limbs_addmul_small(limb_t *r, const limb_t *a, size_t n, limb_t m) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t cur = r[i] + (uint64_t)a[i] * m + carry;
+        carry = cur / BN_BASE;
+        r[i] = (limb_t)(cur % BN_BASE);
+    }
+    return (limb_t)carry;
+}
+
+// a += b, reusing a's storage; only a sum that outgrows the allocation reallocates
+int bn_add_inplace(BigNum *a, const BigNum *b) {
+    return add_signed(a, a, b, b->neg);
+}
+
+// a -= b, reusing a's storage
+int bn_sub_inplace(BigNum *a, const BigNum *b) {
+    return add_signed(a, a, b, !b->neg);
+}
+
+// a *= m for a single limb m < BN_BASE
+int bn_mul_small_inplace(BigNum *a, limb_t m) {
+    if (m == 0 || a->len == 0) {
+        a->len = 0;
+        a->neg = 0;
+        return 1;
+    }
+    if (!bn_reserve(a, a->len + 1)) {
+        return 0;
+    }
+    limb_t carry = limbs_mul_small(a->limbs, a->limbs, a->len, m);
+    a->limbs[a->len] = carry;
+    a->len += (carry != 0);
+    return 1;
+}
+
+// r += a * m for a single limb m < BN_BASE and non-negative r and a; r may alias a
+int bn_addmul_small(BigNum *r, const BigNum *a, limb_t m) {
+    size_t len = (r->len > a->len) ? r->len : a->len;
+
+    if (m == 0 || a->len == 0) {
+        return 1;
+    }
+    if (!bn_reserve(r, len + 1)) {
+        return 0;
+    }
+    if (r->len < a->len) {
+        memset(r->limbs + r->len, 0, (a->len - r->len) * sizeof(limb_t));
+    }
+    limb_t carry = limbs_addmul_small(r->limbs, a->limbs, a->len, m);
+
+    // Ripple the carry through the part of r above a
+    for (size_t i = a->len; i < len && carry; i++) {
+        limb_t sum = r->limbs[i] + carry;
+        carry = (sum >= BN_BASE);
+        r->limbs[i] = carry ? sum - BN_BASE : sum;
+    }
+    r->limbs[len] = carry;
+    r->len = len + (carry != 0);
+    return 1;
+}
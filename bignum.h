@@ -0,0 +1,236 @@
+/*
+ * File: bignum.h
+ * Description: Header file for the contiguous big-number representation used by
+ *              the arithmetic hot paths.
+ *
+ * A BigNum stores a sign and the magnitude of a number as an array of machine-word
+ * limbs in base 10^9 (nine decimal digits per limb), least significant limb first. Keeping
+ * the base a power of ten makes conversion to and from decimal text (and the
+ * DList form) a linear pass, while the arithmetic loops run over cache-friendly
+ * arrays instead of chasing one heap node per digit.
+ *
+ * Data Structures:
+ * - BigNum: Limb array together with the number of limbs in use (`len`, never
+ *           counting leading zero limbs), the number of limbs allocated (`cap`)
+ *           and the sign (`neg`). Zero is represented by `len == 0` and is never
+ *           negative. Because `len` is always exact, numbers of different
+ *           lengths compare in O(1) and results can be sized before computing.
+ * - BnParser: State of an incremental decimal parse (see `bn_io.c`).
+ *
+ * Binary format (version 1): a number is stored as a record of a 32-byte
+ * header followed by its limbs, all little-endian:
+ *     bytes 0-3    magic "APCN"
+ *     byte 4       format version (1)
+ *     byte 6       1 if the number is negative, else 0 (bytes 5 and 7 are 0)
+ *     bytes 8-15   number of limbs
+ *     bytes 16-23  checksum: bn_hash of the number with the format's seed
+ *     bytes 24-31  reserved, 0
+ *     bytes 32-    the limbs as 32-bit words in base 10^9, least significant
+ *                  first, with no leading zero limbs
+ * Records may be concatenated. Every record is a multiple of 4 bytes long,
+ * so the limbs of records in a memory-mapped file are aligned and can be used
+ * in place (see `bn_binary_view`).
+ *
+ * Function Declarations:
+ * - void bn_init(BigNum *n): Initializes an empty (zero) number.
+ * - void bn_free(BigNum *n): Releases the limb storage of a number.
+ * - int bn_reserve(BigNum *n, size_t cap): Grows the limb storage to at least `cap` limbs.
+ * - void bn_swap(BigNum *a, BigNum *b): Exchanges two numbers without copying limbs.
+ * - int bn_copy(BigNum *dst, const BigNum *src): Copies `src` into `dst`.
+ * - void bn_normalize(BigNum *n): Drops leading zero limbs (and the sign of a zero).
+ * - int bn_from_dlist(BigNum *n, DList *list, Node *tail): Converts a DList to a BigNum.
+ * - int bn_to_dlist(const BigNum *n, DList **list): Appends the digits of a BigNum to a DList.
+ * - int bn_compare(const BigNum *a, const BigNum *b): Compares two numbers (1, -1 or 0).
+ * - int bn_compare_abs(const BigNum *a, const BigNum *b): Compares the magnitudes of two numbers.
+ * - void bn_negate(BigNum *n): n = -n.
+ * - int bn_add(BigNum *r, const BigNum *a, const BigNum *b): r = a + b.
+ * - int bn_sub(BigNum *r, const BigNum *a, const BigNum *b): r = a - b.
+ * - int bn_add_inplace(BigNum *a, const BigNum *b): a += b.
+ * - int bn_sub_inplace(BigNum *a, const BigNum *b): a -= b.
+ * - int bn_mul_small_inplace(BigNum *a, limb_t m): a *= m, for m < BN_BASE.
+ * - int bn_addmul_small(BigNum *r, const BigNum *a, limb_t m):
+ *     r += a * m, for m < BN_BASE and r and a not negative.
+ *     The in-place functions work in the destination's own storage and only
+ *     reallocate it (geometrically) when the result outgrows it, so loops such
+ *     as a running product or Horner's rule allocate nothing in steady state.
+ * - int bn_mul(BigNum *r, const BigNum *a, const BigNum *b): r = a * b.
+ *     Uses schoolbook, Karatsuba, Toom-3 or NTT multiplication depending on the
+ *     operand sizes (see `bn_mul.c` and `bn_ntt.c`).
+ * - int bn_sqr(BigNum *r, const BigNum *a): r = a^2, with about half the work of bn_mul
+ *     for small operands (bn_mul also takes the squaring paths when a == b).
+ * - int bn_pow(BigNum *r, const BigNum *a, const BigNum *e): r = a^e. Returns 0 if e is negative.
+ * - int bn_powmod(BigNum *r, const BigNum *a, const BigNum *e, const BigNum *m):
+ *     r = a^e mod m by sliding-window exponentiation with Barrett reduction
+ *     (see `bn_pow.c`), with the same sign as the remainder of a^e by m.
+ *     Returns 0 if m is zero or e is negative.
+ * - int bn_gcd(BigNum *r, const BigNum *a, const BigNum *b): r = gcd(a, b), never negative.
+ * - int bn_gcdext(BigNum *g, BigNum *x, BigNum *y, const BigNum *a, const BigNum *b):
+ *     g = gcd(a, b) = x*a + y*b, with the smallest cofactors (see `bn_gcd.c`);
+ *     x or y may be NULL.
+ * - int bn_modinv(BigNum *r, const BigNum *a, const BigNum *m):
+ *     r = a^-1 mod m, in [0, |m|). Returns -1 if a has no inverse modulo m
+ *     (gcd(a, m) != 1, or m is zero).
+ *     GCDs use binary GCD on small values, Lehmer steps, and half-GCD from
+ *     `bn_hgcd_threshold` limbs.
+ * - int bn_product(BigNum *r, const BigNum *const *factors, size_t count):
+ *     r = factors[0] * ... * factors[count - 1] (1 for no factors), by a
+ *     balanced product tree (see `bn_prod.c`).
+ * - int bn_factorial(BigNum *r, uint64_t n): r = n!.
+ * - int bn_binomial(BigNum *r, const BigNum *n, const BigNum *k):
+ *     r = n choose k, 0 when k < 0 or k > n. Returns 0 if n is negative or
+ *     min(k, n - k) is 10^18 or more.
+ *     Independent subtrees of large products run in parallel on the threads
+ *     set by `bn_set_threads`.
+ * - int bn_divmod(BigNum *q, BigNum *rem, const BigNum *a, const BigNum *b):
+ *     q = a / b and rem = a % b; either output may be NULL. Returns 0 if b is zero.
+ *     As in C, the quotient is truncated toward zero and the remainder takes
+ *     the sign of a.
+ *     Uses Knuth's Algorithm D, or Newton-reciprocal division for large operands
+ *     (see `bn_div.c`).
+ * - void bn_parse_begin(BnParser *p, BigNum *n): Starts an incremental parse into n.
+ * - int bn_parse_chunk(BnParser *p, const char *digits, size_t len): Feeds decimal digits.
+ * - int bn_parse_end(BnParser *p): Completes the parse.
+ * - int bn_from_string(BigNum *n, const char *digits, size_t len): Parses a run of digits.
+ * - size_t bn_decimal_size(const BigNum *n): Upper bound on the length of n in decimal, sign included.
+ * - size_t bn_to_chars(char *buf, const BigNum *n):
+ *     Writes n in decimal, with a leading '-' if it is negative, to buf (not
+ *     NUL-terminated), which must hold bn_decimal_size(n) bytes. Returns the
+ *     number of characters written.
+ * - int bn_print(FILE *fp, const BigNum *n): Writes a number in decimal.
+ * - uint64_t bn_hash(const BigNum *n, uint64_t seed):
+ *     64-bit hash of the sign and magnitude of n; different seeds give
+ *     independent hashes.
+ * - size_t bn_binary_size(const BigNum *n): Length of the binary record of n.
+ * - size_t bn_to_binary(void *buf, const BigNum *n):
+ *     Writes the binary record of n to buf, which must hold bn_binary_size(n)
+ *     bytes. Returns the number of bytes written.
+ * - int bn_write_binary(FILE *fp, const BigNum *n): Writes the binary record of n.
+ * - int bn_binary_view(BigNum *view, const void *data, size_t len, size_t *used):
+ *     Validates the record at the 4-byte aligned address `data` (`len` bytes
+ *     available) and points `view` at its limbs without copying them. The view
+ *     is read-only, must not be freed and is valid as long as the data is.
+ *     Stores the length of the record in `used` unless it is NULL.
+ * - int bn_from_binary(BigNum *n, const void *data, size_t len, size_t *used):
+ *     Like bn_binary_view, but copies the number into n; `data` may be unaligned.
+ * - int bn_read_binary(BigNum *n, FILE *fp):
+ *     Reads one record from a stream into n. Returns 1 on success, 0 for a
+ *     malformed record and -1 at the end of the stream.
+ *     Records with a wrong magic, version or checksum, or limbs out of range,
+ *     are rejected as malformed.
+ *
+ * Tuning:
+ * - bn_karatsuba_threshold: Operand size (in limbs) at which Karatsuba replaces
+ *   schoolbook multiplication.
+ * - bn_toom3_threshold: Operand size (in limbs) at which Toom-3 replaces Karatsuba.
+ * - bn_ntt_threshold: Size of the shorter operand (in limbs) at which NTT
+ *   multiplication replaces Toom-3.
+ * - bn_newton_threshold: Divisor and quotient size (in limbs) at which
+ *   Newton-reciprocal division replaces Algorithm D.
+ * - bn_hgcd_threshold: Size (in limbs) at which GCDs switch from Lehmer steps
+ *   to the recursive half-GCD.
+ * - bn_parallel_threshold: Size of the shorter operand (in limbs) from which an
+ *   NTT multiplication is split across the threads set by `bn_set_threads`.
+ * - int bn_set_simd(int level): Selects the vector kernels for addition,
+ *   subtraction and comparison (BN_SIMD_SCALAR, BN_SIMD_AVX2 or BN_SIMD_AVX512),
+ *   capped at what the CPU supports; returns the level in use. The best
+ *   supported level is selected automatically at startup.
+ * - int bn_simd_level(void): The vector kernel level in use.
+ * - int bn_set_threads(int threads): Number of threads used for large
+ *   multiplications (0 = one per CPU, 1 = serial, the default). Must not be
+ *   called while an operation is running.
+ *
+ * All functions returning int report 1 on success and 0 on failure (allocation
+ * failure or division by zero), except for the -1 of bn_modinv and bn_read_binary above. Result arguments may alias the operands.
+*/
+
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "dlist.h"
+
+#define BN_BASE 1000000000u     // Value of one limb position
+#define BN_BASE_DIGITS 9        // Decimal digits stored per limb
+
+#define BN_BINARY_MAGIC "APCN"  // First bytes of a binary record
+#define BN_BINARY_VERSION 1     // Version of the binary format
+#define BN_BINARY_HEADER 32     // Bytes before the limbs of a binary record
+
+#define BN_SIMD_SCALAR 0       // Portable C kernels
+#define BN_SIMD_AVX2 1          // 8 limbs per vector
+#define BN_SIMD_AVX512 2        // 16 limbs per vector
+
+typedef uint32_t limb_t;
+
+typedef struct BigNum {
+    limb_t *limbs;          // Limbs, least significant first
+    size_t len;             // Number of limbs in use (0 means the value is zero)
+    size_t cap;             // Number of limbs allocated
+    int neg;                // 1 if the value is negative (never set for zero)
+} BigNum;
+
+typedef struct BnParser {
+    BigNum *n;              // Number being parsed
+    limb_t group;           // Digits not yet stored as a limb
+    int group_digits;       // Number of digits in `group`
+    size_t digits;          // Total digits consumed
+} BnParser;
+
+// Algorithm crossover points, in limbs
+extern size_t bn_karatsuba_threshold;
+extern size_t bn_toom3_threshold;
+extern size_t bn_ntt_threshold;
+extern size_t bn_newton_threshold;
+extern size_t bn_hgcd_threshold;
+extern size_t bn_parallel_threshold;
+
+// Function declarations
+void bn_init(BigNum *n);
+void bn_free(BigNum *n);
+int bn_reserve(BigNum *n, size_t cap);
+void bn_swap(BigNum *a, BigNum *b);
+int bn_copy(BigNum *dst, const BigNum *src);
+void bn_normalize(BigNum *n);
+int bn_from_dlist(BigNum *n, DList *list, Node *tail);
+int bn_to_dlist(const BigNum *n, DList **list);
+int bn_compare(const BigNum *a, const BigNum *b);
+int bn_compare_abs(const BigNum *a, const BigNum *b);
+void bn_negate(BigNum *n);
+int bn_add(BigNum *r, const BigNum *a, const BigNum *b);
+int bn_sub(BigNum *r, const BigNum *a, const BigNum *b);
+int bn_add_inplace(BigNum *a, const BigNum *b);
+int bn_sub_inplace(BigNum *a, const BigNum *b);
+int bn_mul_small_inplace(BigNum *a, limb_t m);
+int bn_addmul_small(BigNum *r, const BigNum *a, limb_t m);
+int bn_mul(BigNum *r, const BigNum *a, const BigNum *b);
+int bn_sqr(BigNum *r, const BigNum *a);
+int bn_pow(BigNum *r, const BigNum *a, const BigNum *e);
+int bn_powmod(BigNum *r, const BigNum *a, const BigNum *e, const BigNum *m);
+int bn_gcd(BigNum *r, const BigNum *a, const BigNum *b);
+int bn_gcdext(BigNum *g, BigNum *x, BigNum *y, const BigNum *a, const BigNum *b);
+int bn_modinv(BigNum *r, const BigNum *a, const BigNum *m);
+int bn_product(BigNum *r, const BigNum *const *factors, size_t count);
+int bn_factorial(BigNum *r, uint64_t n);
+int bn_binomial(BigNum *r, const BigNum *n, const BigNum *k);
+int bn_divmod(BigNum *q, BigNum *rem, const BigNum *a, const BigNum *b);
+void bn_parse_begin(BnParser *p, BigNum *n);
+int bn_parse_chunk(BnParser *p, const char *digits, size_t len);
+int bn_parse_end(BnParser *p);
+int bn_from_string(BigNum *n, const char *digits, size_t len);
+size_t bn_decimal_size(const BigNum *n);
+size_t bn_to_chars(char *buf, const BigNum *n);
+int bn_print(FILE *fp, const BigNum *n);
+uint64_t bn_hash(const BigNum *n, uint64_t seed);
+size_t bn_binary_size(const BigNum *n);
+size_t bn_to_binary(void *buf, const BigNum *n);
+int bn_write_binary(FILE *fp, const BigNum *n);
+int bn_binary_view(BigNum *view, const void *data, size_t len, size_t *used);
+int bn_from_binary(BigNum *n, const void *data, size_t len, size_t *used);
+int bn_read_binary(BigNum *n, FILE *fp);
+int bn_set_threads(int threads);
+int bn_set_simd(int level);
+int bn_simd_level(void);
+
+#endif // BIGNUM_H
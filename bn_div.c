@@ -0,0 +1,361 @@
+/*
+ * File: bn_div.c
+ * Description: Division algorithms for numbers stored as base 10^9 limb arrays.
+ *
+ * `bn_divmod` first scales both operands so the divisor's top limb is at least
+ * BN_BASE / 2 (the remainder is scaled back at the end), then picks:
+ * - Short division for single-limb divisors.
+ * - Knuth's Algorithm D, producing one quotient limb per step in O(n * m).
+ * - Newton-reciprocal division once both the divisor and the quotient reach
+ *   `bn_newton_threshold` limbs. The divisor's reciprocal is computed by Newton
+ *   iteration with doubling precision, so its cost is a small multiple of one
+ *   multiplication, and the quotient is then obtained blockwise with two
+ *   multiplications per divisor-sized block plus a short correction. Division
+ *   therefore runs at the speed of the fast multiplication in `bn_mul.c`.
+ *
+ * All of this works on magnitudes; the signs are applied at the end, with the
+ * quotient truncated toward zero and the remainder taking the dividend's sign.
+ *
+ * Functions:
+ * - int bn_divmod(BigNum *q, BigNum *rem, const BigNum *a, const BigNum *b):
+ *     q = a / b and rem = a % b; either output may be NULL.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+#include "stats.h"
+
+#define NEWTON_MIN_LIMBS 3  // Smaller divisors would not shrink when split for recursion
+#define NEWTON_MAX_CORRECTION 4 // Units a Newton-refined reciprocal can be off by (one in practice)
+
+size_t bn_newton_threshold = 800;
+
+static const limb_t one_limb = 1;
+
+// The part of n above its lowest k limbs, i.e. floor(n / BASE^k), as a view
+static BigNum bn_view_high(const BigNum *n, size_t k) {
+    return (n->len > k) ? bn_view(n->limbs + k, n->len - k) : bn_view(NULL, 0);
+}
+
+// n = BASE^k
+static int bn_set_base_power(BigNum *n, size_t k) {
+    if (!bn_reserve(n, k + 1)) {
+        return 0;
+    }
+    memset(n->limbs, 0, k * sizeof(limb_t));
+    n->limbs[k] = 1;
+    n->len = k + 1;
+    return 1;
+}
+
+// r = a * BASE^k, where r is distinct from a
+static int bn_shift_up(BigNum *r, const BigNum *a, size_t k) {
+    if (a->len == 0) {
+        r->len = 0;
+        return 1;
+    }
+    if (!bn_reserve(r, a->len + k)) {
+        return 0;
+    }
+    memset(r->limbs, 0, k * sizeof(limb_t));
+    memcpy(r->limbs + k, a->limbs, a->len * sizeof(limb_t));
+    r->len = a->len + k;
+    return 1;
+}
+
+/*
+ * Knuth's Algorithm D on base 10^9 limbs. `u` holds the normalized dividend in
+ * m + n + 1 limbs and `v` the normalized divisor in n >= 2 limbs (its top limb is
+ * at least BN_BASE / 2). One quotient limb is produced per step into q[0..m], and
+ * the normalized remainder is left in u[0..n).
+ */
+static void limbs_divmod_knuth(limb_t *q, limb_t *u, const limb_t *v, size_t m, size_t n) {
+    uint64_t vtop = v[n - 1];
+    uint64_t vnext = v[n - 2];
+
+    for (size_t j = m + 1; j-- > 0;) {
+        // Estimate the quotient limb from the top two dividend limbs
+        uint64_t num = (uint64_t)u[j + n] * BN_BASE + u[j + n - 1];
+        uint64_t qhat = num / vtop;
+        uint64_t rhat = num % vtop;
+        while (qhat >= BN_BASE || qhat * vnext > rhat * BN_BASE + u[j + n - 2]) {
+            qhat--;
+            rhat += vtop;
+            if (rhat >= BN_BASE) {
+                break;
+            }
+        }
+
+        // u[j..j+n] -= qhat * v
+        uint64_t carry = 0;
+        limb_t borrow = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t product = qhat * v[i] + carry;
+            limb_t sub = (limb_t)(product % BN_BASE) + borrow;
+            carry = product / BN_BASE;
+            borrow = (u[i + j] < sub);
+            u[i + j] = borrow ? u[i + j] + BN_BASE - sub : u[i + j] - sub;
+        }
+        uint64_t sub = carry + borrow;
+        if (u[j + n] < sub) {
+            // The estimate was one too large: add the divisor back
+            u[j + n] = (limb_t)(u[j + n] + BN_BASE - sub);
+            qhat--;
+            limb_t add_carry = 0;
+            for (size_t i = 0; i < n; i++) {
+                limb_t sum = u[i + j] + v[i] + add_carry;
+                add_carry = (sum >= BN_BASE);
+                u[i + j] = add_carry ? sum - BN_BASE : sum;
+            }
+            u[j + n] = (u[j + n] + add_carry) % BN_BASE;
+        } else {
+            u[j + n] = (limb_t)(u[j + n] - sub);
+        }
+        q[j] = (limb_t)qhat;
+    }
+}
+
+/*
+ * x = floor(BASE^(2m) / b) for a normalized m-limb divisor b (top limb at least
+ * BASE / 2), so x has at most m + 1 limbs.
+ *
+ * Above the threshold the reciprocal xh of the top h = m/2 + 1 limbs is found
+ * recursively and refined by one Newton step x = x0 + x0 * (BASE^(2m) - b*x0) / BASE^(2m)
+ * with x0 = xh * BASE^(m-h). The step doubles the number of correct limbs, so the
+ * estimate is off by a few units at most and a final correction makes it exact.
+ */
+static int reciprocal(BigNum *x, const limb_t *b, size_t m) {
+    BigNum divisor = bn_view(b, m);
+    BigNum one = bn_view(&one_limb, 1);
+    BigNum xh, t, e, power;
+    int status;
+
+    if (m < bn_newton_threshold || m < NEWTON_MIN_LIMBS) {
+        // Basecase: Algorithm D on BASE^(2m), padded with a zero top limb
+        limb_t *u = (limb_t *)calloc(2 * m + 2, sizeof(limb_t));
+        if (u == NULL || !bn_reserve(x, m + 2)) {
+            free(u);
+            return 0;
+        }
+        u[2 * m] = 1;
+        limbs_divmod_knuth(x->limbs, u, b, m + 1, m);
+        x->len = m + 2;
+        bn_normalize(x);
+        free(u);
+        return 1;
+    }
+
+    size_t h = m / 2 + 1;
+    bn_init(&xh);
+    bn_init(&t);
+    bn_init(&e);
+    bn_init(&power);
+
+    // e = |BASE^(m+h) - b * xh|, which is the Newton residual scaled down by BASE^(m-h)
+    status = reciprocal(&xh, b + m - h, h) &&
+             bn_mul(&t, &divisor, &xh) &&
+             bn_set_base_power(&power, m + h);
+    int negative = status && bn_compare(&t, &power) > 0;
+    status = status &&
+             (negative ? bn_sub(&e, &t, &power) : bn_sub(&e, &power, &t)) &&
+             bn_mul(&e, &e, &xh);
+
+    /*
+     * x = xh * BASE^(m-h) +/- floor(xh * e / BASE^(2h)). The subtraction cannot
+     * go below zero: with b = bh * BASE^(m-h) + bl and bh * xh <= BASE^(2h) (xh is
+     * exact), the residual b * xh - BASE^(m+h) is at most bl * xh < xh * BASE^(m-h).
+     * The correction is then below x0 * xh / BASE^(2h) <= 2 * x0 / BASE^h < x0,
+     * since the normalized bh keeps xh <= 2 * BASE^h.
+     */
+    if (status) {
+        BigNum delta = bn_view_high(&e, 2 * h);
+        status = bn_shift_up(x, &xh, m - h);
+        if (status && !negative) {
+            status = bn_add_inplace(x, &delta);
+        } else if (status) {
+            assert(bn_compare(x, &delta) >= 0);
+            status = bn_sub_inplace(x, &delta);
+        }
+    }
+
+    // Make x exact: b * x <= BASE^(2m) < b * (x + 1); the Newton step leaves only a few units to fix
+    status = status &&
+             bn_mul(&t, &divisor, x) &&
+             bn_set_base_power(&power, 2 * m);
+    int steps = 0;
+    for (; status && bn_compare(&t, &power) > 0; steps++) {
+        status = bn_sub_inplace(x, &one) && bn_sub_inplace(&t, &divisor);
+    }
+    status = status && bn_sub(&e, &power, &t);
+    for (; status && bn_compare(&e, &divisor) >= 0; steps++) {
+        status = bn_add_inplace(x, &one) && bn_sub_inplace(&e, &divisor);
+    }
+    assert(steps <= NEWTON_MAX_CORRECTION);
+
+    bn_free(&xh);
+    bn_free(&t);
+    bn_free(&e);
+    bn_free(&power);
+    return status;
+}
+
+/*
+ * Divide a by a normalized m-limb divisor b using its reciprocal x. The dividend
+ * is consumed in m-limb blocks from the top; each block together with the running
+ * remainder is below b * BASE^m, so its quotient fits in one block and is
+ * estimated as floor(floor(cur / BASE^m) * x / BASE^m), which is never too large
+ * and at most a few units too small.
+ */
+static int divmod_newton(BigNum *quotient, BigNum *remainder, const BigNum *a, const BigNum *b) {
+    size_t m = b->len;
+    size_t blocks = (a->len + m - 1) / m;
+    BigNum one = bn_view(&one_limb, 1);
+    BigNum x, cur, t, block_q;
+    int status;
+
+    bn_init(&x);
+    bn_init(&cur);
+    bn_init(&t);
+    bn_init(&block_q);
+    remainder->len = 0;
+
+    status = reciprocal(&x, b->limbs, m) &&
+             bn_reserve(quotient, blocks * m) &&
+             bn_reserve(&cur, 2 * m);
+    if (status) {
+        memset(quotient->limbs, 0, blocks * m * sizeof(limb_t));
+        quotient->len = blocks * m;
+    }
+
+    for (size_t j = blocks; status && j-- > 0;) {
+        // cur = remainder * BASE^m + (block j of a)
+        size_t low = j * m;
+        size_t len = (a->len - low < m) ? a->len - low : m;
+        memcpy(cur.limbs, a->limbs + low, len * sizeof(limb_t));
+        memset(cur.limbs + len, 0, (m - len) * sizeof(limb_t));
+        if (remainder->len > 0) {
+            memcpy(cur.limbs + m, remainder->limbs, remainder->len * sizeof(limb_t));
+        }
+        cur.len = m + remainder->len;
+        bn_normalize(&cur);
+
+        BigNum high = bn_view_high(&cur, m);
+        status = bn_mul(&t, &high, &x);
+        if (status) {
+            BigNum estimate = bn_view_high(&t, m);
+            status = bn_copy(&block_q, &estimate);
+        }
+        status = status &&
+                 bn_mul(&t, &block_q, b) &&
+                 bn_sub(remainder, &cur, &t);
+        while (status && bn_compare(remainder, b) >= 0) {
+            status = bn_sub_inplace(remainder, b) && bn_add_inplace(&block_q, &one);
+        }
+        if (status && block_q.len > 0) {
+            memcpy(quotient->limbs + low, block_q.limbs, block_q.len * sizeof(limb_t));
+        }
+    }
+    bn_normalize(quotient);
+
+    bn_free(&x);
+    bn_free(&cur);
+    bn_free(&t);
+    bn_free(&block_q);
+    return status;
+}
+
+// q = a / b and rem = a % b, truncating toward zero
+int bn_divmod(BigNum *q, BigNum *rem, const BigNum *a, const BigNum *b) {
+    if (b->len == 0) {
+        return 0; // Division by zero
+    }
+
+    BigNum quotient, remainder;
+    bn_init(&quotient);
+    bn_init(&remainder);
+    int quotient_neg = a->neg != b->neg;
+    int remainder_neg = a->neg;
+
+    if (bn_compare_abs(a, b) < 0) {
+        // The quotient is zero and the dividend is the remainder
+        if (rem != NULL && !bn_copy(rem, a)) {
+            return 0;
+        }
+        if (q != NULL) {
+            q->len = 0;
+            q->neg = 0;
+        }
+        return 1;
+    }
+
+    size_t n = b->len;
+    size_t m = a->len - n;
+    int status = 1;
+
+    if (!bn_reserve(&quotient, m + 1) || !bn_reserve(&remainder, a->len + 1)) {
+        bn_free(&quotient);
+        bn_free(&remainder);
+        return 0;
+    }
+
+    if (n == 1) {
+        // Short division by a single limb
+        STATS_TIER(STATS_DIV_SHORT);
+        remainder.limbs[0] = limbs_div_small(quotient.limbs, a->limbs, a->len, b->limbs[0]);
+        remainder.len = 1;
+        quotient.len = m + 1;
+    } else {
+        BigNum divisor;
+        bn_init(&divisor);
+        if (!bn_reserve(&divisor, n)) {
+            bn_free(&quotient);
+            bn_free(&remainder);
+            return 0;
+        }
+
+        // Scale both operands so the divisor's top limb is at least BN_BASE / 2
+        limb_t scale = (limb_t)(BN_BASE / ((uint64_t)b->limbs[n - 1] + 1));
+        remainder.limbs[a->len] = limbs_mul_small(remainder.limbs, a->limbs, a->len, scale);
+        limbs_mul_small(divisor.limbs, b->limbs, n, scale);
+        divisor.len = n;
+
+        if (n >= bn_newton_threshold && m >= bn_newton_threshold) {
+            BigNum dividend;
+            bn_init(&dividend);
+            STATS_TIER(STATS_DIV_NEWTON);
+            remainder.len = a->len + 1;
+            bn_normalize(&remainder);
+            bn_swap(&dividend, &remainder);
+            status = divmod_newton(&quotient, &remainder, &dividend, &divisor);
+            bn_free(&dividend);
+        } else {
+            STATS_TIER(STATS_DIV_KNUTH);
+            limbs_divmod_knuth(quotient.limbs, remainder.limbs, divisor.limbs, m, n);
+            remainder.len = n;
+            quotient.len = m + 1;
+        }
+
+        // Undo the scaling on the remainder
+        if (status) {
+            limbs_div_small(remainder.limbs, remainder.limbs, remainder.len, scale);
+        }
+        bn_free(&divisor);
+    }
+    quotient.neg = quotient_neg;
+    remainder.neg = remainder_neg;
+    bn_normalize(&quotient);
+    bn_normalize(&remainder);
+
+    if (status && q != NULL) {
+        bn_swap(q, &quotient);
+    }
+    if (status && rem != NULL) {
+        bn_swap(rem, &remainder);
+    }
+    bn_free(&quotient);
+    bn_free(&remainder);
+    return status;
+}
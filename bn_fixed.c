@@ -0,0 +1,351 @@
+/*
+ * File: bn_fixed.c
+ * Description: Fixed-width binary integer kernels, generated once per width.
+ *
+ * The kernels are written once as always-inline functions taking the word
+ * count, and FIXED_KERNELS(bits) wraps them into functions for one width. The
+ * word count is then a compile-time constant in each copy, so the compiler
+ * specializes and unrolls every loop (fully up to 1024 bits, sixteen words at
+ * a time at 4096 bits) and no length is checked at run time. BN_FIXED_WIDTHS
+ * in `bn_fixed.h` expands the macro for every supported width.
+ *
+ * Addition, subtraction and multiplication propagate carries through 128-bit
+ * sums, with no data-dependent branches. Division and modular reduction are
+ * shared by all widths: Knuth's Algorithm D on 64-bit words, working on the
+ * significant words only. A modular product reduces the full double-width
+ * product, so it is exact for any modulus.
+ *
+ * Functions:
+ * - const BnFixedOps *bn_fixed_ops(int bits): Kernels for a supported width.
+ * - void bn_fixed_from_bignum(const BnFixedOps *f, uint64_t *r, const BigNum *n): BigNum to words.
+ * - int bn_fixed_to_bignum(const BnFixedOps *f, BigNum *n, const uint64_t *a): Words to BigNum.
+ * - void bn_fixed_negate(const BnFixedOps *f, uint64_t *a): Two's complement negation.
+ * - int bn_fixed_divmod(const BnFixedOps *f, uint64_t *q, uint64_t *rem, const uint64_t *a, const uint64_t *b): Division.
+ * - void bn_fixed_pow(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e): Wrapping power.
+ * - int bn_fixed_modmul(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *m): Modular product.
+ * - int bn_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m): Modular power.
+*/
+
+#include <string.h>
+#include "bn_fixed.h"
+
+#define FIXED_INLINE static inline __attribute__((always_inline))
+
+typedef unsigned __int128 u128;
+
+// r = a + b modulo 2^(64n)
+FIXED_INLINE void fixed_add(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    uint64_t carry = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < n; i++) {
+        u128 sum = (u128)a[i] + b[i] + carry;
+        r[i] = (uint64_t)sum;
+        carry = (uint64_t)(sum >> 64);
+    }
+}
+
+// r = a - b modulo 2^(64n)
+FIXED_INLINE void fixed_sub(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    uint64_t borrow = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < n; i++) {
+        u128 diff = (u128)a[i] - b[i] - borrow;
+        r[i] = (uint64_t)diff;
+        borrow = (uint64_t)(diff >> 64) & 1;
+    }
+}
+
+// r = a * b modulo 2^(64n); only the products that reach the low n words are formed
+FIXED_INLINE void fixed_mul(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    uint64_t t[BN_FIXED_MAX_WORDS] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        uint64_t carry = 0;
+#pragma GCC unroll 16
+        for (size_t j = 0; j < n - i; j++) {
+            u128 p = (u128)a[i] * b[j] + t[i + j] + carry;
+            t[i + j] = (uint64_t)p;
+            carry = (uint64_t)(p >> 64);
+        }
+    }
+    memcpy(r, t, n * sizeof(uint64_t));
+}
+
+// r[0..2n) = a * b
+FIXED_INLINE void fixed_mul_wide(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    uint64_t t[2 * BN_FIXED_MAX_WORDS] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        uint64_t carry = 0;
+#pragma GCC unroll 16
+        for (size_t j = 0; j < n; j++) {
+            u128 p = (u128)a[i] * b[j] + t[i + j] + carry;
+            t[i + j] = (uint64_t)p;
+            carry = (uint64_t)(p >> 64);
+        }
+        t[i + n] = carry;
+    }
+    memcpy(r, t, 2 * n * sizeof(uint64_t));
+}
+
+// One function per kernel and width, plus the table entry that names them
+#define FIXED_KERNELS(bits)                                                                     \
+    static void fixed##bits##_add(uint64_t *r, const uint64_t *a, const uint64_t *b) {          \
+        fixed_add(r, a, b, (bits) / 64);                                                        \
+    }                                                                                           \
+    static void fixed##bits##_sub(uint64_t *r, const uint64_t *a, const uint64_t *b) {          \
+        fixed_sub(r, a, b, (bits) / 64);                                                        \
+    }                                                                                           \
+    static void fixed##bits##_mul(uint64_t *r, const uint64_t *a, const uint64_t *b) {          \
+        fixed_mul(r, a, b, (bits) / 64);                                                        \
+    }                                                                                           \
+    static void fixed##bits##_mul_wide(uint64_t *r, const uint64_t *a, const uint64_t *b) {     \
+        fixed_mul_wide(r, a, b, (bits) / 64);                                                   \
+    }                                                                                           \
+    static const BnFixedOps fixed##bits##_ops = {                                               \
+        (bits), (bits) / 64, fixed##bits##_add, fixed##bits##_sub,                              \
+        fixed##bits##_mul, fixed##bits##_mul_wide                                               \
+    };
+
+BN_FIXED_WIDTHS(FIXED_KERNELS)
+
+#define FIXED_TABLE_ENTRY(bits) &fixed##bits##_ops,
+
+static const BnFixedOps *const fixed_table[] = { BN_FIXED_WIDTHS(FIXED_TABLE_ENTRY) };
+
+// Kernels for a width of `bits`, or NULL if that width is not generated
+const BnFixedOps *bn_fixed_ops(int bits) {
+    for (size_t i = 0; i < sizeof(fixed_table) / sizeof(fixed_table[0]); i++) {
+        if (fixed_table[i]->bits == bits) {
+            return fixed_table[i];
+        }
+    }
+    return NULL;
+}
+
+// Number of words of a[0..n) up to its highest nonzero word
+static size_t words_len(const uint64_t *a, size_t n) {
+    while (n > 0 && a[n - 1] == 0) {
+        n--;
+    }
+    return n;
+}
+
+/*
+ * q[0..an-bn] = a / b and rem[0..bn) = a % b for an >= bn >= 1 and b[bn-1] != 0,
+ * by Knuth's Algorithm D on 64-bit words. Either output may be NULL.
+ */
+static void words_divmod(uint64_t *q, uint64_t *rem, const uint64_t *a, size_t an, const uint64_t *b, size_t bn) {
+    uint64_t u[2 * BN_FIXED_MAX_WORDS + 1], v[BN_FIXED_MAX_WORDS];
+
+    if (bn == 1) {
+        u128 r = 0;
+        for (size_t i = an; i-- > 0;) {
+            u128 cur = (r << 64) | a[i];
+            if (q != NULL) {
+                q[i] = (uint64_t)(cur / b[0]);
+            }
+            r = cur % b[0];
+        }
+        if (rem != NULL) {
+            rem[0] = (uint64_t)r;
+        }
+        return;
+    }
+
+    // Shift both operands so the divisor's top bit is set
+    int s = __builtin_clzll(b[bn - 1]);
+    for (size_t i = bn; i-- > 0;) {
+        v[i] = (b[i] << s) | ((s != 0 && i > 0) ? b[i - 1] >> (64 - s) : 0);
+    }
+    u[an] = (s != 0) ? a[an - 1] >> (64 - s) : 0;
+    for (size_t i = an; i-- > 0;) {
+        u[i] = (a[i] << s) | ((s != 0 && i > 0) ? a[i - 1] >> (64 - s) : 0);
+    }
+
+    for (size_t j = an - bn + 1; j-- > 0;) {
+        // Estimate the quotient word from the top two words; it is at most two too large
+        u128 top = ((u128)u[j + bn] << 64) | u[j + bn - 1];
+        u128 qhat = top / v[bn - 1];
+        u128 rhat = top % v[bn - 1];
+        while ((qhat >> 64) != 0 || qhat * v[bn - 2] > ((rhat << 64) | u[j + bn - 2])) {
+            qhat--;
+            rhat += v[bn - 1];
+            if ((rhat >> 64) != 0) {
+                break;
+            }
+        }
+
+        // u[j..j+bn] -= qhat * v
+        uint64_t carry = 0, borrow = 0;
+        for (size_t i = 0; i < bn; i++) {
+            u128 p = qhat * v[i] + carry;
+            carry = (uint64_t)(p >> 64);
+            u128 diff = (u128)u[i + j] - (uint64_t)p - borrow;
+            u[i + j] = (uint64_t)diff;
+            borrow = (uint64_t)(diff >> 64) & 1;
+        }
+        u128 diff = (u128)u[j + bn] - carry - borrow;
+        u[j + bn] = (uint64_t)diff;
+
+        // Rarely the estimate was still one too large: add v back
+        if ((diff >> 64) != 0) {
+            qhat--;
+            carry = 0;
+            for (size_t i = 0; i < bn; i++) {
+                u128 sum = (u128)u[i + j] + v[i] + carry;
+                u[i + j] = (uint64_t)sum;
+                carry = (uint64_t)(sum >> 64);
+            }
+            u[j + bn] += carry;
+        }
+        if (q != NULL) {
+            q[j] = (uint64_t)qhat;
+        }
+    }
+
+    if (rem != NULL) {
+        for (size_t i = 0; i < bn; i++) {
+            rem[i] = (u[i] >> s) | ((s != 0) ? u[i + 1] << (64 - s) : 0);
+        }
+    }
+}
+
+// rem[0..mn) = a[0..an) mod m[0..mn), for mn >= 1 and m[mn-1] != 0; rem may be a
+static void words_mod(uint64_t *rem, const uint64_t *a, size_t an, const uint64_t *m, size_t mn) {
+    an = words_len(a, an);
+    if (an < mn) {
+        memmove(rem, a, an * sizeof(uint64_t));
+        memset(rem + an, 0, (mn - an) * sizeof(uint64_t));
+    } else {
+        words_divmod(NULL, rem, a, an, m, mn);
+    }
+}
+
+// r = n modulo 2^bits; a negative n wraps around like a C unsigned conversion
+void bn_fixed_from_bignum(const BnFixedOps *f, uint64_t *r, const BigNum *n) {
+    memset(r, 0, f->words * sizeof(uint64_t));
+    for (size_t i = n->len; i-- > 0;) {
+        // r = r * BASE + limb; words above the width are simply dropped
+        uint64_t carry = n->limbs[i];
+        for (size_t k = 0; k < f->words; k++) {
+            u128 cur = (u128)r[k] * BN_BASE + carry;
+            r[k] = (uint64_t)cur;
+            carry = (uint64_t)(cur >> 64);
+        }
+    }
+    if (n->neg) {
+        bn_fixed_negate(f, r);
+    }
+}
+
+// n = a, by repeated division by BASE
+int bn_fixed_to_bignum(const BnFixedOps *f, BigNum *n, const uint64_t *a) {
+    uint64_t t[BN_FIXED_MAX_WORDS];
+    size_t len = words_len(a, f->words);
+
+    // Each limb takes at least 29 bits off the value (2^29 < BASE)
+    if (!bn_reserve(n, (size_t)f->bits / 29 + 1)) {
+        return 0;
+    }
+    memcpy(t, a, len * sizeof(uint64_t));
+    n->len = 0;
+    n->neg = 0;
+    while (len > 0) {
+        u128 r = 0;
+        for (size_t i = len; i-- > 0;) {
+            u128 cur = (r << 64) | t[i];
+            t[i] = (uint64_t)(cur / BN_BASE);
+            r = cur % BN_BASE;
+        }
+        n->limbs[n->len++] = (limb_t)r;
+        len = words_len(t, len);
+    }
+    return 1;
+}
+
+// a = 2^bits - a (two's complement)
+void bn_fixed_negate(const BnFixedOps *f, uint64_t *a) {
+    uint64_t carry = 1;
+    for (size_t i = 0; i < f->words; i++) {
+        u128 sum = (u128)(~a[i]) + carry;
+        a[i] = (uint64_t)sum;
+        carry = (uint64_t)(sum >> 64);
+    }
+}
+
+// q = a / b and rem = a % b; returns 0 if b is zero
+int bn_fixed_divmod(const BnFixedOps *f, uint64_t *q, uint64_t *rem, const uint64_t *a, const uint64_t *b) {
+    uint64_t qt[BN_FIXED_MAX_WORDS] = { 0 }, rt[BN_FIXED_MAX_WORDS] = { 0 };
+    size_t n = f->words;
+    size_t an = words_len(a, n), bn = words_len(b, n);
+
+    if (bn == 0) {
+        return 0;
+    }
+    if (an < bn) {
+        memcpy(rt, a, n * sizeof(uint64_t));
+    } else {
+        words_divmod(qt, rt, a, an, b, bn);
+    }
+    if (q != NULL) {
+        memcpy(q, qt, n * sizeof(uint64_t));
+    }
+    if (rem != NULL) {
+        memcpy(rem, rt, n * sizeof(uint64_t));
+    }
+    return 1;
+}
+
+// Index of the highest set bit of a[0..n), or -1 for zero
+static long top_bit(const uint64_t *a, size_t n) {
+    n = words_len(a, n);
+    return (n == 0) ? -1 : (long)(64 * n - 1) - __builtin_clzll(a[n - 1]);
+}
+
+// r = a^e modulo 2^bits, square and multiply from the top bit of e
+void bn_fixed_pow(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e) {
+    uint64_t base[BN_FIXED_MAX_WORDS], result[BN_FIXED_MAX_WORDS] = { 1 };
+
+    memcpy(base, a, f->words * sizeof(uint64_t));
+    for (long bit = top_bit(e, f->words); bit >= 0; bit--) {
+        f->mul(result, result, result);
+        if ((e[bit / 64] >> (bit % 64)) & 1) {
+            f->mul(result, result, base);
+        }
+    }
+    memcpy(r, result, f->words * sizeof(uint64_t));
+}
+
+// r = a * b mod m, reducing the full double-width product; returns 0 if m is zero
+int bn_fixed_modmul(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *m) {
+    uint64_t product[2 * BN_FIXED_MAX_WORDS];
+    size_t n = f->words, mn = words_len(m, n);
+
+    if (mn == 0) {
+        return 0;
+    }
+    f->mul_wide(product, a, b);
+    memset(r, 0, n * sizeof(uint64_t));
+    words_mod(r, product, 2 * n, m, mn);
+    return 1;
+}
+
+// r = a^e mod m by square and multiply; returns 0 if m is zero
+int bn_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m) {
+    uint64_t base[BN_FIXED_MAX_WORDS] = { 0 }, result[BN_FIXED_MAX_WORDS] = { 0 };
+    size_t n = f->words, mn = words_len(m, n);
+
+    if (mn == 0) {
+        return 0;
+    }
+    words_mod(base, a, n, m, mn);
+    result[0] = 1;
+    words_mod(result, result, n, m, mn);    // 1 mod m, which is 0 for m = 1
+    for (long bit = top_bit(e, n); bit >= 0; bit--) {
+        bn_fixed_modmul(f, result, result, result, m);
+        if ((e[bit / 64] >> (bit % 64)) & 1) {
+            bn_fixed_modmul(f, result, result, base, m);
+        }
+    }
+    memcpy(r, result, n * sizeof(uint64_t));
+    return 1;
+}
@@ -0,0 +1,70 @@
+/*
+ * File: bn_fixed.h
+ * Description: Header file for fixed-width binary integers (256 to 4096 bits).
+ *
+ * A fixed-width value is an array of 64-bit words, least significant first,
+ * holding an unsigned integer modulo 2^bits: arithmetic wraps around exactly
+ * like C's uint64_t, only wider. The widths are listed once in
+ * BN_FIXED_WIDTHS; `bn_fixed.c` expands that list into one set of kernels per
+ * width, so every loop has a compile-time trip count and is unrolled by the
+ * compiler, and adding a width is a one-word change.
+ *
+ * Values live in caller-provided word arrays (typically on the stack) and no
+ * function here allocates. Addition, subtraction and multiplication contain no
+ * data-dependent branches; division and modular reduction use word-wise long
+ * division, whose quotient corrections do branch.
+ *
+ * Data Structures:
+ * - BnFixedOps: Width of one fixed-width type and its generated kernels.
+ *
+ * Function Declarations:
+ * - const BnFixedOps *bn_fixed_ops(int bits): Kernels for a supported width, or NULL.
+ * - void bn_fixed_from_bignum(const BnFixedOps *f, uint64_t *r, const BigNum *n):
+ *     r = n modulo 2^bits (a negative n wraps around to 2^bits - |n|).
+ * - int bn_fixed_to_bignum(const BnFixedOps *f, BigNum *n, const uint64_t *a):
+ *     Converts a value back to a (non-negative) BigNum.
+ * - void bn_fixed_negate(const BnFixedOps *f, uint64_t *a): a = 2^bits - a.
+ * - int bn_fixed_divmod(const BnFixedOps *f, uint64_t *q, uint64_t *rem, const uint64_t *a, const uint64_t *b):
+ *     q = a / b and rem = a % b; either output may be NULL. Returns 0 if b is zero.
+ * - void bn_fixed_pow(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e):
+ *     r = a^e modulo 2^bits.
+ * - int bn_fixed_modmul(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *m):
+ *     r = a * b mod m from the full double-width product. Returns 0 if m is zero.
+ * - int bn_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m):
+ *     r = a^e mod m by square-and-multiply over bn_fixed_modmul. Returns 0 if m is zero.
+ *
+ * Results may alias the operands in every function.
+*/
+
+#ifndef BN_FIXED_H
+#define BN_FIXED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bignum.h"
+
+// Supported widths in bits, each a multiple of 64; X(bits) is expanded once per width
+#define BN_FIXED_WIDTHS(X) X(256) X(512) X(1024) X(4096)
+
+#define BN_FIXED_MAX_WORDS 64   // Words in the widest type
+
+typedef struct BnFixedOps {
+    int bits;               // Width in bits
+    size_t words;           // Width in 64-bit words
+    void (*add)(uint64_t *r, const uint64_t *a, const uint64_t *b);         // r = a + b
+    void (*sub)(uint64_t *r, const uint64_t *a, const uint64_t *b);         // r = a - b
+    void (*mul)(uint64_t *r, const uint64_t *a, const uint64_t *b);         // r = a * b, low half
+    void (*mul_wide)(uint64_t *r, const uint64_t *a, const uint64_t *b);    // r[0..2 words) = a * b
+} BnFixedOps;
+
+// Function declarations
+const BnFixedOps *bn_fixed_ops(int bits);
+void bn_fixed_from_bignum(const BnFixedOps *f, uint64_t *r, const BigNum *n);
+int bn_fixed_to_bignum(const BnFixedOps *f, BigNum *n, const uint64_t *a);
+void bn_fixed_negate(const BnFixedOps *f, uint64_t *a);
+int bn_fixed_divmod(const BnFixedOps *f, uint64_t *q, uint64_t *rem, const uint64_t *a, const uint64_t *b);
+void bn_fixed_pow(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e);
+int bn_fixed_modmul(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *b, const uint64_t *m);
+int bn_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m);
+
+#endif // BN_FIXED_H
@@ -0,0 +1,528 @@
+/*
+ * File: bn_gcd.c
+ * Description: Greatest common divisors, Bezout cofactors and modular inverses.
+ *
+ * Euclid's algorithm is run on the magnitudes in three tiers:
+ * - Binary GCD once both numbers fit in two limbs (below 10^18), on 64-bit
+ *   integers with shifts and subtractions only.
+ * - Lehmer steps: Euclid is run on the leading two limbs of the numbers, the
+ *   quotients that are certain for every possible value of the lower limbs
+ *   are collected into a 2x2 matrix of small cofactors (Knuth's Algorithm L),
+ *   and the matrix is applied to the full numbers in a single pass. Each step
+ *   removes about one limb for O(n) work; when the leading limbs determine no
+ *   quotient, one full division is done instead.
+ * - Half-GCD from `bn_hgcd_threshold` limbs: the reduction of the top half of
+ *   the numbers to a quarter of their length is computed recursively, as a
+ *   matrix, and applied to the whole numbers with a few multiplications, so a
+ *   GCD costs O(M(n) log n) where M(n) is the cost of one multiplication.
+ *
+ * Every step is an integer matrix of determinant +-1, so the GCD of the pair
+ * never changes even when a reduction computed from the top half is not
+ * exactly Euclid's; any sign or order it gets wrong is corrected afterwards.
+ * For the extended GCD the matrices are multiplied together, and their product
+ * gives both cofactors at the end.
+ *
+ * Functions:
+ * - int bn_gcd(BigNum *r, const BigNum *a, const BigNum *b): r = gcd(a, b).
+ * - int bn_gcdext(BigNum *g, BigNum *x, BigNum *y, const BigNum *a, const BigNum *b): g = x*a + y*b.
+ * - int bn_modinv(BigNum *r, const BigNum *a, const BigNum *m): r = a^-1 mod m.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+#include "stats.h"
+
+#define LEHMER_COFACTOR_LIMIT ((int64_t)1 << 31)   // Keeps two cofactor-limb products within int64_t
+
+size_t bn_hgcd_threshold = 48;
+
+// Product of a run of Euclid steps: (a; b) = (u[0] u[1]; u[2] u[3]) (a'; b')
+typedef struct GcdMatrix {
+    BigNum u[4];
+    int det;                // Determinant, 1 or -1
+} GcdMatrix;
+
+static int hgcd(BigNum *a, BigNum *b, GcdMatrix *M);
+
+// n = v for v < BASE^2
+static int set_u64(BigNum *n, uint64_t v) {
+    if (!bn_reserve(n, 2)) {
+        return 0;
+    }
+    n->limbs[0] = (limb_t)(v % BN_BASE);
+    n->limbs[1] = (limb_t)(v / BN_BASE);
+    n->len = 2;
+    n->neg = 0;
+    bn_normalize(n);
+    return 1;
+}
+
+// Value of a number of at most two limbs
+static uint64_t get_u64(const BigNum *n) {
+    return (n->len == 0) ? 0 : (n->len == 1) ? n->limbs[0] : (uint64_t)n->limbs[1] * BN_BASE + n->limbs[0];
+}
+
+// Binary GCD of two 64-bit integers
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+    int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    do {
+        b >>= __builtin_ctzll(b);
+        if (a > b) {
+            uint64_t t = a;
+            a = b;
+            b = t;
+        }
+        b -= a;
+    } while (b != 0);
+    return a << shift;
+}
+
+// The lowest p limbs of n, as a view
+static BigNum view_low(const BigNum *n, size_t p) {
+    size_t len = (n->len < p) ? n->len : p;
+    while (len > 0 && n->limbs[len - 1] == 0) {
+        len--;
+    }
+    return bn_view(n->limbs, len);
+}
+
+// n = n * BASE^p
+static int shift_up(BigNum *n, size_t p) {
+    if (n->len == 0) {
+        return 1;
+    }
+    if (!bn_reserve(n, n->len + p)) {
+        return 0;
+    }
+    memmove(n->limbs + p, n->limbs, n->len * sizeof(limb_t));
+    memset(n->limbs, 0, p * sizeof(limb_t));
+    n->len += p;
+    return 1;
+}
+
+/*
+ * r = X * x + Y * y for |X|, |Y| < LEHMER_COFACTOR_LIMIT, in one pass with a
+ * signed carry. r must not alias x or y.
+ */
+static int lincomb(BigNum *r, const BigNum *x, int64_t X, const BigNum *y, int64_t Y) {
+    size_t n = (x->len > y->len) ? x->len : y->len;
+    int64_t carry = 0;
+
+    if (!bn_reserve(r, n + 2)) {
+        return 0;
+    }
+    X = x->neg ? -X : X;
+    Y = y->neg ? -Y : Y;
+    for (size_t i = 0; i < n; i++) {
+        int64_t t = carry;
+        t += (i < x->len) ? X * x->limbs[i] : 0;
+        t += (i < y->len) ? Y * y->limbs[i] : 0;
+        carry = t / BN_BASE;
+        t -= carry * BN_BASE;
+        if (t < 0) {
+            t += BN_BASE;
+            carry--;
+        }
+        r->limbs[i] = (limb_t)t;
+    }
+
+    // A negative carry means the whole value is negative: take BASE^n - r and borrow from it
+    r->neg = carry < 0;
+    if (r->neg) {
+        int borrow = 0;
+        for (size_t i = 0; i < n; i++) {
+            int64_t d = -(int64_t)r->limbs[i] - borrow;
+            borrow = d < 0;
+            r->limbs[i] = (limb_t)(borrow ? d + BN_BASE : d);
+        }
+        carry = -carry - borrow;
+    }
+    r->limbs[n] = (limb_t)(carry % BN_BASE);
+    r->limbs[n + 1] = (limb_t)(carry / BN_BASE);
+    r->len = n + 2;
+    bn_normalize(r);
+    return 1;
+}
+
+static int matrix_init(GcdMatrix *M) {
+    for (int i = 0; i < 4; i++) {
+        bn_init(&M->u[i]);
+    }
+    M->det = 1;
+    return set_u64(&M->u[0], 1) && set_u64(&M->u[3], 1);
+}
+
+static void matrix_free(GcdMatrix *M) {
+    for (int i = 0; i < 4; i++) {
+        bn_free(&M->u[i]);
+    }
+}
+
+// M = M * M1
+static int matrix_mul(GcdMatrix *M, const GcdMatrix *M1) {
+    BigNum r[4], t;
+    int status = 1;
+
+    bn_init(&t);
+    for (int i = 0; i < 4; i++) {
+        bn_init(&r[i]);
+        int row = i & 2, col = i & 1;
+        status = status && bn_mul(&r[i], &M->u[row], &M1->u[col]) &&
+                 bn_mul(&t, &M->u[row + 1], &M1->u[col + 2]) && bn_add_inplace(&r[i], &t);
+    }
+    for (int i = 0; i < 4; i++) {
+        if (status) {
+            bn_swap(&M->u[i], &r[i]);
+        }
+        bn_free(&r[i]);
+    }
+    bn_free(&t);
+    M->det *= M1->det;
+    return status;
+}
+
+// One Euclidean division: (a, b) = (b, a mod b), and M = M * (q 1; 1 0)
+static int division_step(BigNum *a, BigNum *b, GcdMatrix *M) {
+    BigNum q, r, t;
+    int status;
+
+    bn_init(&q);
+    bn_init(&r);
+    bn_init(&t);
+    status = bn_divmod((M != NULL) ? &q : NULL, &r, a, b);
+    for (int row = 0; status && M != NULL && row < 4; row += 2) {
+        status = bn_mul(&t, &M->u[row], &q) && bn_add_inplace(&t, &M->u[row + 1]);
+        bn_swap(&M->u[row + 1], &M->u[row]);
+        bn_swap(&M->u[row], &t);
+    }
+    if (status) {
+        if (M != NULL) {
+            M->det = -M->det;
+        }
+        bn_swap(a, b);
+        bn_swap(b, &r);
+    }
+    bn_free(&q);
+    bn_free(&r);
+    bn_free(&t);
+    return status;
+}
+
+/*
+ * One step on a >= b > 0. Euclid runs on the top two limbs of a and the same
+ * limbs of b (Knuth's Algorithm L), keeping a quotient only when the bounds
+ * from both ends of the truncation agree on it, so every kept quotient is one
+ * the full numbers would produce. The cofactors (A B; C D) of the kept
+ * quotients are then applied to a and b in one pass. If no quotient is
+ * certain (e.g. b is much shorter than a) a full division is done instead.
+ */
+static int gcd_step(BigNum *a, BigNum *b, GcdMatrix *M) {
+    size_t n = a->len;
+    int64_t A = 1, B = 0, C = 0, D = 1;
+
+    if (n >= 2 && b->len + 1 >= n) {
+        int64_t x = (int64_t)a->limbs[n - 1] * BN_BASE + a->limbs[n - 2];
+        int64_t y = ((b->len == n) ? (int64_t)b->limbs[n - 1] * BN_BASE : 0) + b->limbs[n - 2];
+        while (y + C != 0 && y + D != 0) {
+            int64_t q = (x + A) / (y + C);
+            if (q != (x + B) / (y + D)) {
+                break;
+            }
+            __int128 next_c = (__int128)A - (__int128)q * C;
+            __int128 next_d = (__int128)B - (__int128)q * D;
+            if (next_c <= -LEHMER_COFACTOR_LIMIT || next_c >= LEHMER_COFACTOR_LIMIT ||
+                next_d <= -LEHMER_COFACTOR_LIMIT || next_d >= LEHMER_COFACTOR_LIMIT) {
+                break;
+            }
+            A = C;
+            C = (int64_t)next_c;
+            B = D;
+            D = (int64_t)next_d;
+            int64_t t = x - q * y;
+            x = y;
+            y = t;
+        }
+    }
+    if (B == 0) {
+        return division_step(a, b, M);
+    }
+
+    // (a'; b') = L (a; b) with L = (A B; C D), so M becomes M * L^-1 = M * det(L) (D -B; -C A)
+    BigNum t[4];
+    int status;
+    int det = (A * D - B * C > 0) ? 1 : -1;
+
+    for (int i = 0; i < 4; i++) {
+        bn_init(&t[i]);
+    }
+    status = lincomb(&t[0], a, A, b, B) && lincomb(&t[1], a, C, b, D);
+    if (status) {
+        bn_swap(a, &t[0]);
+        bn_swap(b, &t[1]);
+    }
+    for (int row = 0; status && M != NULL && row < 4; row += 2) {
+        status = lincomb(&t[row], &M->u[row], det * D, &M->u[row + 1], -det * C) &&
+                 lincomb(&t[row + 1], &M->u[row + 1], det * A, &M->u[row], -det * B);
+    }
+    if (status && M != NULL) {
+        for (int i = 0; i < 4; i++) {
+            bn_swap(&M->u[i], &t[i]);
+        }
+        M->det *= det;
+    }
+    for (int i = 0; i < 4; i++) {
+        bn_free(&t[i]);
+    }
+    return status;
+}
+
+// Restore a >= b >= 0 after a reduction computed from the top limbs only, recording the changes in M
+static void fix_pair(BigNum *a, BigNum *b, GcdMatrix *M) {
+    if (a->neg) {
+        bn_negate(a);
+        bn_negate(&M->u[0]);
+        bn_negate(&M->u[2]);
+        M->det = -M->det;
+    }
+    if (b->neg) {
+        bn_negate(b);
+        bn_negate(&M->u[1]);
+        bn_negate(&M->u[3]);
+        M->det = -M->det;
+    }
+    if (bn_compare(a, b) < 0) {
+        bn_swap(a, b);
+        bn_swap(&M->u[0], &M->u[1]);
+        bn_swap(&M->u[2], &M->u[3]);
+        M->det = -M->det;
+    }
+}
+
+/*
+ * Reduce a >= b by the matrix M1 that hgcd finds for their parts above the
+ * lowest p limbs. M1 is linear, so applying it to the whole numbers is exact:
+ * (a'; b') = (ah'; bh') * BASE^p + M1^-1 (al; bl), where (ah', bh') are the
+ * reduced high parts and M1^-1 = det (u3 -u1; -u2 u0). M becomes M * M1.
+ */
+static int hgcd_reduce(BigNum *a, BigNum *b, size_t p, GcdMatrix *M) {
+    BigNum ah, bh, t, u;
+    GcdMatrix M1;
+    BigNum al = view_low(a, p), bl = view_low(b, p);
+    BigNum a_high = bn_view(a->limbs + p, a->len - p);
+    BigNum b_high = (b->len > p) ? bn_view(b->limbs + p, b->len - p) : bn_view(NULL, 0);
+    int status;
+
+    bn_init(&ah);
+    bn_init(&bh);
+    bn_init(&t);
+    bn_init(&u);
+    status = matrix_init(&M1) && bn_copy(&ah, &a_high) && bn_copy(&bh, &b_high) && hgcd(&ah, &bh, &M1);
+
+    if (status && (M1.u[1].len != 0 || M1.u[2].len != 0)) {
+        status = bn_mul(&t, &M1.u[3], &al) && bn_mul(&u, &M1.u[1], &bl) && bn_sub_inplace(&t, &u) &&
+                 shift_up(&ah, p);
+        if (status) {
+            if (M1.det < 0) {
+                bn_negate(&t);
+            }
+            status = bn_add_inplace(&ah, &t);
+        }
+        status = status && bn_mul(&t, &M1.u[0], &bl) && bn_mul(&u, &M1.u[2], &al) && bn_sub_inplace(&t, &u) &&
+                 shift_up(&bh, p);
+        if (status) {
+            if (M1.det < 0) {
+                bn_negate(&t);
+            }
+            status = bn_add_inplace(&bh, &t);
+        }
+        if (status) {
+            bn_swap(a, &ah);
+            bn_swap(b, &bh);
+            fix_pair(a, b, &M1);
+            status = (M == NULL) || matrix_mul(M, &M1);
+        }
+    }
+    matrix_free(&M1);
+    bn_free(&ah);
+    bn_free(&bh);
+    bn_free(&t);
+    bn_free(&u);
+    return status;
+}
+
+/*
+ * Half-GCD: reduce a >= b >= 0 of n limbs until b has at most n/2 + 1 limbs,
+ * multiplying the steps into M (which may be NULL). Above the threshold the top
+ * half is reduced recursively first, then the top of what remains, so only
+ * about n/4 limbs are left for Lehmer steps.
+ */
+static int hgcd(BigNum *a, BigNum *b, GcdMatrix *M) {
+    size_t n = a->len;
+    size_t s = n / 2 + 1;
+    int status = 1;
+
+    if (b->len <= s) {
+        return 1;
+    }
+    if (n >= bn_hgcd_threshold) {
+        status = hgcd_reduce(a, b, n / 2, M);
+        while (status && b->len > s && a->len > (3 * n) / 4 + 1) {
+            status = gcd_step(a, b, M);
+        }
+        if (status && b->len > s && a->len > s + 2) {
+            status = hgcd_reduce(a, b, 2 * s - a->len + 1, M);
+        }
+    }
+    while (status && b->len > s) {
+        status = gcd_step(a, b, M);
+    }
+    return status;
+}
+
+// Euclid on a >= b >= 0 until b is zero and a is the GCD; with M, (a_in; b_in) = M (a; 0)
+static int gcd_reduce(BigNum *a, BigNum *b, GcdMatrix *M) {
+    int status = 1;
+
+    if (b->len > 0 && a->len > 2) {
+        STATS_TIER(STATS_GCD_LEHMER);
+    }
+    while (status && b->len > 0) {
+        if (M == NULL && a->len <= 2) {
+            STATS_TIER(STATS_GCD_BINARY);
+            status = set_u64(a, gcd_u64(get_u64(a), get_u64(b)));
+            b->len = 0;
+        } else if (a->len >= bn_hgcd_threshold && b->len > a->len / 2 + 1) {
+            STATS_TIER(STATS_GCD_HGCD);
+            status = hgcd(a, b, M);
+        } else {
+            status = gcd_step(a, b, M);
+        }
+    }
+    return status;
+}
+
+// r = gcd(a, b), never negative; gcd(0, 0) = 0
+int bn_gcd(BigNum *r, const BigNum *a, const BigNum *b) {
+    BigNum x, y;
+    int status;
+
+    bn_init(&x);
+    bn_init(&y);
+    status = bn_copy(&x, a) && bn_copy(&y, b);
+    x.neg = 0;
+    y.neg = 0;
+    if (bn_compare(&x, &y) < 0) {
+        bn_swap(&x, &y);
+    }
+    status = status && gcd_reduce(&x, &y, NULL);
+    if (status) {
+        bn_swap(r, &x);
+    }
+    bn_free(&x);
+    bn_free(&y);
+    return status;
+}
+
+/*
+ * g = gcd(a, b) = x*a + y*b. The cofactor of the larger magnitude is the one in
+ * (-k/2, k/2] with k = (smaller magnitude) / g, which makes the pair unique and
+ * as small as Euclid's; the other follows by exact division. x or y may be NULL.
+ */
+int bn_gcdext(BigNum *g, BigNum *x, BigNum *y, const BigNum *a, const BigNum *b) {
+    BigNum big = bn_view(a->limbs, a->len), small = bn_view(b->limbs, b->len);
+    BigNum u, v, cu, cv, k, t;
+    GcdMatrix M;
+    int swapped = bn_compare(&big, &small) < 0;
+    int status;
+
+    if (swapped) {
+        BigNum view = big;
+        big = small;
+        small = view;
+    }
+    bn_init(&u);
+    bn_init(&v);
+    bn_init(&cu);
+    bn_init(&cv);
+    bn_init(&k);
+    bn_init(&t);
+    status = matrix_init(&M) && bn_copy(&u, &big) && bn_copy(&v, &small) && gcd_reduce(&u, &v, &M);
+
+    if (status && small.len == 0) {
+        // gcd(a, 0) = |a| = 1 * |a|
+        status = set_u64(&cu, u.len != 0);
+    } else if (status) {
+        // (big; small) = M (g; 0), so g = det (u3 big - u1 small): cu = det u3
+        bn_swap(&cu, &M.u[3]);
+        if (M.det < 0) {
+            bn_negate(&cu);
+        }
+        status = bn_divmod(&k, NULL, &small, &u) && bn_divmod(NULL, &cu, &cu, &k) && bn_add(&t, &cu, &cu);
+        if (status) {
+            int c = bn_compare_abs(&t, &k);
+            if (c > 0 || (c == 0 && cu.neg)) {
+                status = cu.neg ? bn_add_inplace(&cu, &k) : bn_sub_inplace(&cu, &k);
+            }
+        }
+        // cv = (g - cu big) / small, exactly
+        status = status && bn_mul(&t, &cu, &big) && bn_sub(&t, &u, &t) && bn_divmod(&cv, NULL, &t, &small);
+    }
+
+    if (status) {
+        if (swapped) {
+            bn_swap(&cu, &cv);
+        }
+        if (a->neg) {
+            bn_negate(&cu);
+        }
+        if (b->neg) {
+            bn_negate(&cv);
+        }
+        bn_swap(g, &u);
+        if (x != NULL) {
+            bn_swap(x, &cu);
+        }
+        if (y != NULL) {
+            bn_swap(y, &cv);
+        }
+    }
+    matrix_free(&M);
+    bn_free(&u);
+    bn_free(&v);
+    bn_free(&cu);
+    bn_free(&cv);
+    bn_free(&k);
+    bn_free(&t);
+    return status;
+}
+
+// r = a^-1 mod m in [0, |m|); returns -1 if gcd(a, m) != 1 (or m is zero)
+int bn_modinv(BigNum *r, const BigNum *a, const BigNum *m) {
+    BigNum modulus = bn_view(m->limbs, m->len);
+    BigNum g, x;
+    int status;
+
+    if (m->len == 0) {
+        return -1;
+    }
+    bn_init(&g);
+    bn_init(&x);
+    status = bn_gcdext(&g, &x, NULL, a, &modulus);
+    if (status && !(g.len == 1 && g.limbs[0] == 1)) {
+        status = -1;
+    } else if (status) {
+        status = bn_divmod(NULL, &x, &x, &modulus) && (!x.neg || bn_add_inplace(&x, &modulus));
+        if (status) {
+            bn_swap(r, &x);
+        }
+    }
+    bn_free(&g);
+    bn_free(&x);
+    return status;
+}
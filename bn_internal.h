@@ -0,0 +1,82 @@
+/*
+ * File: bn_internal.h
+ * Description: Limb-array kernels shared by the BigNum implementation files.
+ *
+ * These functions work on raw arrays of base 10^9 limbs (least significant
+ * first) and do no allocation or normalization of their own. They are the
+ * building blocks of the public `bn_*` functions and are not meant to be used
+ * outside the BigNum implementation.
+ *
+ * Function Declarations:
+ * - limb_t limbs_add(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn):
+ *     r[0..an) = a + b for an >= bn, returns the carry out. r may equal a or b.
+ * - limb_t limbs_sub(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn):
+ *     r[0..an) = a - b for an >= bn, returns the borrow out. r may equal a or b.
+ * - int limbs_cmp(const limb_t *a, const limb_t *b, size_t n):
+ *     Compares two arrays of the same length (1, -1 or 0).
+ * - limb_t limbs_mul_small(limb_t *dst, const limb_t *src, size_t n, limb_t m):
+ *     dst[0..n) = src * m, returns the carry limb.
+ * - limb_t limbs_addmul_small(limb_t *r, const limb_t *a, size_t n, limb_t m):
+ *     r[0..n) += a * m, returns the carry limb. r may equal a.
+ * - limb_t limbs_div_small(limb_t *dst, const limb_t *src, size_t n, limb_t d):
+ *     dst[0..n) = src / d, returns the remainder.
+ * - int limbs_mul(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn):
+ *     r[0..an+bn) = a * b, picking the multiplication algorithm by size.
+ *     r must not overlap a or b. Returns 0 if scratch memory cannot be allocated.
+ * - int limbs_mul_ntt(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn):
+ *     r[0..an+bn) = a * b by NTT convolution (see `bn_ntt.c`). Same contract as limbs_mul.
+ * - BigNum bn_view(const limb_t *limbs, size_t len):
+ *     A read-only, non-negative BigNum over len limbs of an existing array (for
+ *     example the high part of another number). Its `cap` is 0; never use it as
+ *     a result.
+ *
+ * Vector kernels (see `bn_simd.c`): `bn_simd` holds the AVX2 or AVX-512 versions
+ * of the add, subtract and compare loops selected for this CPU, or NULL entries
+ * when only the scalar code applies. Each processes a prefix of whole vectors
+ * and returns how many limbs it handled; the callers in `bignum.c` finish the rest.
+ *
+ * Fork-join parallelism (see `bn_par.c`):
+ * - int bn_parallel_enabled(void): 1 if a thread pool is running.
+ * - void bn_task_fork(BnTask *t, void (*run)(void *arg), void *arg):
+ *     Makes run(arg) available to other threads (or runs it at once without a pool).
+ * - void bn_task_join(BnTask *t): Returns once the forked task has completed.
+ * - void bn_parallel_for(size_t n, size_t grain, void (*body)(void *arg, size_t begin, size_t end), void *arg):
+ *     Calls body on disjoint chunks covering [0, n), possibly in parallel.
+*/
+
+#ifndef BN_INTERNAL_H
+#define BN_INTERNAL_H
+
+#include "bignum.h"
+
+limb_t limbs_add(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn);
+limb_t limbs_sub(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn);
+int limbs_cmp(const limb_t *a, const limb_t *b, size_t n);
+limb_t limbs_mul_small(limb_t *dst, const limb_t *src, size_t n, limb_t m);
+limb_t limbs_addmul_small(limb_t *r, const limb_t *a, size_t n, limb_t m);
+limb_t limbs_div_small(limb_t *dst, const limb_t *src, size_t n, limb_t d);
+int limbs_mul(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn);
+int limbs_mul_ntt(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn);
+BigNum bn_view(const limb_t *limbs, size_t len);
+
+typedef struct BnSimdKernels {
+    size_t (*add)(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *carry);
+    size_t (*sub)(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *borrow);
+    size_t (*cmp)(const limb_t *a, const limb_t *b, size_t n);  // Limbs left after skipping equal top blocks
+} BnSimdKernels;
+
+extern BnSimdKernels bn_simd;
+
+// A forked unit of work; lives on the forking thread's stack until joined
+typedef struct BnTask {
+    void (*run)(void *arg);
+    void *arg;
+    int done;               // Set once run(arg) has returned
+} BnTask;
+
+int bn_parallel_enabled(void);
+void bn_task_fork(BnTask *t, void (*run)(void *arg), void *arg);
+void bn_task_join(BnTask *t);
+void bn_parallel_for(size_t n, size_t grain, void (*body)(void *arg, size_t begin, size_t end), void *arg);
+
+#endif // BN_INTERNAL_H
@@ -0,0 +1,403 @@
+/*
+ * File: bn_io.c
+ * Description: Conversion between the BigNum limb representation and decimal
+ *              text or the binary record format.
+ *
+ * Parsing is incremental: digits can be fed in chunks of any size (for example
+ * straight out of an I/O buffer or a memory mapping), so an operand never has to
+ * be copied into an intermediate string first. Digits are packed into limbs nine
+ * at a time as they arrive; because the number of digits is only known at the
+ * end, the limbs are collected most significant first and put in order by a
+ * single linear pass in `bn_parse_end`.
+ *
+ * Output is rendered into one buffer, nine digits per limb from a two-digit
+ * lookup table, and written with a single fwrite. Because the limb base is a
+ * power of ten, conversion in either direction is linear in the number of
+ * digits and needs no divide-and-conquer radix conversion. Numbers of up to
+ * PRINT_STACK_BYTES characters are rendered in a stack buffer, so printing a
+ * small result allocates nothing.
+ *
+ * The binary format (described in `bignum.h`) is the limb array itself behind
+ * a 32-byte header, so writing a number is a header plus one fwrite, and a
+ * record in a memory-mapped file can be used as an operand where it lies. The
+ * checksum in the header is `bn_hash`, a multiply-rotate hash over two limbs
+ * per step, so validating a record costs about as much as copying it.
+ *
+ * Functions:
+ * - void bn_parse_begin(BnParser *p, BigNum *n): Starts parsing into n.
+ * - int bn_parse_chunk(BnParser *p, const char *digits, size_t len): Feeds decimal digits.
+ * - int bn_parse_end(BnParser *p): Finishes parsing and normalizes the number.
+ * - int bn_from_string(BigNum *n, const char *digits, size_t len): Parses a digit string.
+ * - size_t bn_decimal_size(const BigNum *n): Upper bound on the length of n in decimal.
+ * - size_t bn_to_chars(char *buf, const BigNum *n): Renders n in decimal into buf.
+ * - int bn_print(FILE *fp, const BigNum *n): Writes a number in decimal.
+ * - uint64_t bn_hash(const BigNum *n, uint64_t seed): Hashes the value of a number.
+ * - size_t bn_binary_size(const BigNum *n): Length of the binary record of n.
+ * - size_t bn_to_binary(void *buf, const BigNum *n): Renders the binary record of n into buf.
+ * - int bn_write_binary(FILE *fp, const BigNum *n): Writes the binary record of n.
+ * - int bn_binary_view(BigNum *view, const void *data, size_t len, size_t *used): Uses a record in place.
+ * - int bn_from_binary(BigNum *n, const void *data, size_t len, size_t *used): Copies a record into n.
+ * - int bn_read_binary(BigNum *n, FILE *fp): Reads a record from a stream.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+
+#define PRINT_STACK_BYTES 256   // Numbers up to this many characters are printed without allocating
+#define BN_BINARY_SEED 0x41504331ull    // Seed of the record checksum
+
+// Records hold the limbs exactly as they are in memory
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The binary number format requires a little-endian host"
+#endif
+
+// Powers of ten used to realign a partial group of digits
+static const limb_t pow10_table[BN_BASE_DIGITS] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u
+};
+
+// Value of exactly nine decimal digits
+static inline limb_t parse_group(const char *d) {
+    limb_t high = (limb_t)(d[0] - '0') * 1000u + (limb_t)(d[1] - '0') * 100u +
+                  (limb_t)(d[2] - '0') * 10u + (limb_t)(d[3] - '0');
+    limb_t low = (limb_t)(d[4] - '0') * 10000u + (limb_t)(d[5] - '0') * 1000u +
+                 (limb_t)(d[6] - '0') * 100u + (limb_t)(d[7] - '0') * 10u + (limb_t)(d[8] - '0');
+    return high * 100000u + low;
+}
+
+// Start parsing a new number into n
+void bn_parse_begin(BnParser *p, BigNum *n) {
+    p->n = n;
+    p->group = 0;
+    p->group_digits = 0;
+    p->digits = 0;
+    n->len = 0;
+    n->neg = 0;
+}
+
+// Feed a run of decimal digits ('0'..'9' only)
+int bn_parse_chunk(BnParser *p, const char *digits, size_t len) {
+    BigNum *n = p->n;
+    limb_t group = p->group;
+    int group_digits = p->group_digits;
+
+    // Reserve for the worst case up front so the loop does not have to check
+    if (!bn_reserve(n, n->len + (group_digits + len) / BN_BASE_DIGITS + 1)) {
+        return 0;
+    }
+    size_t i = 0;
+    // Finish a partial group, then convert whole groups of nine digits at a time
+    while (i < len && group_digits != 0) {
+        group = group * 10 + (limb_t)(digits[i++] - '0');
+        if (++group_digits == BN_BASE_DIGITS) {
+            n->limbs[n->len++] = group;
+            group = 0;
+            group_digits = 0;
+        }
+    }
+    for (; i + BN_BASE_DIGITS <= len; i += BN_BASE_DIGITS) {
+        n->limbs[n->len++] = parse_group(digits + i); // Most significant group first
+    }
+    for (; i < len; i++) {
+        group = group * 10 + (limb_t)(digits[i] - '0'); // Fewer than nine digits left
+        group_digits++;
+    }
+    p->group = group;
+    p->group_digits = group_digits;
+    p->digits += len;
+    return 1;
+}
+
+// Put the collected groups in limb order and fold in the trailing partial group
+int bn_parse_end(BnParser *p) {
+    BigNum *n = p->n;
+
+    for (size_t i = 0, j = n->len; i + 1 < j; i++, j--) {
+        limb_t tmp = n->limbs[i];
+        n->limbs[i] = n->limbs[j - 1];
+        n->limbs[j - 1] = tmp;
+    }
+
+    if (p->group_digits > 0) {
+        // n = n * 10^r + group, where r is the number of trailing digits
+        if (!bn_reserve(n, n->len + 1)) {
+            return 0;
+        }
+        limb_t carry = limbs_mul_small(n->limbs, n->limbs, n->len, pow10_table[p->group_digits]);
+        n->limbs[n->len++] = carry;
+        limb_t group = p->group;
+        for (size_t i = 0; group != 0; i++) {
+            limb_t sum = n->limbs[i] + group;
+            group = (sum >= BN_BASE);
+            n->limbs[i] = group ? sum - BN_BASE : sum;
+        }
+    }
+    bn_normalize(n);
+    return 1;
+}
+
+// Parse a string consisting only of decimal digits
+int bn_from_string(BigNum *n, const char *digits, size_t len) {
+    BnParser parser;
+    bn_parse_begin(&parser, n);
+    return bn_parse_chunk(&parser, digits, len) && bn_parse_end(&parser);
+}
+
+// Write the nine decimal digits of a limb (with leading zeros) to out
+static inline void format_group(char *out, limb_t v) {
+    static const char pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    limb_t high = v / 10000u;   // Top five digits
+    limb_t low = v % 10000u;    // Bottom four digits
+
+    memcpy(out + 7, pairs + 2 * (low % 100u), 2);
+    memcpy(out + 5, pairs + 2 * (low / 100u), 2);
+    memcpy(out + 3, pairs + 2 * (high % 100u), 2);
+    memcpy(out + 1, pairs + 2 * (high / 100u % 100u), 2);
+    out[0] = (char)('0' + high / 10000u);
+}
+
+// Upper bound on the number of characters bn_to_chars writes
+size_t bn_decimal_size(const BigNum *n) {
+    return (n->len == 0) ? 1 : n->len * BN_BASE_DIGITS + n->neg;
+}
+
+// Render n in decimal into buf (at least bn_decimal_size(n) bytes), returns the length written
+size_t bn_to_chars(char *buf, const BigNum *n) {
+    char first[BN_BASE_DIGITS];
+
+    if (n->len == 0) {
+        buf[0] = '0';
+        return 1;
+    }
+    size_t pos = 0;
+    if (n->neg) {
+        buf[pos++] = '-';
+    }
+    // The top limb is written without leading zeros
+    format_group(first, n->limbs[n->len - 1]);
+    size_t skip = 0;
+    while (skip < BN_BASE_DIGITS - 1 && first[skip] == '0') {
+        skip++;
+    }
+    memcpy(buf + pos, first + skip, BN_BASE_DIGITS - skip);
+    pos += BN_BASE_DIGITS - skip;
+    for (size_t i = n->len - 1; i-- > 0;) {
+        format_group(buf + pos, n->limbs[i]);
+        pos += BN_BASE_DIGITS;
+    }
+    return pos;
+}
+
+// Write a number in decimal with a single fwrite; small numbers are rendered on the stack
+int bn_print(FILE *fp, const BigNum *n) {
+    char small[PRINT_STACK_BYTES];
+    size_t size = bn_decimal_size(n);
+    char *buf = (size <= sizeof(small)) ? small : (char *)malloc(size);
+    if (buf == NULL) {
+        return 0;
+    }
+    size_t len = bn_to_chars(buf, n);
+    int status = fwrite(buf, 1, len, fp) == len;
+    if (buf != small) {
+        free(buf);
+    }
+    return status;
+}
+
+// Store a 64-bit value little-endian
+static void store_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+// Load a little-endian 64-bit value
+static uint64_t load_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 8; i-- > 0;) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+// Final avalanche of a 64-bit hash
+static inline uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 33);
+}
+
+// One step of the hash over up to two limbs
+static inline uint64_t hash_step(uint64_t h, uint64_t w) {
+    h ^= w * 0x9e3779b97f4a7c15ull;
+    return ((h << 31) | (h >> 33)) * 0x87c37b91114253d5ull;
+}
+
+// 64-bit hash of the value of n (sign, length and limbs); different seeds give independent hashes
+uint64_t bn_hash(const BigNum *n, uint64_t seed) {
+    uint64_t h = hash_step(seed, ((uint64_t)n->len << 1) | (uint64_t)n->neg);
+    size_t i = 0;
+    for (; i + 2 <= n->len; i += 2) {
+        h = hash_step(h, n->limbs[i] | ((uint64_t)n->limbs[i + 1] << 32));
+    }
+    if (i < n->len) {
+        h = hash_step(h, n->limbs[i]);
+    }
+    return hash_mix(h);
+}
+
+// Bytes of the binary record of n
+size_t bn_binary_size(const BigNum *n) {
+    return BN_BINARY_HEADER + n->len * sizeof(limb_t);
+}
+
+// Fill in the header of the binary record of n
+static void binary_header(unsigned char *h, const BigNum *n) {
+    memcpy(h, BN_BINARY_MAGIC, 4);
+    h[4] = BN_BINARY_VERSION;
+    h[5] = 0;
+    h[6] = (unsigned char)n->neg;
+    h[7] = 0;
+    store_u64(h + 8, n->len);
+    store_u64(h + 16, bn_hash(n, BN_BINARY_SEED));
+    store_u64(h + 24, 0);
+}
+
+// Render the binary record of n into buf (bn_binary_size(n) bytes), returns its length
+size_t bn_to_binary(void *buf, const BigNum *n) {
+    binary_header((unsigned char *)buf, n);
+    if (n->len > 0) {
+        memcpy((unsigned char *)buf + BN_BINARY_HEADER, n->limbs, n->len * sizeof(limb_t));
+    }
+    return bn_binary_size(n);
+}
+
+// Write the binary record of n: the header, then the limbs straight from memory
+int bn_write_binary(FILE *fp, const BigNum *n) {
+    unsigned char header[BN_BINARY_HEADER];
+    binary_header(header, n);
+    return fwrite(header, 1, sizeof(header), fp) == sizeof(header) &&
+           (n->len == 0 || fwrite(n->limbs, sizeof(limb_t), n->len, fp) == n->len);
+}
+
+// Validate a record header; returns the number of limbs, or SIZE_MAX if the header is malformed
+static size_t binary_limbs(const unsigned char *h, size_t avail, int *neg, uint64_t *checksum) {
+    if (memcmp(h, BN_BINARY_MAGIC, 4) != 0 || h[4] != BN_BINARY_VERSION || h[5] != 0 || h[6] > 1 || h[7] != 0 ||
+        load_u64(h + 24) != 0) {
+        return SIZE_MAX;
+    }
+    uint64_t limbs = load_u64(h + 8);
+    if (limbs > avail / sizeof(limb_t) || (limbs == 0 && h[6] != 0)) {
+        return SIZE_MAX;
+    }
+    *neg = h[6];
+    *checksum = load_u64(h + 16);
+    return (size_t)limbs;
+}
+
+// Check that a number read from a record is normalized, in range and matches its checksum
+static int binary_valid(const BigNum *n, uint64_t checksum) {
+    if (n->len > 0 && n->limbs[n->len - 1] == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < n->len; i++) {
+        if (n->limbs[i] >= BN_BASE) {
+            return 0;
+        }
+    }
+    return bn_hash(n, BN_BINARY_SEED) == checksum;
+}
+
+// Point view at the number in the record at data without copying; returns 0 if it is malformed
+int bn_binary_view(BigNum *view, const void *data, size_t len, size_t *used) {
+    uint64_t checksum;
+    int neg;
+
+    if (len < BN_BINARY_HEADER || ((uintptr_t)data % sizeof(limb_t)) != 0) {
+        return 0;
+    }
+    size_t limbs = binary_limbs((const unsigned char *)data, len - BN_BINARY_HEADER, &neg, &checksum);
+    if (limbs == SIZE_MAX) {
+        return 0;
+    }
+    view->limbs = (limb_t *)((const unsigned char *)data + BN_BINARY_HEADER);
+    view->len = limbs;
+    view->cap = 0;
+    view->neg = neg;
+    if (!binary_valid(view, checksum)) {
+        return 0;
+    }
+    if (used != NULL) {
+        *used = BN_BINARY_HEADER + limbs * sizeof(limb_t);
+    }
+    return 1;
+}
+
+// Copy the number in the record at data into n; returns 0 if it is malformed or memory runs out
+int bn_from_binary(BigNum *n, const void *data, size_t len, size_t *used) {
+    BigNum view;
+    if ((uintptr_t)data % sizeof(limb_t) == 0) {
+        return bn_binary_view(&view, data, len, used) && bn_copy(n, &view);
+    }
+
+    // Unaligned records are validated in n itself
+    uint64_t checksum;
+    int neg;
+    if (len < BN_BINARY_HEADER) {
+        return 0;
+    }
+    size_t limbs = binary_limbs((const unsigned char *)data, len - BN_BINARY_HEADER, &neg, &checksum);
+    if (limbs == SIZE_MAX || !bn_reserve(n, limbs)) {
+        return 0;
+    }
+    if (limbs > 0) {
+        memcpy(n->limbs, (const unsigned char *)data + BN_BINARY_HEADER, limbs * sizeof(limb_t));
+    }
+    n->len = limbs;
+    n->neg = neg;
+    if (!binary_valid(n, checksum)) {
+        n->len = 0;
+        n->neg = 0;
+        return 0;
+    }
+    if (used != NULL) {
+        *used = BN_BINARY_HEADER + limbs * sizeof(limb_t);
+    }
+    return 1;
+}
+
+// Read one binary record from a stream into n; returns 1, 0 for a malformed record or -1 at the end
+int bn_read_binary(BigNum *n, FILE *fp) {
+    unsigned char header[BN_BINARY_HEADER];
+    uint64_t checksum;
+    int neg;
+
+    size_t got = fread(header, 1, sizeof(header), fp);
+    if (got == 0 && feof(fp)) {
+        return -1;
+    }
+    if (got != sizeof(header)) {
+        return 0;
+    }
+    size_t limbs = binary_limbs(header, SIZE_MAX, &neg, &checksum);
+    if (limbs == SIZE_MAX || !bn_reserve(n, limbs) ||
+        (limbs > 0 && fread(n->limbs, sizeof(limb_t), limbs, fp) != limbs)) {
+        return 0;
+    }
+    n->len = limbs;
+    n->neg = neg;
+    if (!binary_valid(n, checksum)) {
+        n->len = 0;
+        n->neg = 0;
+        return 0;
+    }
+    return 1;
+}
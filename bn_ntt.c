@@ -0,0 +1,439 @@
+/*
+ * File: bn_ntt.c
+ * Description: Number-theoretic transform (NTT) multiplication for very large operands.
+ *
+ * The product of two limb arrays is the convolution of their limbs followed by
+ * carry propagation. For large operands the convolution is computed with NTTs,
+ * which cost O(N log N) instead of the O(N^1.46) of Toom-3.
+ *
+ * The transforms run modulo two 62-bit primes of the form c * 2^50 + 1, so
+ * power-of-two transform lengths up to 2^50 exist for both. Every convolution
+ * coefficient is at most min(an, bn) * (10^9 - 1)^2, and since the transform
+ * length an + bn is at most 2^50, min(an, bn) <= 2^49 keeps that below 2^109.
+ * The product of the two primes is about 2.06e37 (just under 2^124), so the
+ * coefficients are smaller and combining the two residues with the Chinese
+ * remainder theorem yields each one exactly. There is no floating-point
+ * rounding anywhere.
+ *
+ * Modular multiplication uses Montgomery reduction with R = 2^64; all values
+ * inside the transforms are kept in Montgomery form. A square (a and b the
+ * same array) skips the second forward transform of each convolution.
+ *
+ * Once the shorter operand reaches `bn_parallel_threshold` limbs and a thread
+ * pool is running (see `bn_par.c`), the work is split across threads: the two
+ * convolutions run side by side, the forward transforms of both operands are
+ * independent, each transform forks its two half-size sub-transforms below the
+ * outermost stage, the element-wise loops run in slices and the CRT
+ * recombination runs in blocks whose carries are propagated afterwards.
+ *
+ * Functions:
+ * - int limbs_mul_ntt(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn):
+ *     Multiplies two limb arrays into r[0..an+bn) via NTT convolution.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+#include "stats.h"
+
+#define NTT_PARALLEL_GRAIN 16384   // Work below this many elements is not split across threads
+#define NTT_CRT_BLOCK 65536         // Coefficients recombined per independent block
+
+typedef unsigned __int128 u128;
+
+// Modulus together with its Montgomery constants
+typedef struct NttPrime {
+    uint64_t p;             // The prime
+    uint64_t generator;     // A primitive root modulo p
+    uint64_t pinv;          // -p^-1 mod 2^64
+    uint64_t r2;            // 2^128 mod p, converts into Montgomery form
+} NttPrime;
+
+static const NttPrime ntt_primes[2] = {
+    { 4601552919265804289ull, 3, 4601552919265804287ull, 4513375700283176271ull },  // 4087 * 2^50 + 1
+    { 4479955729326800897ull, 3, 4479955729326800895ull, 230758830969758588ull },   // 3979 * 2^50 + 1
+};
+
+// Montgomery product a * b * 2^-64 mod p
+static inline uint64_t mont_mul(uint64_t a, uint64_t b, const NttPrime *m) {
+    u128 t = (u128)a * b;
+    uint64_t k = (uint64_t)t * m->pinv;
+    uint64_t r = (uint64_t)((t + (u128)k * m->p) >> 64);
+    return (r >= m->p) ? r - m->p : r;
+}
+
+static inline uint64_t mod_add(uint64_t a, uint64_t b, uint64_t p) {
+    uint64_t s = a + b;
+    return (s >= p) ? s - p : s;
+}
+
+static inline uint64_t mod_sub(uint64_t a, uint64_t b, uint64_t p) {
+    return (a >= b) ? a - b : a + p - b;
+}
+
+// x^e for x in Montgomery form, result in Montgomery form
+static uint64_t mont_pow(uint64_t x, uint64_t e, const NttPrime *m) {
+    uint64_t result = mont_mul(1, m->r2, m);
+    while (e > 0) {
+        if (e & 1) {
+            result = mont_mul(result, x, m);
+        }
+        x = mont_mul(x, x, m);
+        e >>= 1;
+    }
+    return result;
+}
+
+// DIF butterfly: (u, v) -> (u + v, (u - v) * w)
+static inline void butterfly_dif(uint64_t *x, uint64_t *y, uint64_t w, const NttPrime *m) {
+    uint64_t u = *x;
+    uint64_t v = *y;
+    *x = mod_add(u, v, m->p);
+    *y = mont_mul(mod_sub(u, v, m->p), w, m);
+}
+
+// DIT butterfly: (u, v) -> (u + v * w, u - v * w)
+static inline void butterfly_dit(uint64_t *x, uint64_t *y, uint64_t w, const NttPrime *m) {
+    uint64_t u = *x;
+    uint64_t v = mont_mul(*y, w, m);
+    *x = mod_add(u, v, m->p);
+    *y = mod_sub(u, v, m->p);
+}
+
+// Decimation-in-frequency transform: natural order in, bit-reversed order out
+static void ntt_forward(uint64_t *x, size_t n, const uint64_t *table, const NttPrime *m) {
+    for (size_t len = n / 2; len >= 1; len /= 2) {
+        const uint64_t *w = table + len;
+        for (size_t i = 0; i < n; i += 2 * len) {
+            for (size_t j = 0; j < len; j++) {
+                butterfly_dif(&x[i + j], &x[i + j + len], w[j], m);
+            }
+        }
+    }
+}
+
+// Decimation-in-time inverse transform: bit-reversed order in, natural order out (unscaled)
+static void ntt_inverse(uint64_t *x, size_t n, const uint64_t *table, const NttPrime *m) {
+    for (size_t len = 1; len < n; len *= 2) {
+        const uint64_t *w = table + len;
+        for (size_t i = 0; i < n; i += 2 * len) {
+            for (size_t j = 0; j < len; j++) {
+                butterfly_dit(&x[i + j], &x[i + j + len], w[j], m);
+            }
+        }
+    }
+}
+
+/*
+ * Arguments shared by the loops below. Each loop runs through bn_parallel_for,
+ * which calls it on disjoint index ranges; without a thread pool (or below the
+ * parallel threshold, where `grain` covers the whole range) it is simply called
+ * once on the full range.
+ */
+typedef struct NttLoop {
+    uint64_t *x;            // Buffer being written
+    const uint64_t *y;      // Second operand of the pointwise product
+    const uint64_t *table;  // Twiddle table
+    const limb_t *src;      // Limbs being loaded
+    size_t src_len;         // Number of limbs in src
+    size_t n;               // Length of the (sub)transform
+    size_t grain;           // Smallest piece of work handed to another thread
+    uint64_t value;         // Root of unity or scale factor (Montgomery form)
+    const NttPrime *m;
+} NttLoop;
+
+// Load limbs into a zero-padded transform buffer in Montgomery form
+static void ntt_load_body(void *arg, size_t begin, size_t end) {
+    NttLoop *loop = (NttLoop *)arg;
+    size_t i = begin;
+    for (; i < end && i < loop->src_len; i++) {
+        loop->x[i] = mont_mul(loop->src[i], loop->m->r2, loop->m);
+    }
+    if (i < end) {
+        memset(loop->x + i, 0, (end - i) * sizeof(uint64_t));
+    }
+}
+
+// table[half + j] = root^j, starting each range from its own power of the root
+static void ntt_twiddle_body(void *arg, size_t begin, size_t end) {
+    NttLoop *loop = (NttLoop *)arg;
+    uint64_t *powers = loop->x + loop->n / 2;
+    uint64_t w = mont_pow(loop->value, begin, loop->m);
+    for (size_t j = begin; j < end; j++) {
+        powers[j] = w;
+        w = mont_mul(w, loop->value, loop->m);
+    }
+}
+
+// x[i] *= y[i]
+static void ntt_pointwise_body(void *arg, size_t begin, size_t end) {
+    NttLoop *loop = (NttLoop *)arg;
+    for (size_t i = begin; i < end; i++) {
+        loop->x[i] = mont_mul(loop->x[i], loop->y[i], loop->m);
+    }
+}
+
+// x[i] *= value, also leaving Montgomery form when value is a plain residue
+static void ntt_scale_body(void *arg, size_t begin, size_t end) {
+    NttLoop *loop = (NttLoop *)arg;
+    for (size_t i = begin; i < end; i++) {
+        loop->x[i] = mont_mul(loop->x[i], loop->value, loop->m);
+    }
+}
+
+// One slice of the outermost DIF stage of a length-n transform
+static void ntt_forward_stage_body(void *arg, size_t begin, size_t end) {
+    NttLoop *loop = (NttLoop *)arg;
+    size_t half = loop->n / 2;
+    const uint64_t *w = loop->table + half;
+    for (size_t j = begin; j < end; j++) {
+        butterfly_dif(&loop->x[j], &loop->x[j + half], w[j], loop->m);
+    }
+}
+
+// One slice of the outermost DIT stage of a length-n transform
+static void ntt_inverse_stage_body(void *arg, size_t begin, size_t end) {
+    NttLoop *loop = (NttLoop *)arg;
+    size_t half = loop->n / 2;
+    const uint64_t *w = loop->table + half;
+    for (size_t j = begin; j < end; j++) {
+        butterfly_dit(&loop->x[j], &loop->x[j + half], w[j], loop->m);
+    }
+}
+
+/*
+ * Fill the twiddle table for a transform of length n: entries [len, 2len) hold
+ * the powers w^0 .. w^(len-1) of a primitive (2len)-th root of unity w, for
+ * every power of two len < n. `root` is a primitive n-th root in Montgomery form.
+ */
+static void ntt_twiddles(uint64_t *table, size_t n, uint64_t root, size_t grain, const NttPrime *m) {
+    NttLoop loop = { .x = table, .n = n, .value = root, .m = m };
+    bn_parallel_for(n / 2, grain, ntt_twiddle_body, &loop);
+    for (size_t len = n / 4; len >= 1; len /= 2) {
+        for (size_t j = 0; j < len; j++) {
+            table[len + j] = table[2 * len + 2 * j];
+        }
+    }
+}
+
+static void ntt_forward_split(uint64_t *x, size_t n, const uint64_t *table, size_t grain, const NttPrime *m);
+static void ntt_inverse_split(uint64_t *x, size_t n, const uint64_t *table, size_t grain, const NttPrime *m);
+
+static void ntt_forward_task(void *arg) {
+    NttLoop *loop = (NttLoop *)arg;
+    ntt_forward_split(loop->x, loop->n, loop->table, loop->grain, loop->m);
+}
+
+static void ntt_inverse_task(void *arg) {
+    NttLoop *loop = (NttLoop *)arg;
+    ntt_inverse_split(loop->x, loop->n, loop->table, loop->grain, loop->m);
+}
+
+/*
+ * Forward transform split for parallelism: after the outermost stage the two
+ * halves are independent transforms of length n/2 using the same twiddle
+ * table, so they are forked until they are no longer than `grain`.
+ */
+static void ntt_forward_split(uint64_t *x, size_t n, const uint64_t *table, size_t grain, const NttPrime *m) {
+    if (n <= grain) {
+        ntt_forward(x, n, table, m);
+        return;
+    }
+    NttLoop loop = { .x = x, .table = table, .n = n, .grain = grain, .m = m };
+    bn_parallel_for(n / 2, grain, ntt_forward_stage_body, &loop);
+
+    NttLoop upper = loop;
+    BnTask task;
+    upper.x = x + n / 2;
+    upper.n = n / 2;
+    bn_task_fork(&task, ntt_forward_task, &upper);
+    ntt_forward_split(x, n / 2, table, grain, m);
+    bn_task_join(&task);
+}
+
+// Inverse transform split like ntt_forward_split: the two halves first, then the outermost stage
+static void ntt_inverse_split(uint64_t *x, size_t n, const uint64_t *table, size_t grain, const NttPrime *m) {
+    if (n <= grain) {
+        ntt_inverse(x, n, table, m);
+        return;
+    }
+    NttLoop loop = { .x = x, .table = table, .n = n, .grain = grain, .m = m };
+    NttLoop upper = loop;
+    BnTask task;
+    upper.x = x + n / 2;
+    upper.n = n / 2;
+    bn_task_fork(&task, ntt_inverse_task, &upper);
+    ntt_inverse_split(x, n / 2, table, grain, m);
+    bn_task_join(&task);
+
+    bn_parallel_for(n / 2, grain, ntt_inverse_stage_body, &loop);
+}
+
+// One cyclic convolution modulo one prime
+typedef struct NttConvolution {
+    uint64_t *fa;           // Receives the result (plain residues, not Montgomery form)
+    uint64_t *fb;           // Scratch of n entries
+    uint64_t *table;        // Scratch of n entries for the twiddles
+    size_t n;               // Transform length
+    const limb_t *a;
+    size_t an;
+    const limb_t *b;
+    size_t bn;
+    size_t grain;           // Parallel grain, or n to run serially
+    const NttPrime *m;
+} NttConvolution;
+
+static void ntt_forward_b_task(void *arg) {
+    NttConvolution *c = (NttConvolution *)arg;
+    ntt_forward_split(c->fb, c->n, c->table, c->grain, c->m);
+}
+
+// Cyclic convolution of a and b modulo one prime
+static void ntt_convolve(void *arg) {
+    NttConvolution *c = (NttConvolution *)arg;
+    const NttPrime *m = c->m;
+    size_t n = c->n;
+    uint64_t g = mont_mul(m->generator, m->r2, m);
+    uint64_t root = mont_pow(g, (m->p - 1) / n, m);
+    int square = (c->a == c->b && c->an == c->bn);
+    NttLoop loop = { .x = c->fa, .src = c->a, .src_len = c->an, .m = m };
+    BnTask task;
+
+    bn_parallel_for(n, c->grain, ntt_load_body, &loop);
+    ntt_twiddles(c->table, n, root, c->grain, m);
+    if (square) {
+        // A square transforms its operand once and multiplies it by itself
+        ntt_forward_split(c->fa, n, c->table, c->grain, m);
+    } else {
+        loop.x = c->fb;
+        loop.src = c->b;
+        loop.src_len = c->bn;
+        bn_parallel_for(n, c->grain, ntt_load_body, &loop);
+
+        // The two forward transforms are independent
+        bn_task_fork(&task, ntt_forward_b_task, c);
+        ntt_forward_split(c->fa, n, c->table, c->grain, m);
+        bn_task_join(&task);
+    }
+
+    loop.x = c->fa;
+    loop.y = square ? c->fa : c->fb;
+    bn_parallel_for(n, c->grain, ntt_pointwise_body, &loop);
+
+    // The inverse transform uses the inverse root; n^-1 is folded into leaving Montgomery form
+    ntt_twiddles(c->table, n, mont_pow(root, n - 1, m), c->grain, m);
+    ntt_inverse_split(c->fa, n, c->table, c->grain, m);
+    uint64_t n_inv = mont_pow(mont_mul(n, m->r2, m), m->p - 2, m);
+    loop.value = mont_mul(n_inv, 1, m); // n^-1 as a plain residue
+    bn_parallel_for(n, c->grain, ntt_scale_body, &loop);
+}
+
+// Divide x by 10^9 in place and return the remainder, using 64-bit divisions only
+static inline limb_t u128_divmod_base(u128 *x) {
+    uint64_t hi = (uint64_t)(*x >> 64);
+    uint64_t lo = (uint64_t)*x;
+    uint64_t q_hi = hi / BN_BASE;
+    uint64_t rem = hi % BN_BASE;
+    uint64_t t = (rem << 32) | (lo >> 32);
+    uint64_t q_mid = t / BN_BASE;
+    rem = t % BN_BASE;
+    t = (rem << 32) | (lo & 0xffffffffu);
+    uint64_t q_low = t / BN_BASE;
+    rem = t % BN_BASE;
+    *x = ((u128)q_hi << 64) | (q_mid << 32) | q_low;
+    return (limb_t)rem;
+}
+
+// Arguments of the CRT recombination, which runs in independent blocks
+typedef struct NttCrt {
+    limb_t *r;
+    const uint64_t *residue1;
+    const uint64_t *residue2;
+    size_t total;           // Limbs of the product
+    u128 *carries;          // Carry out of each block
+    uint64_t p1_inv;        // p1^-1 mod p2, Montgomery form
+} NttCrt;
+
+/*
+ * c = r1 + p1 * ((r2 - r1) * p1^-1 mod p2) for every coefficient of the blocks,
+ * propagating carries in base 10^9 within each block only.
+ */
+static void ntt_crt_body(void *arg, size_t begin, size_t end) {
+    NttCrt *crt = (NttCrt *)arg;
+    const NttPrime *m1 = &ntt_primes[0];
+    const NttPrime *m2 = &ntt_primes[1];
+    for (size_t block = begin; block < end; block++) {
+        size_t first = block * NTT_CRT_BLOCK;
+        size_t last = (first + NTT_CRT_BLOCK < crt->total) ? first + NTT_CRT_BLOCK : crt->total;
+        u128 carry = 0;
+        for (size_t i = first; i < last; i++) {
+            uint64_t r1 = crt->residue1[i];
+            uint64_t diff = mod_sub(crt->residue2[i], r1 % m2->p, m2->p);
+            uint64_t k = mont_mul(diff, crt->p1_inv, m2);
+            carry += (u128)k * m1->p + r1;
+            crt->r[i] = u128_divmod_base(&carry);
+        }
+        crt->carries[block] = carry;
+    }
+}
+
+// r[0..an+bn) = a * b via two-prime NTT convolution and CRT recombination
+int limbs_mul_ntt(limb_t *r, const limb_t *a, size_t an, const limb_t *b, size_t bn) {
+    size_t total = an + bn;
+    size_t n = 1;
+    while (n < total) {
+        n *= 2;
+    }
+
+    // Large products run the two convolutions side by side, each with its own scratch
+    int parallel = bn_parallel_enabled() && bn >= bn_parallel_threshold;
+    STATS_TIER(parallel ? STATS_MUL_NTT_PARALLEL : STATS_MUL_NTT);
+    size_t blocks = (total + NTT_CRT_BLOCK - 1) / NTT_CRT_BLOCK;
+    size_t buffers = parallel ? 6 : 4;
+    uint64_t *buffer = (uint64_t *)malloc(buffers * n * sizeof(uint64_t));
+    u128 *carries = (u128 *)malloc(blocks * sizeof(u128));
+    if (buffer == NULL || carries == NULL) {
+        free(buffer);
+        free(carries);
+        return 0;
+    }
+
+    NttConvolution conv1 = { buffer, buffer + 2 * n, buffer + 3 * n, n, a, an, b, bn, n, &ntt_primes[0] };
+    NttConvolution conv2 = { buffer + n, buffer + 2 * n, buffer + 3 * n, n, a, an, b, bn, n, &ntt_primes[1] };
+    if (parallel) {
+        BnTask task;
+        conv1.grain = conv2.grain = NTT_PARALLEL_GRAIN;
+        conv2.fb = buffer + 4 * n;
+        conv2.table = buffer + 5 * n;
+        bn_task_fork(&task, ntt_convolve, &conv2);
+        ntt_convolve(&conv1);
+        bn_task_join(&task);
+    } else {
+        ntt_convolve(&conv1);
+        ntt_convolve(&conv2);
+    }
+
+    // Recombine block by block, then carry each block's overflow into the next
+    const NttPrime *m1 = &ntt_primes[0];
+    const NttPrime *m2 = &ntt_primes[1];
+    uint64_t p1_mod_p2 = m1->p % m2->p;
+    NttCrt crt = { r, conv1.fa, conv2.fa, total, carries,
+                   mont_pow(mont_mul(p1_mod_p2, m2->r2, m2), m2->p - 2, m2) };
+    bn_parallel_for(blocks, parallel ? 1 : blocks, ntt_crt_body, &crt);
+
+    u128 carry = 0;
+    for (size_t block = 0; block < blocks; block++) {
+        size_t i = block * NTT_CRT_BLOCK;
+        size_t last = (i + NTT_CRT_BLOCK < total) ? i + NTT_CRT_BLOCK : total;
+        for (; carry != 0 && i < last; i++) {
+            carry += r[i];
+            r[i] = u128_divmod_base(&carry);
+        }
+        carry += carries[block];
+    }
+
+    free(carries);
+    free(buffer);
+    return 1;
+}
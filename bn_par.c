@@ -0,0 +1,304 @@
+/*
+ * File: bn_par.c
+ * Description: Work-stealing fork-join thread pool used to split very large
+ *              multiplications across cores.
+ *
+ * Every pool thread owns a deque of forked tasks; threads that are not part of
+ * the pool (the main thread, batch workers) share one extra deque. A thread
+ * pushes the tasks it forks onto the bottom of its deque and, when it joins a
+ * task that nobody has taken yet, simply takes it back and runs it inline. Idle
+ * threads steal the oldest task from the top of any deque, which tends to be
+ * the largest piece of work still pending. A thread waiting in a join helps by
+ * running other stolen tasks, so nested fork-join (e.g. a parallel transform
+ * inside a batch worker) cannot deadlock.
+ *
+ * With one thread (the default) no pool exists: forked tasks run immediately.
+ *
+ * Functions:
+ * - int bn_set_threads(int threads): Starts, resizes or stops the pool.
+ * - int bn_parallel_enabled(void): Reports whether forked tasks can run in parallel.
+ * - void bn_task_fork(BnTask *t, void (*run)(void *arg), void *arg): Forks a task.
+ * - void bn_task_join(BnTask *t): Waits for a forked task, helping meanwhile.
+ * - void bn_parallel_for(size_t n, size_t grain, void (*body)(void *, size_t, size_t), void *arg):
+ *     Runs body over [0, n) in parallel chunks of at least `grain` iterations.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "bignum.h"
+#include "bn_internal.h"
+
+#define DEQUE_CAPACITY 256      // Forked tasks pending per thread; beyond this tasks run inline
+
+size_t bn_parallel_threshold = 20000;
+
+typedef struct TaskDeque {
+    pthread_mutex_t lock;
+    BnTask *tasks[DEQUE_CAPACITY];  // Oldest task at index 0
+    size_t count;
+} TaskDeque;
+
+typedef struct TaskPool {
+    int threads;                // Pool threads plus the calling thread
+    pthread_t *workers;         // threads - 1 pool threads
+    int started;                // Pool threads actually running
+    TaskDeque *deques;          // One per pool thread, plus one shared by outside threads
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;   // Signaled when tasks are queued or completed
+    int queued;                 // Tasks sitting in deques (guarded by idle_lock; briefly
+                                // negative when a task is stolen before it is counted)
+    int shutdown;
+} TaskPool;
+
+static TaskPool *pool = NULL;
+static __thread int worker_index = -1; // Deque of the current pool thread, -1 outside the pool
+
+// Deque used by the calling thread
+static TaskDeque *own_deque(void) {
+    return &pool->deques[(worker_index >= 0) ? worker_index : pool->threads - 1];
+}
+
+// Count a newly queued task and wake idle threads
+static void pool_task_queued(void) {
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->queued++;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+// Take the oldest task from any deque, starting with the caller's neighbour
+static BnTask *steal_task(void) {
+    int total = pool->threads;
+    int start = (worker_index >= 0) ? worker_index + 1 : 0;
+
+    for (int k = 0; k < total; k++) {
+        TaskDeque *d = &pool->deques[(start + k) % total];
+        BnTask *t = NULL;
+        pthread_mutex_lock(&d->lock);
+        if (d->count > 0) {
+            t = d->tasks[0];
+            d->count--;
+            memmove(d->tasks, d->tasks + 1, d->count * sizeof(BnTask *));
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (t != NULL) {
+            pthread_mutex_lock(&pool->idle_lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->idle_lock);
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void run_task(BnTask *t) {
+    t->run(t->arg);
+    pthread_mutex_lock(&pool->idle_lock);
+    t->done = 1;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+// Pool thread: run stolen tasks until the pool shuts down
+static void *pool_worker(void *arg) {
+    worker_index = (int)(size_t)arg;
+    for (;;) {
+        BnTask *t = steal_task();
+        if (t != NULL) {
+            run_task(t);
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        while (!pool->shutdown && pool->queued <= 0) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        int shutdown = pool->shutdown;
+        pthread_mutex_unlock(&pool->idle_lock);
+        if (shutdown) {
+            return NULL;
+        }
+    }
+}
+
+// Stop and free the pool (no tasks may be pending)
+static void pool_stop(void) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+    pool = NULL;
+}
+
+/*
+ * Use `threads` threads (including the caller) for large multiplications; 0
+ * picks one per online CPU and 1 runs everything serially. Must not be called
+ * while an operation is running. Returns 0 if the pool could not be started,
+ * in which case the library stays serial.
+ */
+int bn_set_threads(int threads) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int)cpus : 1;
+    }
+    pool_stop();
+    if (threads == 1) {
+        return 1;
+    }
+
+    TaskPool *p = (TaskPool *)calloc(1, sizeof(TaskPool));
+    if (p == NULL) {
+        return 0;
+    }
+    p->threads = threads;
+    p->workers = (pthread_t *)malloc((size_t)(threads - 1) * sizeof(pthread_t));
+    p->deques = (TaskDeque *)calloc((size_t)threads, sizeof(TaskDeque));
+    if (p->workers == NULL || p->deques == NULL) {
+        free(p->workers);
+        free(p->deques);
+        free(p);
+        return 0;
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+    }
+    pthread_mutex_init(&p->idle_lock, NULL);
+    pthread_cond_init(&p->idle_cond, NULL);
+    pool = p;
+
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&p->workers[i], NULL, pool_worker, (void *)(size_t)i) != 0) {
+            pool_stop();
+            return 0;
+        }
+        p->started++;
+    }
+    return 1;
+}
+
+// Whether forked tasks may run on other threads
+int bn_parallel_enabled(void) {
+    return pool != NULL;
+}
+
+// Queue run(arg) for execution by any thread; runs it at once without a pool
+void bn_task_fork(BnTask *t, void (*run)(void *arg), void *arg) {
+    t->run = run;
+    t->arg = arg;
+    t->done = 0;
+    if (pool == NULL) {
+        run(arg);
+        t->done = 1;
+        return;
+    }
+
+    TaskDeque *d = own_deque();
+    pthread_mutex_lock(&d->lock);
+    int queued = d->count < DEQUE_CAPACITY;
+    if (queued) {
+        d->tasks[d->count++] = t;
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (!queued) {
+        run(arg);
+        t->done = 1;
+        return;
+    }
+    pool_task_queued();
+}
+
+// Wait until a forked task has finished, running it or other tasks meanwhile
+void bn_task_join(BnTask *t) {
+    if (pool == NULL) {
+        return;
+    }
+
+    // Take the task back if no other thread has stolen it yet
+    TaskDeque *d = own_deque();
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    for (size_t i = d->count; i-- > 0;) {
+        if (d->tasks[i] == t) {
+            d->count--;
+            memmove(d->tasks + i, d->tasks + i + 1, (d->count - i) * sizeof(BnTask *));
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (found) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->idle_lock);
+        t->run(t->arg);
+        t->done = 1;
+        return;
+    }
+
+    // Stolen: help with other work until the thief finishes it
+    for (;;) {
+        pthread_mutex_lock(&pool->idle_lock);
+        while (!t->done && pool->queued <= 0) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        int done = t->done;
+        pthread_mutex_unlock(&pool->idle_lock);
+        if (done) {
+            return;
+        }
+        BnTask *other = steal_task();
+        if (other != NULL) {
+            run_task(other);
+        }
+    }
+}
+
+// Arguments of one half of a parallel loop
+typedef struct ForRange {
+    void (*body)(void *arg, size_t begin, size_t end);
+    void *arg;
+    size_t begin, end, grain;
+} ForRange;
+
+// Split the range in two until it is no larger than the grain
+static void parallel_for_range(void *arg) {
+    ForRange *range = (ForRange *)arg;
+    if (range->end - range->begin <= range->grain) {
+        range->body(range->arg, range->begin, range->end);
+        return;
+    }
+    size_t mid = range->begin + (range->end - range->begin) / 2;
+    ForRange upper = *range;
+    ForRange lower = *range;
+    BnTask task;
+    upper.begin = mid;
+    lower.end = mid;
+    bn_task_fork(&task, parallel_for_range, &upper);
+    parallel_for_range(&lower);
+    bn_task_join(&task);
+}
+
+// body(arg, begin, end) over [0, n), in parallel chunks of at least `grain` iterations
+void bn_parallel_for(size_t n, size_t grain, void (*body)(void *arg, size_t begin, size_t end), void *arg) {
+    if (pool == NULL || n <= grain) {
+        body(arg, 0, n);
+        return;
+    }
+    ForRange range = { body, arg, 0, n, grain };
+    parallel_for_range(&range);
+}
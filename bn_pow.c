@@ -0,0 +1,265 @@
+/*
+ * File: bn_pow.c
+ * Description: Exponentiation and modular exponentiation of base 10^9 numbers.
+ *
+ * The exponent is scanned from its top bit with a sliding window: runs of zero
+ * bits cost one squaring each, and every window of up to w bits ending in a one
+ * costs its squarings plus a single multiplication by a precomputed odd power
+ * of the base. The window grows with the exponent (w = 6 above 671 bits), so a
+ * 4096-bit exponent needs about 4096 squarings and 700 multiplications.
+ * Squarings go through the dedicated squaring paths of `bn_mul.c`.
+ *
+ * Modular results are reduced after every step with Barrett reduction: with
+ * mu = floor(BASE^(2k) / m) computed once for the k-limb modulus, reducing a
+ * product below m^2 takes two multiplications, a subtraction and at most two
+ * corrections, and no division. Montgomery reduction would need a modulus
+ * coprime to the limb base 10^9 (odd and not a multiple of 5); Barrett works
+ * for every modulus.
+ *
+ * Signs follow from the multiplications for a plain power. A modular power is
+ * computed on magnitudes and given the sign of the remainder of a^e by m: the
+ * sign of a when e is odd. Negative exponents are refused.
+ *
+ * Functions:
+ * - int bn_pow(BigNum *r, const BigNum *a, const BigNum *e): r = a^e.
+ * - int bn_powmod(BigNum *r, const BigNum *a, const BigNum *e, const BigNum *m): r = a^e mod m.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+
+#define POW_CHUNK_BITS 29       // Exponent bits split off per short division (2^29 < BASE)
+#define POW_MAX_WINDOW 6        // Widest sliding window
+
+// State for reducing numbers below m^2 modulo a fixed k-limb m
+typedef struct Barrett {
+    const BigNum *m;
+    size_t k;               // Limbs of the modulus
+    BigNum mu;              // floor(BASE^(2k) / m)
+    BigNum q, t;            // Scratch for the quotient estimate and its product with m
+} Barrett;
+
+// Precompute mu for the modulus m
+static int barrett_init(Barrett *br, const BigNum *m) {
+    size_t k = m->len;
+    br->m = m;
+    br->k = k;
+    bn_init(&br->mu);
+    bn_init(&br->q);
+    bn_init(&br->t);
+
+    if (!bn_reserve(&br->q, 2 * k + 1)) {
+        return 0;
+    }
+    memset(br->q.limbs, 0, 2 * k * sizeof(limb_t));
+    br->q.limbs[2 * k] = 1;
+    br->q.len = 2 * k + 1;
+    return bn_divmod(&br->mu, NULL, &br->q, m);
+}
+
+static void barrett_free(Barrett *br) {
+    bn_free(&br->mu);
+    bn_free(&br->q);
+    bn_free(&br->t);
+}
+
+// x = x mod m for x < m^2
+static int barrett_reduce(BigNum *x, Barrett *br) {
+    size_t k = br->k;
+    if (x->len < k) {
+        return 1; // Already below BASE^(k-1) <= m
+    }
+
+    // q = floor(floor(x / BASE^(k-1)) * mu / BASE^(k+1)) is at most two below floor(x / m)
+    BigNum high = bn_view(x->limbs + k - 1, x->len - (k - 1));
+    if (!bn_mul(&br->q, &high, &br->mu)) {
+        return 0;
+    }
+    BigNum q = (br->q.len > k + 1) ? bn_view(br->q.limbs + k + 1, br->q.len - (k + 1)) : bn_view(NULL, 0);
+    if (!bn_mul(&br->t, &q, br->m) || !bn_reserve(x, k + 1) || !bn_reserve(&br->t, k + 1)) {
+        return 0;
+    }
+
+    // x - q*m is below 3m < BASE^(k+1), so it can be computed modulo BASE^(k+1)
+    if (x->len < k + 1) {
+        memset(x->limbs + x->len, 0, (k + 1 - x->len) * sizeof(limb_t));
+    }
+    if (br->t.len < k + 1) {
+        memset(br->t.limbs + br->t.len, 0, (k + 1 - br->t.len) * sizeof(limb_t));
+    }
+    limbs_sub(x->limbs, x->limbs, k + 1, br->t.limbs, k + 1);
+    x->len = k + 1;
+    bn_normalize(x);
+    while (bn_compare(x, br->m) >= 0) {
+        bn_sub_inplace(x, br->m);
+    }
+    return 1;
+}
+
+// r = a * b, reduced when br is set; r must be distinct from a and b
+static int pow_step(BigNum *r, const BigNum *a, const BigNum *b, Barrett *br) {
+    return bn_mul(r, a, b) && (br == NULL || barrett_reduce(r, br));
+}
+
+// Split the exponent into POW_CHUNK_BITS-bit chunks, least significant first
+static uint32_t *exponent_bits(const BigNum *e, size_t *bits) {
+    size_t len = e->len;
+    size_t count = 0;
+    limb_t *rest = (limb_t *)malloc(len * sizeof(limb_t));
+    // A limb holds just under 30 bits, so len + len/16 + 1 chunks always suffice
+    uint32_t *chunks = (uint32_t *)malloc((len + len / 16 + 1) * sizeof(uint32_t));
+    if (rest == NULL || chunks == NULL) {
+        free(rest);
+        free(chunks);
+        return NULL;
+    }
+    memcpy(rest, e->limbs, len * sizeof(limb_t));
+    while (len > 0) {
+        chunks[count++] = limbs_div_small(rest, rest, len, 1u << POW_CHUNK_BITS);
+        while (len > 0 && rest[len - 1] == 0) {
+            len--;
+        }
+    }
+    free(rest);
+
+    *bits = count * POW_CHUNK_BITS;
+    while (*bits > 0 && !((chunks[(*bits - 1) / POW_CHUNK_BITS] >> ((*bits - 1) % POW_CHUNK_BITS)) & 1)) {
+        (*bits)--;
+    }
+    return chunks;
+}
+
+static int exponent_bit(const uint32_t *chunks, size_t i) {
+    return (chunks[i / POW_CHUNK_BITS] >> (i % POW_CHUNK_BITS)) & 1;
+}
+
+// Window width that minimizes squarings plus multiplications for this many exponent bits
+static int window_bits(size_t bits) {
+    return (bits > 671) ? 6 : (bits > 239) ? 5 : (bits > 79) ? 4 : (bits > 23) ? 3 : 1;
+}
+
+// result = x^e, reduced modulo br->m when br is set (then x must be below the modulus)
+static int pow_sliding(BigNum *result, const BigNum *x, const BigNum *e, Barrett *br) {
+    BigNum odd[1 << (POW_MAX_WINDOW - 1)];  // odd[i] = x^(2i+1)
+    BigNum square, t;
+    size_t bits;
+    int status = 1;
+
+    if (!bn_reserve(result, 1)) {
+        return 0;
+    }
+    result->limbs[0] = 1;
+    result->len = 1;
+    if (e->len == 0) {
+        return br == NULL || barrett_reduce(result, br);
+    }
+
+    uint32_t *chunks = exponent_bits(e, &bits);
+    if (chunks == NULL) {
+        return 0;
+    }
+
+    // A plain power has a small base, where the precomputed powers would not pay off
+    int w = (br != NULL) ? window_bits(bits) : 1;
+    size_t table = (size_t)1 << (w - 1);
+    bn_init(&square);
+    bn_init(&t);
+    for (size_t i = 0; i < table; i++) {
+        bn_init(&odd[i]);
+    }
+    status = bn_copy(&odd[0], x);
+    if (table > 1) {
+        status = status && pow_step(&square, x, x, br);
+        for (size_t i = 1; i < table && status; i++) {
+            status = pow_step(&odd[i], &odd[i - 1], &square, br);
+        }
+    }
+
+    int started = 0;
+    size_t i = bits;
+    while (status && i > 0) {
+        i--;
+        if (!exponent_bit(chunks, i)) {
+            status = pow_step(&t, result, result, br);
+            bn_swap(result, &t);
+            continue;
+        }
+
+        // The window is bits i..low, the longest run of at most w bits ending in a one
+        size_t low = (i + 1 >= (size_t)w) ? i + 1 - w : 0;
+        while (!exponent_bit(chunks, low)) {
+            low++;
+        }
+        size_t value = 0;
+        for (size_t j = i + 1; j-- > low;) {
+            value = 2 * value + exponent_bit(chunks, j);
+        }
+
+        if (!started) {
+            status = bn_copy(result, &odd[value / 2]);
+            started = 1;
+        } else {
+            for (size_t j = low; j <= i && status; j++) {
+                status = pow_step(&t, result, result, br);
+                bn_swap(result, &t);
+            }
+            status = status && pow_step(&t, result, &odd[value / 2], br);
+            bn_swap(result, &t);
+        }
+        i = low;
+    }
+
+    for (size_t j = 0; j < table; j++) {
+        bn_free(&odd[j]);
+    }
+    bn_free(&square);
+    bn_free(&t);
+    free(chunks);
+    return status;
+}
+
+// r = a^e; returns 0 if e is negative
+int bn_pow(BigNum *r, const BigNum *a, const BigNum *e) {
+    BigNum result;
+    bn_init(&result);
+
+    if (e->neg) {
+        return 0;
+    }
+    int status = pow_sliding(&result, a, e, NULL);
+    if (status) {
+        bn_swap(r, &result);
+    }
+    bn_free(&result);
+    return status;
+}
+
+// r = a^e mod m; returns 0 if m is zero or e is negative
+int bn_powmod(BigNum *r, const BigNum *a, const BigNum *e, const BigNum *m) {
+    BigNum x, result;
+    Barrett br;
+
+    if (m->len == 0 || e->neg) {
+        return 0;
+    }
+    BigNum base = bn_view(a->limbs, a->len);
+    BigNum modulus = bn_view(m->limbs, m->len);
+    int neg = a->neg && e->len > 0 && (e->limbs[0] & 1);
+
+    bn_init(&x);
+    bn_init(&result);
+    int status = barrett_init(&br, &modulus) &&
+                 bn_divmod(NULL, &x, &base, &modulus) &&
+                 pow_sliding(&result, &x, e, &br);
+    if (status) {
+        result.neg = neg;
+        bn_normalize(&result);
+        bn_swap(r, &result);
+    }
+    barrett_free(&br);
+    bn_free(&x);
+    bn_free(&result);
+    return status;
+}
@@ -0,0 +1,290 @@
+/*
+ * File: bn_prod.c
+ * Description: Products of many factors by binary splitting: n-ary products,
+ *              factorials and binomial coefficients.
+ *
+ * Multiplying the factors into a running product one at a time keeps one
+ * operand tiny while the other grows, so every step is an unbalanced pass over
+ * the whole accumulator and n factors cost O(n^2) limb products. A product
+ * tree instead multiplies the products of two halves of similar size: the
+ * large multiplications are balanced, reach the Karatsuba, Toom-3 and NTT
+ * tiers, and an N-limb result costs O(M(N) log n).
+ *
+ * A list of factors is split where half of its limbs are on each side, so
+ * factors of very different sizes still give balanced halves. A range of
+ * consecutive integers (factorials, binomials) is split in the middle. Below
+ * `bn_karatsuba_threshold` limbs of result the factors are multiplied in one
+ * at a time, where schoolbook is as fast as anything; in a range, runs of
+ * small integers are first packed into one limb below BN_BASE, so each costs a
+ * single-limb multiply-in (the 999 factors of 1000! become about 320 limbs).
+ *
+ * With a thread pool (see `bn_set_threads`), the two halves of any subtree
+ * whose product reaches PRODUCT_FORK_LIMBS are computed as fork-join tasks.
+ *
+ * binomial(n, k) = n (n-1) ... (n-k+1) / k!, with k replaced by n - k when
+ * that is smaller; both products come from the range tree and the division
+ * is exact.
+ *
+ * Functions:
+ * - int bn_product(BigNum *r, const BigNum *const *factors, size_t count): r = product of the factors.
+ * - int bn_factorial(BigNum *r, uint64_t n): r = n!.
+ * - int bn_binomial(BigNum *r, const BigNum *n, const BigNum *k): r = n choose k.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "bignum.h"
+#include "bn_internal.h"
+
+#define PRODUCT_FORK_LIMBS 4096     // Subtrees with a product at least this long run their halves in parallel
+
+// Halves of a list product, computed as a task
+typedef struct ListTask {
+    BigNum r;
+    const BigNum *const *factors;
+    size_t count, limbs;
+    int status;
+} ListTask;
+
+// Halves of a range product, computed as a task
+typedef struct RangeTask {
+    BigNum r;
+    const BigNum *base;
+    uint64_t lo, hi;
+    int status;
+} RangeTask;
+
+// n = v
+static int set_u64(BigNum *n, uint64_t v) {
+    if (!bn_reserve(n, 3)) {
+        return 0;
+    }
+    n->limbs[0] = (limb_t)(v % BN_BASE);
+    n->limbs[1] = (limb_t)(v / BN_BASE % BN_BASE);
+    n->limbs[2] = (limb_t)(v / BN_BASE / BN_BASE);
+    n->len = 3;
+    n->neg = 0;
+    bn_normalize(n);
+    return 1;
+}
+
+// Value of a number of at most two limbs
+static uint64_t get_u64(const BigNum *n) {
+    return (n->len == 0) ? 0 : (n->len == 1) ? n->limbs[0] : (uint64_t)n->limbs[1] * BN_BASE + n->limbs[0];
+}
+
+// r = factors[0] * ... * factors[count - 1], multiplying them in one at a time
+static int list_leaf(BigNum *r, const BigNum *const *factors, size_t count) {
+    BigNum t;
+    int status = bn_copy(r, factors[0]);
+
+    bn_init(&t);
+    for (size_t i = 1; status && i < count; i++) {
+        const BigNum *f = factors[i];
+        if (f->len == 1) {
+            status = bn_mul_small_inplace(r, f->limbs[0]);
+            r->neg ^= f->neg;
+        } else {
+            status = bn_mul(&t, r, f);
+            bn_swap(r, &t);
+        }
+    }
+    bn_free(&t);
+    return status;
+}
+
+static int list_product(BigNum *r, const BigNum *const *factors, size_t count, size_t limbs);
+
+static void list_task(void *arg) {
+    ListTask *t = arg;
+    t->status = list_product(&t->r, t->factors, t->count, t->limbs);
+}
+
+// Product of `count` non-zero factors holding `limbs` limbs in all
+static int list_product(BigNum *r, const BigNum *const *factors, size_t count, size_t limbs) {
+    if (count == 1 || limbs < bn_karatsuba_threshold) {
+        return list_leaf(r, factors, count);
+    }
+
+    // The left half takes factors while it stays within half of the limbs
+    size_t mid = 1;
+    size_t left_limbs = factors[0]->len;
+    while (mid < count - 1 && 2 * (left_limbs + factors[mid]->len) <= limbs) {
+        left_limbs += factors[mid++]->len;
+    }
+
+    ListTask left = { .factors = factors, .count = mid, .limbs = left_limbs };
+    BigNum right;
+    bn_init(&left.r);
+    bn_init(&right);
+    int status;
+    if (bn_parallel_enabled() && limbs >= PRODUCT_FORK_LIMBS) {
+        BnTask task;
+        bn_task_fork(&task, list_task, &left);
+        status = list_product(&right, factors + mid, count - mid, limbs - left_limbs);
+        bn_task_join(&task);
+    } else {
+        list_task(&left);
+        status = list_product(&right, factors + mid, count - mid, limbs - left_limbs);
+    }
+    status = status && left.status && bn_mul(r, &left.r, &right);
+    bn_free(&left.r);
+    bn_free(&right);
+    return status;
+}
+
+// r = product of factors[0..count); r may be one of the factors, and the empty product is 1
+int bn_product(BigNum *r, const BigNum *const *factors, size_t count) {
+    BigNum result;
+    size_t limbs = 0;
+
+    bn_init(&result);
+    for (size_t i = 0; i < count; i++) {
+        if (factors[i]->len == 0) {
+            r->len = 0;
+            r->neg = 0;
+            return 1;
+        }
+        limbs += factors[i]->len;
+    }
+    int status = (count == 0) ? set_u64(&result, 1) : list_product(&result, factors, count, limbs);
+    if (status) {
+        bn_swap(r, &result);
+    }
+    bn_free(&result);
+    return status;
+}
+
+// Approximate limbs of the product of base + i for i in [lo, hi]
+static double range_limbs(const BigNum *base, uint64_t lo, uint64_t hi) {
+    double per_factor = 1;
+    if (base != NULL) {
+        per_factor = (double)base->len + 1;
+    } else {
+        for (uint64_t top = hi; top >= 10; top /= 10) {
+            per_factor++;
+        }
+        per_factor /= BN_BASE_DIGITS;
+    }
+    return (double)(hi - lo + 1) * per_factor;
+}
+
+// r = (base + lo) (base + lo + 1) ... (base + hi), one factor at a time; a NULL base is 0
+static int range_leaf(BigNum *r, const BigNum *base, uint64_t lo, uint64_t hi) {
+    BigNum factor, t;
+    uint64_t packed = 1;    // Product of small factors not yet multiplied in, below BN_BASE
+    int status = set_u64(r, 1);
+
+    bn_init(&factor);
+    bn_init(&t);
+    for (uint64_t i = lo; status; i++) {
+        if (base == NULL && i < BN_BASE) {
+            if (packed * i >= BN_BASE) {
+                status = bn_mul_small_inplace(r, (limb_t)packed);
+                packed = 1;
+            }
+            packed *= i;
+        } else {
+            status = set_u64(&factor, i) &&
+                     (base == NULL || bn_add_inplace(&factor, base)) &&
+                     bn_mul(&t, r, &factor);
+            bn_swap(r, &t);
+        }
+        if (i == hi) {
+            break;
+        }
+    }
+    status = status && bn_mul_small_inplace(r, (limb_t)packed);
+    bn_free(&factor);
+    bn_free(&t);
+    return status;
+}
+
+static int range_product(BigNum *r, const BigNum *base, uint64_t lo, uint64_t hi);
+
+static void range_task(void *arg) {
+    RangeTask *t = arg;
+    t->status = range_product(&t->r, t->base, t->lo, t->hi);
+}
+
+// r = (base + lo) ... (base + hi) by splitting the range in the middle
+static int range_product(BigNum *r, const BigNum *base, uint64_t lo, uint64_t hi) {
+    double limbs = range_limbs(base, lo, hi);
+    if (lo == hi || limbs < (double)bn_karatsuba_threshold) {
+        return range_leaf(r, base, lo, hi);
+    }
+
+    uint64_t mid = lo + (hi - lo) / 2;
+    RangeTask left = { .base = base, .lo = lo, .hi = mid };
+    BigNum right;
+    bn_init(&left.r);
+    bn_init(&right);
+    int status;
+    if (bn_parallel_enabled() && limbs >= PRODUCT_FORK_LIMBS) {
+        BnTask task;
+        bn_task_fork(&task, range_task, &left);
+        status = range_product(&right, base, mid + 1, hi);
+        bn_task_join(&task);
+    } else {
+        range_task(&left);
+        status = range_product(&right, base, mid + 1, hi);
+    }
+    status = status && left.status && bn_mul(r, &left.r, &right);
+    bn_free(&left.r);
+    bn_free(&right);
+    return status;
+}
+
+// r = n!
+int bn_factorial(BigNum *r, uint64_t n) {
+    return (n < 2) ? set_u64(r, 1) : range_product(r, NULL, 2, n);
+}
+
+// r = n choose k, which is 0 for k < 0 or k > n; returns 0 if n is negative or min(k, n - k) >= 10^18
+int bn_binomial(BigNum *r, const BigNum *n, const BigNum *k) {
+    BigNum rest, top, numerator, denominator;
+
+    if (n->neg) {
+        return 0;
+    }
+    if (k->neg || bn_compare(k, n) > 0) {
+        r->len = 0;
+        r->neg = 0;
+        return 1;
+    }
+    bn_init(&rest);
+    bn_init(&top);
+    bn_init(&numerator);
+    bn_init(&denominator);
+
+    // Take the shorter of the products n ... (n-k+1) and n ... (k+1)
+    int status = bn_sub(&rest, n, k);
+    const BigNum *shorter = (bn_compare(&rest, k) < 0) ? &rest : k;
+    status = status && shorter->len <= 2;
+    if (status) {
+        uint64_t m = get_u64(shorter);
+        if (m == 0) {
+            status = set_u64(r, 1);
+        } else {
+            // The factors are top + 1 ... top + m with top = n - m; n of two limbs or less fits in 64 bits
+            const BigNum *base = NULL;
+            uint64_t lo = 1, hi = m;
+            if (n->len <= 2) {
+                lo = get_u64(n) - m + 1;
+                hi = get_u64(n);
+            } else {
+                status = set_u64(&top, m) && bn_sub(&top, n, &top);
+                base = &top;
+            }
+            status = status &&
+                     range_product(&numerator, base, lo, hi) &&
+                     bn_factorial(&denominator, m) &&
+                     bn_divmod(r, NULL, &numerator, &denominator);
+        }
+    }
+    bn_free(&rest);
+    bn_free(&top);
+    bn_free(&numerator);
+    bn_free(&denominator);
+    return status;
+}
@@ -0,0 +1,229 @@
+/*
+ * File: bn_simd.c
+ * Description: AVX2 and AVX-512 versions of the limb addition, subtraction and
+ *              comparison kernels, selected at startup from the CPU's features.
+ *
+ * Adding base 10^9 limbs lane by lane is easy; the difficulty is the carry,
+ * which must ripple from lane to lane. Each block of lanes is handled like a
+ * carry-lookahead adder: for every lane the vector sum tells whether it
+ * generates a carry (sum >= BASE) or would propagate an incoming one
+ * (sum == BASE - 1). Packed into bit masks G and P, the carries entering the
+ * lanes are ((G << 1 | carry_in) + P) ^ P, one scalar addition per block, and
+ * the lanes are then corrected in a single vector step. Subtraction works the
+ * same way with borrows (generate: a < b, propagate: a == b).
+ *
+ * The kernels process whole vectors only and report how many limbs they did;
+ * the scalar code in `bignum.c` finishes the remainder. The vector code is
+ * compiled with per-function target attributes, so the build needs no special
+ * flags and still runs on CPUs without AVX2. Multiplication by a single limb
+ * stays scalar: its carry is a full limb that depends on the previous product,
+ * so it does not decompose into per-lane masks.
+ *
+ * Functions:
+ * - int bn_set_simd(int level): Selects the kernels (BN_SIMD_SCALAR, _AVX2 or _AVX512).
+ * - int bn_simd_level(void): The kernel level in use.
+*/
+
+#include <stddef.h>
+#include "bignum.h"
+#include "bn_internal.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BN_SIMD_X86 1
+#endif
+
+BnSimdKernels bn_simd = { NULL, NULL, NULL };
+
+static int simd_level = BN_SIMD_SCALAR;
+
+#ifdef BN_SIMD_X86
+
+// Lane masks for an 8-bit mask: lane i is all ones when bit i is set
+__attribute__((target("avx2")))
+static inline __m256i mask_to_lanes_avx2(unsigned mask) {
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)mask), bits), bits);
+}
+
+__attribute__((target("avx2")))
+static inline unsigned lanes_to_mask_avx2(__m256i lanes) {
+    return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lanes));
+}
+
+// r[0..k) = a + b for the largest multiple k of 8 limbs not above n
+__attribute__((target("avx2")))
+static size_t limbs_add_avx2(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *carry) {
+    const __m256i top = _mm256_set1_epi32(BN_BASE - 1);
+    const __m256i base = _mm256_set1_epi32(BN_BASE);
+    unsigned c = *carry;
+    size_t i;
+
+    // Limbs are below 10^9, so sums stay below 2^31 and signed compares are exact
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256i sum = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                       _mm256_loadu_si256((const __m256i *)(b + i)));
+        unsigned generate = lanes_to_mask_avx2(_mm256_cmpgt_epi32(sum, top));
+        unsigned propagate = lanes_to_mask_avx2(_mm256_cmpeq_epi32(sum, top));
+        unsigned carry_in = (((generate << 1) | c) + propagate) ^ propagate;
+        unsigned carry_out = carry_in >> 1;     // Lane i passes a carry to lane i + 1
+        sum = _mm256_sub_epi32(sum, mask_to_lanes_avx2(carry_in & 0xff));   // + 1
+        sum = _mm256_sub_epi32(sum, _mm256_and_si256(mask_to_lanes_avx2(carry_out & 0xff), base));
+        _mm256_storeu_si256((__m256i *)(r + i), sum);
+        c = (carry_in >> 8) & 1;
+    }
+    *carry = c;
+    return i;
+}
+
+// r[0..k) = a - b for the largest multiple k of 8 limbs not above n
+__attribute__((target("avx2")))
+static size_t limbs_sub_avx2(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *borrow) {
+    const __m256i base = _mm256_set1_epi32(BN_BASE);
+    unsigned c = *borrow;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned generate = lanes_to_mask_avx2(_mm256_cmpgt_epi32(y, x));
+        unsigned propagate = lanes_to_mask_avx2(_mm256_cmpeq_epi32(x, y));
+        unsigned borrow_in = (((generate << 1) | c) + propagate) ^ propagate;
+        unsigned borrow_out = borrow_in >> 1;
+        __m256i diff = _mm256_sub_epi32(x, y);
+        diff = _mm256_add_epi32(diff, mask_to_lanes_avx2(borrow_in & 0xff));    // - 1
+        diff = _mm256_add_epi32(diff, _mm256_and_si256(mask_to_lanes_avx2(borrow_out & 0xff), base));
+        _mm256_storeu_si256((__m256i *)(r + i), diff);
+        c = (borrow_in >> 8) & 1;
+    }
+    *borrow = c;
+    return i;
+}
+
+// Skip equal 8-limb blocks from the top; returns how many low limbs are left to compare
+__attribute__((target("avx2")))
+static size_t limbs_cmp_avx2(const limb_t *a, const limb_t *b, size_t n) {
+    while (n >= 8) {
+        __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(a + n - 8)),
+                                        _mm256_loadu_si256((const __m256i *)(b + n - 8)));
+        if (lanes_to_mask_avx2(eq) != 0xff) {
+            return n; // The difference is within this block
+        }
+        n -= 8;
+    }
+    return n;
+}
+
+// r[0..k) = a + b for the largest multiple k of 16 limbs not above n
+__attribute__((target("avx512f")))
+static size_t limbs_add_avx512(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *carry) {
+    const __m512i top = _mm512_set1_epi32(BN_BASE - 1);
+    const __m512i base = _mm512_set1_epi32(BN_BASE);
+    const __m512i minus_one = _mm512_set1_epi32(-1);
+    unsigned c = *carry;
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m512i sum = _mm512_add_epi32(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        unsigned generate = _mm512_cmpgt_epu32_mask(sum, top);
+        unsigned propagate = _mm512_cmpeq_epu32_mask(sum, top);
+        unsigned carry_in = (((generate << 1) | c) + propagate) ^ propagate;
+        unsigned carry_out = carry_in >> 1;
+        sum = _mm512_mask_sub_epi32(sum, (__mmask16)carry_in, sum, minus_one);
+        sum = _mm512_mask_sub_epi32(sum, (__mmask16)carry_out, sum, base);
+        _mm512_storeu_si512(r + i, sum);
+        c = (carry_in >> 16) & 1;
+    }
+    *carry = c;
+    return i;
+}
+
+// r[0..k) = a - b for the largest multiple k of 16 limbs not above n
+__attribute__((target("avx512f")))
+static size_t limbs_sub_avx512(limb_t *r, const limb_t *a, const limb_t *b, size_t n, limb_t *borrow) {
+    const __m512i base = _mm512_set1_epi32(BN_BASE);
+    const __m512i minus_one = _mm512_set1_epi32(-1);
+    unsigned c = *borrow;
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512(a + i);
+        __m512i y = _mm512_loadu_si512(b + i);
+        unsigned generate = _mm512_cmplt_epu32_mask(x, y);
+        unsigned propagate = _mm512_cmpeq_epu32_mask(x, y);
+        unsigned borrow_in = (((generate << 1) | c) + propagate) ^ propagate;
+        unsigned borrow_out = borrow_in >> 1;
+        __m512i diff = _mm512_sub_epi32(x, y);
+        diff = _mm512_mask_add_epi32(diff, (__mmask16)borrow_in, diff, minus_one);
+        diff = _mm512_mask_add_epi32(diff, (__mmask16)borrow_out, diff, base);
+        _mm512_storeu_si512(r + i, diff);
+        c = (borrow_in >> 16) & 1;
+    }
+    *borrow = c;
+    return i;
+}
+
+// Skip equal 16-limb blocks from the top; returns how many low limbs are left to compare
+__attribute__((target("avx512f")))
+static size_t limbs_cmp_avx512(const limb_t *a, const limb_t *b, size_t n) {
+    while (n >= 16) {
+        if (_mm512_cmpneq_epu32_mask(_mm512_loadu_si512(a + n - 16), _mm512_loadu_si512(b + n - 16)) != 0) {
+            return n;
+        }
+        n -= 16;
+    }
+    return n;
+}
+
+#endif // BN_SIMD_X86
+
+// Highest level the CPU supports
+static int simd_supported(void) {
+#ifdef BN_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return BN_SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return BN_SIMD_AVX2;
+    }
+#endif
+    return BN_SIMD_SCALAR;
+}
+
+/*
+ * Use the kernels for `level`, or the best supported level below it. Returns
+ * the level selected. Must not be called while an operation is running.
+ */
+int bn_set_simd(int level) {
+    int supported = simd_supported();
+    if (level > supported) {
+        level = supported;
+    }
+
+    BnSimdKernels kernels = { NULL, NULL, NULL };
+#ifdef BN_SIMD_X86
+    if (level == BN_SIMD_AVX512) {
+        kernels.add = limbs_add_avx512;
+        kernels.sub = limbs_sub_avx512;
+        kernels.cmp = limbs_cmp_avx512;
+    } else if (level == BN_SIMD_AVX2) {
+        kernels.add = limbs_add_avx2;
+        kernels.sub = limbs_sub_avx2;
+        kernels.cmp = limbs_cmp_avx2;
+    }
+#endif
+    bn_simd = kernels;
+    simd_level = level;
+    return level;
+}
+
+int bn_simd_level(void) {
+    return simd_level;
+}
+
+// Pick the best kernels before main() runs
+__attribute__((constructor))
+static void bn_simd_init(void) {
+    bn_set_simd(BN_SIMD_AVX512);
+}
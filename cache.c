@@ -0,0 +1,268 @@
+/*
+ * File: cache.c
+ * Description: Content-addressed on-disk cache of operation results.
+ *
+ * The key of an operation is the SHA-256 digest of its canonical bytes: the
+ * operation character, the operand count, and for every operand its sign,
+ * its limb count and its limbs, little-endian. Two different computations
+ * can therefore only share a key through a SHA-256 collision.
+ *
+ * Every entry is a file named after the hexadecimal key. It holds the key
+ * itself followed by the result as one binary record, and a lookup only
+ * returns the value when the stored key equals the one looked up and the
+ * record is valid, so a file copied or renamed to another entry's name is a
+ * miss rather than a wrong answer. Missing, truncated and corrupt entries
+ * are misses too. The cache cannot protect against someone who can write
+ * the directory and stores a wrong result under the right key, so the
+ * directory must only be writable by trusted users.
+ *
+ * Stores write a temporary file in the same directory, make it readable by
+ * everyone (the mode mkstemp gives would hide it from other users sharing
+ * the cache) and rename it over the entry, so a reader sees either the old
+ * entry, the new one or none, even with several processes filling the same
+ * cache at once.
+ *
+ * Functions:
+ * - int cache_open(const char *dir): Creates and checks the cache directory.
+ * - void cache_key(CacheKey *key, char operation, const BigNum *const *operands, size_t count):
+ *     Computes the key of an operation.
+ * - int cache_lookup(const char *dir, const CacheKey *key, BigNum *r): Loads an entry.
+ * - void cache_store(const char *dir, const CacheKey *key, const BigNum *r): Stores an entry.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cache.h"
+
+#define CACHE_SUFFIX ".apcn"        // Extension of entry files
+#define CACHE_NAME_MAX 96           // Room for an entry or temporary file name
+#define CACHE_MODE 0644             // Entries are readable by every user of a shared cache
+
+// Operand limbs are hashed straight from memory, as in the binary record format
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The result cache requires a little-endian host"
+#endif
+
+// State of a SHA-256 computation
+typedef struct Sha256 {
+    uint32_t h[8];
+    unsigned char block[64];    // Bytes of the current block
+    size_t fill;                // Bytes in `block`
+    uint64_t total;             // Bytes hashed so far
+} Sha256;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+// Compress one 64-byte block into the state
+static void sha256_block(uint32_t h[8], const unsigned char *p) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+               ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+}
+
+static void sha256_init(Sha256 *s) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(s->h, iv, sizeof(iv));
+    s->fill = 0;
+    s->total = 0;
+}
+
+static void sha256_update(Sha256 *s, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    s->total += len;
+    if (s->fill > 0) {
+        size_t take = (len < 64 - s->fill) ? len : 64 - s->fill;
+        memcpy(s->block + s->fill, p, take);
+        s->fill += take;
+        p += take;
+        len -= take;
+        if (s->fill < 64) {
+            return;
+        }
+        sha256_block(s->h, s->block);
+        s->fill = 0;
+    }
+    for (; len >= 64; p += 64, len -= 64) {
+        sha256_block(s->h, p);
+    }
+    memcpy(s->block, p, len);
+    s->fill = len;
+}
+
+static void sha256_final(Sha256 *s, unsigned char digest[32]) {
+    unsigned char pad[72] = { 0x80 };
+    uint64_t bits = s->total * 8;
+    size_t pad_len = (s->fill < 56) ? 56 - s->fill : 120 - s->fill;
+    for (int i = 0; i < 8; i++) {
+        pad[pad_len + i] = (unsigned char)(bits >> (56 - 8 * i));
+    }
+    sha256_update(s, pad, pad_len + 8);
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (unsigned char)(s->h[i] >> 24);
+        digest[4 * i + 1] = (unsigned char)(s->h[i] >> 16);
+        digest[4 * i + 2] = (unsigned char)(s->h[i] >> 8);
+        digest[4 * i + 3] = (unsigned char)s->h[i];
+    }
+}
+
+// Hash a 64-bit value little-endian
+static void sha256_u64(Sha256 *s, uint64_t v) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (unsigned char)(v >> (8 * i));
+    }
+    sha256_update(s, bytes, sizeof(bytes));
+}
+
+// Create the cache directory if needed and check that it can be used
+int cache_open(const char *dir) {
+    struct stat st;
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        printf("Error: Cannot create cache directory '%s'\n", dir);
+        return 0;
+    }
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || access(dir, R_OK | W_OK | X_OK) != 0) {
+        printf("Error: Cannot use cache directory '%s'\n", dir);
+        return 0;
+    }
+    return 1;
+}
+
+// Key of `operation` over the values of its operands: SHA-256 of their canonical bytes
+void cache_key(CacheKey *key, char operation, const BigNum *const *operands, size_t count) {
+    Sha256 s;
+    unsigned char op = (unsigned char)operation;
+
+    sha256_init(&s);
+    sha256_update(&s, &op, 1);
+    sha256_u64(&s, count);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char neg = (unsigned char)operands[i]->neg;
+        sha256_update(&s, &neg, 1);
+        sha256_u64(&s, operands[i]->len);
+        if (operands[i]->len > 0) {
+            sha256_update(&s, operands[i]->limbs, operands[i]->len * sizeof(limb_t));
+        }
+    }
+    sha256_final(&s, key->digest);
+}
+
+// Path of the entry for key, or NULL when out of memory; the caller frees it
+static char *entry_path(const char *dir, const CacheKey *key) {
+    size_t size = strlen(dir) + CACHE_NAME_MAX;
+    char *path = (char *)malloc(size);
+    if (path != NULL) {
+        size_t pos = (size_t)snprintf(path, size, "%s/", dir);
+        for (int i = 0; i < CACHE_KEY_BYTES; i++) {
+            pos += (size_t)snprintf(path + pos, size - pos, "%02x", key->digest[i]);
+        }
+        snprintf(path + pos, size - pos, CACHE_SUFFIX);
+    }
+    return path;
+}
+
+// Load the entry for key into r; returns 1 on a hit
+int cache_lookup(const char *dir, const CacheKey *key, BigNum *r) {
+    struct stat st;
+    char *path = entry_path(dir, key);
+    int hit = 0;
+
+    int fd = (path != NULL) ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    free(path);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size >= CACHE_KEY_BYTES + BN_BINARY_HEADER) {
+        size_t size = (size_t)st.st_size;
+        const unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            // The entry must be the key it was stored under, then exactly one record
+            size_t used;
+            BigNum value;
+            bn_init(&value);
+            hit = memcmp(map, key->digest, CACHE_KEY_BYTES) == 0 &&
+                  bn_from_binary(&value, map + CACHE_KEY_BYTES, size - CACHE_KEY_BYTES, &used) &&
+                  used == size - CACHE_KEY_BYTES;
+            if (hit) {
+                bn_swap(r, &value);
+            }
+            bn_free(&value);
+            munmap((void *)map, size);
+        }
+    }
+    close(fd);
+    return hit;
+}
+
+// Store r as the entry for key by writing a temporary file and renaming it into place
+void cache_store(const char *dir, const CacheKey *key, const BigNum *r) {
+    char *path = entry_path(dir, key);
+    char *temp = (char *)malloc(strlen(dir) + CACHE_NAME_MAX);
+    int fd = -1;
+
+    if (path != NULL && temp != NULL) {
+        sprintf(temp, "%s/.tmp-XXXXXX", dir);
+        fd = mkstemp(temp);
+    }
+    if (fd >= 0) {
+        FILE *fp = (fchmod(fd, CACHE_MODE) == 0) ? fdopen(fd, "wb") : NULL;
+        int written = (fp != NULL) && fwrite(key->digest, 1, CACHE_KEY_BYTES, fp) == CACHE_KEY_BYTES &&
+                      bn_write_binary(fp, r);
+        int closed = (fp != NULL) ? fclose(fp) == 0 : close(fd) == 0;
+        if (!written || !closed || rename(temp, path) != 0) {
+            unlink(temp);
+        }
+    }
+    free(path);
+    free(temp);
+}
@@ -0,0 +1,46 @@
+/*
+ * File: cache.h
+ * Description: Header file for the on-disk result cache.
+ *
+ * With `--cache DIR`, expensive operations (see `expr.c`) are looked up in DIR
+ * before they are computed, and their results are stored there afterwards.
+ * An entry is addressed by the SHA-256 digest of the operation and the values
+ * of its operands, and holds that digest followed by the result as one binary
+ * record (see `bignum.h`). Several processes, and users, may share a
+ * directory: entries are written to a temporary file, made readable by
+ * everyone and renamed into place, and entries that fail validation are
+ * ignored. Anyone who can write the directory can make later lookups return
+ * any value, so it must only be writable by trusted users.
+ *
+ * Function Declarations:
+ * - int cache_open(const char *dir):
+ *     Creates the cache directory if it does not exist yet. Returns 0 with a
+ *     message printed if it cannot be used.
+ * - void cache_key(CacheKey *key, char operation, const BigNum *const *operands, size_t count):
+ *     Computes the key of an operation over `count` operands. It must be taken
+ *     before the operation runs, since the result may overwrite an operand.
+ * - int cache_lookup(const char *dir, const CacheKey *key, BigNum *r):
+ *     Loads the entry for `key` into r. Returns 1 on a hit and 0 otherwise.
+ * - void cache_store(const char *dir, const CacheKey *key, const BigNum *r):
+ *     Stores r as the entry for `key`; failures only mean the entry is missing.
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include "bignum.h"
+
+#define CACHE_KEY_BYTES 32      // Length of a SHA-256 digest
+
+typedef struct CacheKey {
+    unsigned char digest[CACHE_KEY_BYTES];
+} CacheKey;
+
+// Function declarations
+int cache_open(const char *dir);
+void cache_key(CacheKey *key, char operation, const BigNum *const *operands, size_t count);
+int cache_lookup(const char *dir, const CacheKey *key, BigNum *r);
+void cache_store(const char *dir, const CacheKey *key, const BigNum *r);
+
+#endif // CACHE_H
@@ -0,0 +1,1523 @@
+/*
+ * File: check.c
+ * Description: Self-checking test suite for the arithmetic library.
+ *
+ * Every check runs an operation on random operands and on edge cases and
+ * compares the result with a reference or verifies an identity the correct
+ * answer must satisfy. The reference is the library itself with every
+ * crossover point raised out of reach, so that it runs the basecase
+ * algorithms: schoolbook multiplication, Algorithm D and one thread. Each
+ * failure is reported with the operand sizes (or the output line) and the
+ * seed that reproduces it.
+ *
+ * Comparison: compare_dlists agrees with bn_compare on lists with leading
+ * zeros and negative zeros, and leaves both lists untouched.
+ *
+ * Multiplication by one limb: bn_mul (in place, into the other operand or
+ * into a separate result), bn_mul_small_inplace and bn_addmul_small against
+ * exact division by the multiplier.
+ *
+ * Multiplication tiers: bn_mul and bn_sqr against schoolbook products just
+ * below, at and above the Karatsuba, Toom-3 and NTT thresholds, on balanced
+ * and unbalanced shapes and on all-nines operands (for the NTT also four
+ * times the threshold long, where the convolution coefficients are largest).
+ * From the parallel threshold on, the products run on a pool of four threads
+ * and are compared with the same schoolbook products on one thread.
+ *
+ * Division: bn_divmod against Algorithm D around the Newton threshold, on
+ * random, all-nines and power-of-the-base divisors, and q*b + r == a with
+ * |r| < |b| and r taking the sign of a.
+ *
+ * Fixed width: the operators and modular exponentiation at every width of
+ * BN_FIXED_WIDTHS against BigNum results reduced modulo 2^bits.
+ *
+ * Extended GCD: g = gcd(a, b) = x*a + y*b, g agrees with bn_gcd and divides
+ * both operands, the cofactor of the larger operand lies within half of the
+ * smaller operand divided by g, and bn_modinv returns an inverse exactly when
+ * g is 1. The checks run on every sign combination, on zero operands, on
+ * sizes around `bn_hgcd_threshold`, on consecutive Fibonacci numbers (the
+ * longest Euclidean sequences) and on operands with a large common factor,
+ * both on BigNums and through the DList wrapper `gcdext`, whose lists are
+ * recycled after each case with `dlist_pool_reset`.
+ *
+ * Products: bn_product against a running product on four threads, with
+ * results below and above the Karatsuba threshold and PRODUCT_FORK_LIMBS
+ * and negative factors, bn_factorial against 2 * 3 * ... * n, and
+ * bn_binomial for k < 0, k > n, k = 0, k = n and on n of one and of more
+ * than two limbs against n (n-1) ... (n-k+1) / k!.
+ *
+ * Binary format: zero and values of one to 1000 limbs of both signs round trip
+ * through bn_write_binary and bn_read_binary and through an unaligned buffer,
+ * and records one limb short or with a wrong checksum are rejected.
+ *
+ * Result cache: a stored entry is found again, while lookups miss for a key
+ * never stored, for an entry renamed to another key's file and for a
+ * truncated entry.
+ *
+ * Calculator modes (with `--apc PATH`): expressions with operands around
+ * every crossover point are run through `apc --file`, `apc --batch` and
+ * `apc --serve` on several threads, and each output line (or response) is
+ * compared with the reference result, so batch and server mode must answer
+ * every line as file mode does. Expressions on random values below 2^bits go
+ * through file and batch mode at every width, and the binary format samples
+ * through `--out-format binary` and `--in-format binary` in file mode.
+ *
+ * Expression syntax (with `--apc PATH`): file mode gets lines on precedence
+ * and associativity (2+3*4, 2^3^2, -2^2, 2^3!), variables, `ans`, undefined
+ * variables and malformed lines, `a ^ e % m` lines with moduli of about 4480
+ * bits answered by bn_powmod, and calls of `!`, `binomial(...)` and
+ * `product(...)`, including negative factors and the error lines.
+ *
+ * Usage:
+ *   make check
+ *   ./apc_check [--seed N] [--apc PATH]
+ *
+ * Functions:
+ * - int main(int argc, char *argv[]): Runs the checks; exits with status 1 if any fails.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "bignum.h"
+#include "operations.h"
+#include "cache.h"
+
+#define CHECK_TRIALS 4              // Random operand pairs per size combination
+#define CHECK_THREADS 4             // Threads for the parallel multiplication tier
+#define CHECK_THREADS_TEXT "4"      // The same, as a calculator option for batch and server mode
+#define CHECK_CONNECT_TRIES 500     // Attempts 10 ms apart to reach a starting server
+#define CHECK_BINARY_SAMPLES 8      // Numbers sent through the binary record format
+#define CHECK_FORK_LIMBS 4096       // PRODUCT_FORK_LIMBS of bn_prod.c: larger subtrees run in parallel
+#define CHECK_FACTORS 96            // Most factors in one product
+#define CHECK_POWMOD_LIMBS 150      // Modulus of `a ^ e % m` lines, about 4480 bits
+
+#define CHECK_WIDTH(bits) bits,
+static const int check_widths[] = { BN_FIXED_WIDTHS(CHECK_WIDTH) };
+
+// Expressions for the calculator and the output lines they must produce
+typedef struct Script {
+    char **lines;
+    char **expected;
+    size_t count, cap;
+} Script;
+
+static uint64_t seed = 0x41504343;  // Default seed, overridden by --seed
+static uint64_t state;
+static int failures = 0;
+
+// Crossover points of the library, restored after each reference computation
+static size_t default_karatsuba, default_toom3, default_ntt, default_newton, default_parallel;
+
+// Next value of a xorshift64* generator
+static uint64_t next_random(void) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+// Directory for the scratch files, the cache and the server socket
+static const char *scratch_dir(void) {
+    const char *dir = getenv("TMPDIR");
+    return (dir != NULL && *dir != '\0') ? dir : "/tmp";
+}
+
+// Record a failed check
+static void fail(const char *what, size_t len_a, size_t len_b) {
+    printf("FAIL: %s (%zu x %zu limbs, seed %llu)\n", what, len_a, len_b, (unsigned long long)seed);
+    failures++;
+}
+
+// A random number of exactly `len` limbs (zero for len 0), negative half of the time if `sign` is set
+static int random_operand(BigNum *n, size_t len, int sign) {
+    if (!bn_reserve(n, len)) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        n->limbs[i] = (limb_t)(next_random() % BN_BASE);
+    }
+    if (len > 0 && n->limbs[len - 1] == 0) {
+        n->limbs[len - 1] = 1;
+    }
+    n->len = len;
+    n->neg = len > 0 && sign && (next_random() & 1);
+    return 1;
+}
+
+// A BigNum holding a small value
+static int set_small(BigNum *n, int64_t v) {
+    uint64_t m = (v < 0) ? -(uint64_t)v : (uint64_t)v;
+    if (!bn_reserve(n, 3)) {
+        return 0;
+    }
+    n->len = 0;
+    for (; m > 0; m /= BN_BASE) {
+        n->limbs[n->len++] = (limb_t)(m % BN_BASE);
+    }
+    n->neg = v < 0;
+    return 1;
+}
+
+// Check the identities a correct extended GCD g = x*a + y*b satisfies, and the DList wrapper
+static void check_gcdext_result(const BigNum *a, const BigNum *b, const BigNum *g, const BigNum *x, const BigNum *y) {
+    BigNum r, t, u, k;
+    DList *la = NULL, *lb = NULL, *lg = NULL, *lx = NULL, *ly = NULL;
+    size_t len_a = a->len, len_b = b->len;
+
+    bn_init(&r);
+    bn_init(&t);
+    bn_init(&u);
+    bn_init(&k);
+
+    if (!bn_gcd(&r, a, b) || bn_compare(g, &r) != 0 || g->neg) {
+        fail("gcdext: g differs from gcd", len_a, len_b);
+    }
+
+    // Bezout identity
+    if (!bn_mul(&t, x, a) || !bn_mul(&u, y, b) || !bn_add(&t, &t, &u) || bn_compare(&t, g) != 0) {
+        fail("gcdext: x*a + y*b != g", len_a, len_b);
+    }
+
+    // g divides both operands
+    if (g->len > 0 && (!bn_divmod(NULL, &t, a, g) || t.len != 0 || !bn_divmod(NULL, &t, b, g) || t.len != 0)) {
+        fail("gcdext: g does not divide the operands", len_a, len_b);
+    }
+
+    // The cofactor of the larger operand is at most half of (smaller operand) / g
+    const BigNum *big_cofactor = (bn_compare_abs(a, b) >= 0) ? x : y;
+    const BigNum *small = (bn_compare_abs(a, b) >= 0) ? b : a;
+    if (small->len > 0) {
+        if (!bn_divmod(&k, NULL, small, g) || !bn_add(&t, big_cofactor, big_cofactor)) {
+            fail("gcdext: bound computation failed", len_a, len_b);
+        } else if (bn_compare_abs(&t, &k) > 0) {
+            fail("gcdext: cofactor not minimal", len_a, len_b);
+        }
+    }
+
+    // Results may alias the operands
+    if (!bn_copy(&t, a) || !bn_gcdext(&t, &u, NULL, &t, b) || bn_compare(&t, g) != 0 || bn_compare(&u, x) != 0) {
+        fail("gcdext: aliased result differs", len_a, len_b);
+    }
+
+    // An inverse modulo b exists exactly when g is 1
+    if (b->len > 0) {
+        int one = g->len == 1 && g->limbs[0] == 1;
+        int status = bn_modinv(&r, a, b);
+        if (status != (one ? 1 : -1)) {
+            fail("modinv: wrong status", len_a, len_b);
+        } else if (one) {
+            if (r.neg || bn_compare_abs(&r, b) >= 0 || !bn_mul(&t, &r, a) || !set_small(&u, 1) ||
+                !bn_sub(&t, &t, &u) || !bn_divmod(NULL, &t, &t, b) || t.len != 0) {
+                fail("modinv: r*a != 1 mod b", len_a, len_b);
+            }
+        }
+    }
+
+    // The DList wrapper gives the same values
+    if (!bn_to_dlist(a, &la) || !bn_to_dlist(b, &lb) || !gcdext(la, la->tail, lb, lb->tail, &lg, &lx, &ly) ||
+        !bn_from_dlist(&r, lg, lg->tail) || bn_compare(&r, g) != 0 ||
+        !bn_from_dlist(&r, lx, lx->tail) || bn_compare(&r, x) != 0 ||
+        !bn_from_dlist(&r, ly, ly->tail) || bn_compare(&r, y) != 0) {
+        fail("gcdext: DList wrapper differs", len_a, len_b);
+    }
+
+    dlist_pool_reset(); // Recycle the lists of this case in one shot
+    bn_free(&r);
+    bn_free(&t);
+    bn_free(&u);
+    bn_free(&k);
+}
+
+// Check bn_gcdext, bn_modinv and the DList gcdext on one pair of operands
+static void check_gcdext_case(const BigNum *a, const BigNum *b) {
+    BigNum g, x, y;
+
+    bn_init(&g);
+    bn_init(&x);
+    bn_init(&y);
+    if (bn_gcdext(&g, &x, &y, a, b)) {
+        check_gcdext_result(a, b, &g, &x, &y);
+    } else {
+        fail("gcdext failed", a->len, b->len);
+    }
+    bn_free(&g);
+    bn_free(&x);
+    bn_free(&y);
+}
+
+// Check a pair with every combination of signs
+static void check_gcdext_signs(BigNum *a, BigNum *b) {
+    for (int s = 0; s < 4; s++) {
+        a->neg = a->len > 0 && (s & 1);
+        b->neg = b->len > 0 && (s & 2);
+        check_gcdext_case(a, b);
+    }
+}
+
+// Extended GCD and modular inverse on random operands and edge cases
+static void check_gcdext(void) {
+    const size_t sizes[] = {
+        0, 1, 2, 3, 5, bn_hgcd_threshold - 1, bn_hgcd_threshold, bn_hgcd_threshold + 1,
+        2 * bn_hgcd_threshold, 4 * bn_hgcd_threshold + 3, 1000
+    };
+    const int64_t small[] = { 0, 1, -1, 2, 3, 6, 1000000000, 999999999 };
+    size_t count = sizeof(sizes) / sizeof(sizes[0]);
+    BigNum a, b, c;
+
+    bn_init(&a);
+    bn_init(&b);
+    bn_init(&c);
+
+    // Small values, including zero, one and equal operands
+    for (size_t i = 0; i < sizeof(small) / sizeof(small[0]); i++) {
+        for (size_t j = 0; j < sizeof(small) / sizeof(small[0]); j++) {
+            if (set_small(&a, small[i]) && set_small(&b, small[j])) {
+                check_gcdext_case(&a, &b);
+            }
+        }
+    }
+
+    // Random operands of every size combination
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < count; j++) {
+            for (int trial = 0; trial < CHECK_TRIALS; trial++) {
+                if (random_operand(&a, sizes[i], 1) && random_operand(&b, sizes[j], 1)) {
+                    check_gcdext_case(&a, &b);
+                }
+            }
+        }
+    }
+
+    // Equal operands, multiples and a large common factor
+    for (size_t i = 1; i < count; i++) {
+        if (random_operand(&a, sizes[i], 0) && bn_copy(&b, &a)) {
+            check_gcdext_signs(&a, &b);
+        }
+        if (random_operand(&c, 3, 0) && bn_mul(&b, &a, &c)) {
+            check_gcdext_signs(&a, &b);
+        }
+        if (random_operand(&c, sizes[i], 0) && random_operand(&a, sizes[i] / 2 + 1, 0) && bn_mul(&a, &a, &c) &&
+            random_operand(&b, sizes[i] / 3 + 1, 0) && bn_mul(&b, &b, &c)) {
+            check_gcdext_signs(&a, &b);
+        }
+    }
+
+    // Consecutive Fibonacci numbers: every quotient of the Euclidean algorithm is 1
+    set_small(&a, 1);
+    set_small(&b, 1);
+    for (int n = 2; n <= 20000; n++) {
+        if (!bn_add(&c, &a, &b)) {
+            break;
+        }
+        bn_swap(&a, &b);
+        bn_swap(&b, &c);
+        if (n == 50 || n == 500 || n == 5000 || n == 20000) {
+            check_gcdext_signs(&a, &b);
+        }
+    }
+
+    bn_free(&a);
+    bn_free(&b);
+    bn_free(&c);
+}
+
+// A DList holding the digits of n behind `zeros` leading zeros
+static DList *padded_dlist(const BigNum *n, size_t zeros) {
+    DList *list = NULL;
+    if (!bn_to_dlist(n, &list)) {
+        return NULL;
+    }
+    for (size_t i = 0; i < zeros; i++) {
+        insert_at_head(&list, create_node(0));
+    }
+    return list;
+}
+
+// compare_dlists against bn_compare, on lists with leading zeros (and negative zeros) that must stay intact
+static void check_compare_dlists(void) {
+    BigNum a, b;
+
+    bn_init(&a);
+    bn_init(&b);
+    for (int trial = 0; trial < 2000; trial++) {
+        size_t len_a = next_random() % 3, len_b = next_random() % 3;
+        if (!random_operand(&a, len_a, 1) || !random_operand(&b, len_b, 1) ||
+            (trial % 4 == 0 && !bn_copy(&b, &a))) { // Every fourth pair: equal values with different padding
+            break;
+        }
+        DList *la = padded_dlist(&a, next_random() % 4);
+        DList *lb = padded_dlist(&b, next_random() % 4);
+        if (la == NULL || lb == NULL) {
+            fail("compare_dlists: list construction failed", len_a, len_b);
+            break;
+        }
+        if (a.len == 0 && (next_random() & 1)) {
+            la->sign = 1; // Negative zero
+        }
+        Node *head_a = la->head, *head_b = lb->head;
+        size_t length_a = la->length, length_b = lb->length;
+        int sign_a = la->sign, sign_b = lb->sign;
+
+        if (compare_dlists(la, lb) != bn_compare(&a, &b) || compare_dlists(lb, la) != bn_compare(&b, &a)) {
+            fail("compare_dlists differs from bn_compare", len_a, len_b);
+        }
+        if (la->head != head_a || la->length != length_a || la->sign != sign_a ||
+            lb->head != head_b || lb->length != length_b || lb->sign != sign_b) {
+            fail("compare_dlists modified an operand", len_a, len_b);
+        }
+        dlist_pool_reset();
+    }
+    bn_free(&a);
+    bn_free(&b);
+}
+
+// Multiplication by one limb (bn_mul, bn_mul_small_inplace, bn_addmul_small) against division
+static void check_small_multiplier(void) {
+    const size_t sizes[] = { 0, 1, 2, 5, 100, 1000 };
+    const limb_t multipliers[] = { 0, 1, 2, 10, 999999999, 123456789 };
+    BigNum a, m, p, r, s, t;
+
+    bn_init(&a);
+    bn_init(&m);
+    bn_init(&p);
+    bn_init(&r);
+    bn_init(&s);
+    bn_init(&t);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t j = 0; j < sizeof(multipliers) / sizeof(multipliers[0]); j++) {
+            size_t len = sizes[i];
+            if (!random_operand(&a, len, 1) || !set_small(&m, multipliers[j]) || !bn_mul(&p, &a, &m)) {
+                fail("mul by one limb failed", len, 1);
+                continue;
+            }
+
+            // p / m == a exactly
+            if (m.len == 0 ? p.len != 0 : (!bn_divmod(&t, &s, &p, &m) || s.len != 0 || bn_compare(&t, &a) != 0)) {
+                fail("mul by one limb: wrong product", len, 1);
+            }
+
+            // The result may alias either operand, and the product commutes
+            if (!bn_copy(&t, &a) || !bn_mul(&t, &t, &m) || bn_compare(&t, &p) != 0 ||
+                !bn_copy(&t, &m) || !bn_mul(&t, &a, &t) || bn_compare(&t, &p) != 0 ||
+                !bn_mul(&t, &m, &a) || bn_compare(&t, &p) != 0) {
+                fail("mul by one limb: aliased or swapped product differs", len, 1);
+            }
+            if (!bn_copy(&t, &a) || !bn_mul_small_inplace(&t, multipliers[j]) || bn_compare_abs(&t, &p) != 0) {
+                fail("mul_small_inplace differs", len, 1);
+            }
+
+            // s = r + |a| * m, into a shorter, equal and longer accumulator, and aliased
+            a.neg = 0;
+            p.neg = 0;
+            for (size_t k = 0; k < 3; k++) {
+                size_t r_len = (k == 0) ? len / 2 : (k == 1) ? len : len + 3;
+                if (!random_operand(&r, r_len, 0) || !bn_copy(&s, &r) || !bn_addmul_small(&s, &a, multipliers[j]) ||
+                    !bn_sub(&t, &s, &r) || bn_compare(&t, &p) != 0) {
+                    fail("addmul_small: wrong sum", len, r_len);
+                }
+            }
+            if (!bn_copy(&s, &a) || !bn_addmul_small(&s, &s, multipliers[j]) || !bn_add(&t, &a, &p) ||
+                bn_compare(&s, &t) != 0) {
+                fail("addmul_small: aliased sum differs", len, len);
+            }
+        }
+    }
+    bn_free(&a);
+    bn_free(&m);
+    bn_free(&p);
+    bn_free(&r);
+    bn_free(&s);
+    bn_free(&t);
+}
+
+// Switch to the basecase algorithms (schoolbook multiplication, Algorithm D, one thread), or back
+static void use_reference(int reference) {
+    bn_karatsuba_threshold = reference ? SIZE_MAX : default_karatsuba;
+    bn_toom3_threshold = reference ? SIZE_MAX : default_toom3;
+    bn_ntt_threshold = reference ? SIZE_MAX : default_ntt;
+    bn_newton_threshold = reference ? SIZE_MAX : default_newton;
+    bn_parallel_threshold = reference ? SIZE_MAX : default_parallel;
+}
+
+// A number of `len` limbs that are all BN_BASE - 1, the worst case for carries
+static int max_operand(BigNum *n, size_t len) {
+    if (!bn_reserve(n, len)) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        n->limbs[i] = BN_BASE - 1;
+    }
+    n->len = len;
+    n->neg = 0;
+    return 1;
+}
+
+// Check a * b (and a * a) against the schoolbook product
+static void check_product(const BigNum *a, const BigNum *b) {
+    BigNum r, ref;
+    int status;
+
+    bn_init(&r);
+    bn_init(&ref);
+    use_reference(1);
+    status = bn_mul(&ref, a, b);
+    use_reference(0);
+    if (!status || !bn_mul(&r, a, b) || bn_compare(&r, &ref) != 0) {
+        fail("mul differs from schoolbook", a->len, b->len);
+    }
+    use_reference(1);
+    status = bn_mul(&ref, a, a);
+    use_reference(0);
+    if (!status || !bn_sqr(&r, a) || bn_compare(&r, &ref) != 0) {
+        fail("sqr differs from schoolbook", a->len, a->len);
+    }
+    bn_free(&r);
+    bn_free(&ref);
+}
+
+// Products just below, at and above the crossover point t, unbalanced ones too unless the schoolbook reference is too slow
+static void check_tier(size_t t, int unbalanced) {
+    const size_t shapes[][2] = { { t - 1, t - 1 }, { t, t }, { t + 1, t + 1 }, { 2 * t + 1, t }, { t, 3 * t } };
+    size_t count = unbalanced ? sizeof(shapes) / sizeof(shapes[0]) : 3;
+    BigNum a, b;
+
+    bn_init(&a);
+    bn_init(&b);
+    for (size_t i = 0; i < count; i++) {
+        if (random_operand(&a, shapes[i][0], 1) && random_operand(&b, shapes[i][1], 1)) {
+            check_product(&a, &b);
+        }
+    }
+    if (max_operand(&a, t) && max_operand(&b, t)) {
+        check_product(&a, &b);
+    }
+    bn_free(&a);
+    bn_free(&b);
+}
+
+// Karatsuba and Toom-3 around their crossover points, where the recursion first splits
+static void check_karatsuba_toom3(void) {
+    check_tier(default_karatsuba, 1);
+    check_tier(default_toom3, 1);
+}
+
+// The NTT around its crossover point, and on long all-nines operands, whose convolution coefficients are largest
+static void check_ntt(void) {
+    BigNum a;
+
+    check_tier(default_ntt, 1);
+    bn_init(&a);
+    if (max_operand(&a, 4 * default_ntt)) {
+        check_product(&a, &a);
+    }
+    bn_free(&a);
+}
+
+// The NTT split across a thread pool, from its crossover point on
+static void check_parallel(void) {
+    bn_set_threads(CHECK_THREADS);
+    check_tier(default_parallel, 0); // Unbalanced shapes would take the schoolbook reference minutes
+    bn_set_threads(1);
+}
+
+// Check q, r = a / b, a % b against Algorithm D, and q*b + r == a with |r| < |b| and r taking the sign of a
+static void check_quotient(const BigNum *a, const BigNum *b) {
+    BigNum q, r, q_ref, r_ref, check;
+
+    bn_init(&q);
+    bn_init(&r);
+    bn_init(&q_ref);
+    bn_init(&r_ref);
+    bn_init(&check);
+    use_reference(1);
+    int status = bn_divmod(&q_ref, &r_ref, a, b);
+    use_reference(0);
+    if (!status || !bn_divmod(&q, &r, a, b) || bn_compare(&q, &q_ref) != 0 || bn_compare(&r, &r_ref) != 0) {
+        fail("divmod differs from Algorithm D", a->len, b->len);
+    }
+    if (!bn_mul(&check, &q, b) || !bn_add(&check, &check, &r) || bn_compare(&check, a) != 0 ||
+        bn_compare_abs(&r, b) >= 0 || (r.len > 0 && r.neg != a->neg)) {
+        fail("divmod: q*b + r != a", a->len, b->len);
+    }
+    bn_free(&q);
+    bn_free(&r);
+    bn_free(&q_ref);
+    bn_free(&r_ref);
+    bn_free(&check);
+}
+
+// Newton division around its crossover point, on random divisors and on the extreme ones for the reciprocal
+static void check_division(void) {
+    const size_t t = default_newton;
+    const size_t divisors[] = { 1, 2, 3, t - 1, t, t + 1, 2 * t };
+    const size_t quotients[] = { 1, t - 1, t, t + 1, 2 * t };
+    BigNum a, b;
+
+    bn_init(&a);
+    bn_init(&b);
+    for (size_t i = 0; i < sizeof(divisors) / sizeof(divisors[0]); i++) {
+        for (size_t j = 0; j < sizeof(quotients) / sizeof(quotients[0]); j++) {
+            if (random_operand(&a, divisors[i] + quotients[j], 1) && random_operand(&b, divisors[i], 1)) {
+                check_quotient(&a, &b);
+            }
+        }
+    }
+
+    // All nines (the smallest reciprocal) and BASE^(len-1) (top limb 1, the largest after normalization)
+    for (size_t len = t; len <= 2 * t; len += t) {
+        if (random_operand(&a, 2 * len, 1) && max_operand(&b, len)) {
+            check_quotient(&a, &b);
+        }
+        if (max_operand(&a, 2 * len) && max_operand(&b, len)) {
+            memset(b.limbs, 0, (len - 1) * sizeof(b.limbs[0]));
+            b.limbs[len - 1] = 1;
+            check_quotient(&a, &b);
+        }
+    }
+    bn_free(&a);
+    bn_free(&b);
+}
+
+// r = r mod 2^bits, in [0, 2^bits), where `modulus` is 2^bits
+static int reduce_fixed(BigNum *r, const BigNum *modulus) {
+    return bn_divmod(NULL, r, r, modulus) && (!r->neg || bn_add(r, r, modulus));
+}
+
+// A random value below 2^bits; one in eight is 0, 1 or 2^bits - 1
+static int random_fixed(BigNum *n, const BigNum *modulus, int bits) {
+    switch (next_random() % 8) {
+        case 0:
+            return set_small(n, 0);
+        case 1:
+            return set_small(n, 1);
+        case 2:
+            return set_small(n, -1) && reduce_fixed(n, modulus);
+        default:
+            return random_operand(n, (size_t)bits / 29 + 1, 0) && reduce_fixed(n, modulus);
+    }
+}
+
+// Fixed-width kernels of every width against BigNum results reduced modulo 2^bits
+static void check_fixed_width(void) {
+    const char operators[] = "+-*/%^";
+    BigNum a, b, m, r, ref, modulus;
+
+    bn_init(&a);
+    bn_init(&b);
+    bn_init(&m);
+    bn_init(&r);
+    bn_init(&ref);
+    bn_init(&modulus);
+    for (size_t w = 0; w < sizeof(check_widths) / sizeof(check_widths[0]); w++) {
+        int bits = check_widths[w];
+        const BnFixedOps *f = bn_fixed_ops(bits);
+        uint64_t fa[BN_FIXED_MAX_WORDS], fb[BN_FIXED_MAX_WORDS], fm[BN_FIXED_MAX_WORDS], fr[BN_FIXED_MAX_WORDS];
+
+        if (f == NULL || !set_small(&r, 2) || !set_small(&m, bits) || !bn_pow(&modulus, &r, &m)) {
+            fail("fixed: width not available", (size_t)bits, (size_t)bits);
+            continue;
+        }
+        for (int trial = 0; trial < 24; trial++) {
+            if (!random_fixed(&a, &modulus, bits) || !random_fixed(&b, &modulus, bits) ||
+                !random_fixed(&m, &modulus, bits)) {
+                continue;
+            }
+            bn_fixed_from_bignum(f, fa, &a);
+            bn_fixed_from_bignum(f, fb, &b);
+            bn_fixed_from_bignum(f, fm, &m);
+            for (const char *op = operators; *op != '\0'; op++) {
+                const char *error = NULL;
+                int status = evaluate_fixed(f, *op, fr, fa, fb, &error);
+                if (b.len == 0 && (*op == '/' || *op == '%')) {
+                    if (status) {
+                        fail("fixed: division by zero accepted", (size_t)bits, (size_t)bits);
+                    }
+                    continue;
+                }
+                int ref_status = (*op == '^') ? bn_powmod(&ref, &a, &b, &modulus) : evaluate(*op, &a, &b, &ref, &error);
+                if (!status || !ref_status || !reduce_fixed(&ref, &modulus) || !bn_fixed_to_bignum(f, &r, fr) ||
+                    bn_compare(&r, &ref) != 0) {
+                    char what[32];
+                    snprintf(what, sizeof(what), "fixed: %c differs", *op);
+                    fail(what, (size_t)bits, (size_t)bits);
+                }
+            }
+            // Modular exponentiation divides at every step, so it gets fewer trials
+            if (m.len > 0 && trial % 8 == 0) {
+                const char *error = NULL;
+                if (!evaluate_fixed_powmod(f, fr, fa, fb, fm, &error) || !bn_powmod(&ref, &a, &b, &m) ||
+                    !bn_fixed_to_bignum(f, &r, fr) || bn_compare(&r, &ref) != 0) {
+                    fail("fixed: powmod differs", (size_t)bits, (size_t)bits);
+                }
+            }
+        }
+    }
+    bn_free(&a);
+    bn_free(&b);
+    bn_free(&m);
+    bn_free(&r);
+    bn_free(&ref);
+    bn_free(&modulus);
+}
+
+// r = factors[0] * ... * factors[count - 1], multiplied in one at a time
+static int running_product(BigNum *r, BigNum *const *factors, size_t count) {
+    int status = set_small(r, 1);
+    for (size_t i = 0; status && i < count; i++) {
+        status = bn_mul(r, r, factors[i]);
+    }
+    return status;
+}
+
+// bn_product against a running product on `count` factors of `len` limbs, negative ones included
+static void check_product_tree(BigNum *const *factors, size_t count, size_t len) {
+    BigNum r, ref;
+    int negatives = 0;
+
+    bn_init(&r);
+    bn_init(&ref);
+    for (size_t i = 0; i < count; i++) {
+        if (!random_operand(factors[i], len, 1)) {
+            count = i;
+            break;
+        }
+        negatives += factors[i]->neg;
+    }
+    if (!bn_product(&r, (const BigNum *const *)factors, count) || !running_product(&ref, factors, count) ||
+        bn_compare(&r, &ref) != 0 || r.neg != (negatives & 1)) {
+        fail("product differs from a running product", count, len);
+    }
+    bn_free(&r);
+    bn_free(&ref);
+}
+
+// r = n! as 2 * 3 * ... * n, one factor at a time
+static int running_factorial(BigNum *r, uint64_t n) {
+    int status = set_small(r, 1);
+    for (uint64_t i = 2; status && i <= n; i++) {
+        status = bn_mul_small_inplace(r, (limb_t)i);
+    }
+    return status;
+}
+
+// bn_binomial(n, k) against n (n-1) ... (n-k+1) / k! with small k, or its failure; `expected` is 0 or 1 if known
+static void check_binomial(const BigNum *n, int64_t k, int expected) {
+    BigNum kk, r, ref, factor, step;
+    int status;
+
+    bn_init(&kk);
+    bn_init(&r);
+    bn_init(&ref);
+    bn_init(&factor);
+    bn_init(&step);
+    status = set_small(&kk, k) && bn_binomial(&r, n, &kk);
+    if (expected >= 0) {
+        status = status && set_small(&ref, expected);
+    } else {
+        status = status && set_small(&ref, 1) && bn_copy(&factor, n) && set_small(&step, 1);
+        for (int64_t i = 0; status && i < k; i++) {
+            status = bn_mul(&ref, &ref, &factor) && bn_sub(&factor, &factor, &step);
+        }
+        status = status && running_factorial(&step, (uint64_t)k) && bn_divmod(&ref, NULL, &ref, &step);
+    }
+    if (!status || bn_compare(&r, &ref) != 0) {
+        fail("binomial differs from n (n-1) ... (n-k+1) / k!", n->len, (size_t)(k < 0 ? 0 : k));
+    }
+    bn_free(&kk);
+    bn_free(&r);
+    bn_free(&ref);
+    bn_free(&factor);
+    bn_free(&step);
+}
+
+// Product trees, factorials and binomials against products formed one factor at a time, on four threads
+static void check_products(void) {
+    const size_t shapes[][2] = {
+        { 5, 3 }, { 12, 3 }, { 2, 2 * default_karatsuba }, { 24, default_karatsuba }, { CHECK_FACTORS, CHECK_FORK_LIMBS / 64 }
+    };
+    const uint64_t factorials[] = { 0, 1, 2, 20, 200, 3000, 12000 };
+    BigNum storage[CHECK_FACTORS], *factors[CHECK_FACTORS], n, k, r, ref;
+
+    bn_set_threads(CHECK_THREADS);
+    for (size_t i = 0; i < CHECK_FACTORS; i++) {
+        bn_init(&storage[i]);
+        factors[i] = &storage[i];
+    }
+    bn_init(&n);
+    bn_init(&k);
+    bn_init(&r);
+    bn_init(&ref);
+
+    // Below and above the Karatsuba threshold and PRODUCT_FORK_LIMBS of result limbs
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        check_product_tree(factors, shapes[i][0], shapes[i][1]);
+    }
+    if (!bn_product(&r, NULL, 0) || !set_small(&ref, 1) || bn_compare(&r, &ref) != 0) {
+        fail("product of no factors is not 1", 0, 0);
+    }
+    if (random_operand(factors[0], 3, 1) && set_small(factors[1], 0) && random_operand(factors[2], 3, 1) &&
+        (!bn_product(&r, (const BigNum *const *)factors, 3) || r.len != 0 || r.neg)) {
+        fail("product with a zero factor is not 0", 3, 3);
+    }
+
+    // 12000! is about 5000 limbs, so its top subtrees fork
+    for (size_t i = 0; i < sizeof(factorials) / sizeof(factorials[0]); i++) {
+        if (!bn_factorial(&r, factorials[i]) || !running_factorial(&ref, factorials[i]) || bn_compare(&r, &ref) != 0) {
+            fail("factorial differs from a running product", (size_t)factorials[i], 0);
+        }
+    }
+
+    // Edge cases of k, then n of one limb and of more than two limbs (the factors are then BigNums)
+    if (set_small(&n, 50)) {
+        check_binomial(&n, -1, 0);
+        check_binomial(&n, 51, 0);
+        check_binomial(&n, 0, 1);
+        check_binomial(&n, 50, 1);
+        check_binomial(&n, 1, -1);
+        check_binomial(&n, 25, -1);
+        check_binomial(&n, 49, -1);
+    }
+    for (size_t len = 3; len <= 40; len += 37) {
+        if (random_operand(&n, len, 0)) {
+            check_binomial(&n, 0, 1);
+            check_binomial(&n, 3, -1);
+            check_binomial(&n, 40, -1);
+        }
+        // k = n - 2, where the shorter product n (n-1) ... (k+1) is taken
+        if (set_small(&k, 2) && bn_sub(&k, &n, &k) && set_small(&ref, 2) && (!bn_binomial(&r, &n, &k) ||
+            !bn_binomial(&ref, &n, &ref) || bn_compare(&r, &ref) != 0)) {
+            fail("binomial(n, n - 2) differs from binomial(n, 2)", len, 1);
+        }
+    }
+    if (set_small(&n, -5) && set_small(&k, 2) && bn_binomial(&r, &n, &k)) {
+        fail("binomial of a negative number accepted", 1, 1);
+    }
+
+    for (size_t i = 0; i < CHECK_FACTORS; i++) {
+        bn_free(&storage[i]);
+    }
+    bn_free(&n);
+    bn_free(&k);
+    bn_free(&r);
+    bn_free(&ref);
+    bn_set_threads(1);
+}
+
+// The i-th number of the binary format checks: zero, then values of one to 1000 limbs, alternately negative
+static int binary_sample(BigNum *n, int i) {
+    const size_t lengths[CHECK_BINARY_SAMPLES] = { 0, 1, 1, 2, 3, 3, 50, 1000 };
+    if (!random_operand(n, lengths[i], 0)) {
+        return 0;
+    }
+    n->neg = n->len > 0 && (i & 1);
+    return 1;
+}
+
+// Result of bn_read_binary on a stream holding the bytes of data
+static int read_record(BigNum *n, const void *data, size_t len) {
+    FILE *fp = tmpfile();
+    int got = 0;
+    if (fp != NULL && fwrite(data, 1, len, fp) == len && fseek(fp, 0, SEEK_SET) == 0) {
+        got = bn_read_binary(n, fp);
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    return got;
+}
+
+// Binary records round trip through a stream and an unaligned buffer; truncated and corrupted ones are rejected
+static void check_binary_format(void) {
+    BigNum n[CHECK_BINARY_SAMPLES], r;
+    FILE *fp = tmpfile();
+    int status = fp != NULL;
+
+    bn_init(&r);
+    for (int i = 0; i < CHECK_BINARY_SAMPLES; i++) {
+        bn_init(&n[i]);
+        status = status && binary_sample(&n[i], i) && bn_write_binary(fp, &n[i]);
+    }
+    status = status && fseek(fp, 0, SEEK_SET) == 0;
+    for (int i = 0; status && i < CHECK_BINARY_SAMPLES; i++) {
+        if (bn_read_binary(&r, fp) != 1 || bn_compare(&r, &n[i]) != 0) {
+            fail("binary: stream round trip differs", n[i].len, r.len);
+        }
+    }
+    if (!status || bn_read_binary(&r, fp) != -1) {
+        fail("binary: stream does not end after the last record", 0, 0);
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    for (int i = 0; i < CHECK_BINARY_SAMPLES; i++) {
+        size_t size = bn_binary_size(&n[i]), used = 0;
+        unsigned char *buf = (unsigned char *)malloc(size + 1);
+        if (buf == NULL) {
+            continue;
+        }
+        unsigned char *record = buf + 1; // Limbs off their alignment, as they may be in a larger buffer
+        if (bn_to_binary(record, &n[i]) != size || !bn_from_binary(&r, record, size, &used) || used != size ||
+            bn_compare(&r, &n[i]) != 0) {
+            fail("binary: buffer round trip differs", n[i].len, r.len);
+        }
+
+        // One limb short, so a zero loses part of its header
+        if (bn_from_binary(&r, record, size - sizeof(limb_t), NULL) ||
+            read_record(&r, record, size - sizeof(limb_t)) != 0) {
+            fail("binary: truncated record accepted", n[i].len, n[i].len);
+        }
+        record[16] ^= 1; // Lowest byte of the checksum
+        if (bn_from_binary(&r, record, size, NULL) || read_record(&r, record, size) != 0) {
+            fail("binary: record with a bad checksum accepted", n[i].len, n[i].len);
+        }
+        free(buf);
+    }
+    for (int i = 0; i < CHECK_BINARY_SAMPLES; i++) {
+        bn_free(&n[i]);
+    }
+    bn_free(&r);
+}
+
+// Path of the cache entry for key, as cache.c names it
+static void entry_path(char *path, size_t size, const char *dir, const CacheKey *key) {
+    size_t pos = (size_t)snprintf(path, size, "%s/", dir);
+    for (int i = 0; i < CACHE_KEY_BYTES && pos < size; i++) {
+        pos += (size_t)snprintf(path + pos, size - pos, "%02x", key->digest[i]);
+    }
+    if (pos < size) {
+        snprintf(path + pos, size - pos, ".apcn");
+    }
+}
+
+// A stored cache entry is found again; one renamed to another key's file or truncated is a miss
+static void check_cache(void) {
+    char dir[256], path_a[384], path_b[384];
+    CacheKey key_a, key_b;
+    BigNum a, b, r, got;
+
+    snprintf(dir, sizeof(dir), "%s/apc_check_XXXXXX", scratch_dir());
+    if (mkdtemp(dir) == NULL || !cache_open(dir)) {
+        fail("cache: no scratch directory", 0, 0);
+        return;
+    }
+    bn_init(&a);
+    bn_init(&b);
+    bn_init(&r);
+    bn_init(&got);
+    const BigNum *operands[] = { &a, &b };
+    if (random_operand(&a, 40, 1) && random_operand(&b, 40, 1) && bn_mul(&r, &a, &b)) {
+        cache_key(&key_a, '*', operands, 2);
+        cache_key(&key_b, '+', operands, 2);
+        entry_path(path_a, sizeof(path_a), dir, &key_a);
+        entry_path(path_b, sizeof(path_b), dir, &key_b);
+
+        cache_store(dir, &key_a, &r);
+        if (!cache_lookup(dir, &key_a, &got) || bn_compare(&got, &r) != 0) {
+            fail("cache: stored entry not found", a.len, b.len);
+        }
+        if (cache_lookup(dir, &key_b, &got)) {
+            fail("cache: hit on a key never stored", a.len, b.len);
+        }
+
+        // The entry still carries the key it was stored under
+        if (rename(path_a, path_b) != 0 || cache_lookup(dir, &key_b, &got)) {
+            fail("cache: entry renamed to another key hit", a.len, b.len);
+        }
+        cache_store(dir, &key_a, &r);
+        if (truncate(path_a, (off_t)(CACHE_KEY_BYTES + bn_binary_size(&r) - sizeof(limb_t))) != 0 ||
+            cache_lookup(dir, &key_a, &got)) {
+            fail("cache: truncated entry hit", a.len, b.len);
+        }
+        unlink(path_a);
+        unlink(path_b);
+    }
+    rmdir(dir);
+    bn_free(&a);
+    bn_free(&b);
+    bn_free(&r);
+    bn_free(&got);
+}
+
+// Record a calculator output line that differs from the expected one (line 0: the mode did not run)
+static void fail_line(const char *mode, size_t line) {
+    printf("FAIL: apc %s: line %zu (seed %llu)\n", mode, line, (unsigned long long)seed);
+    failures++;
+}
+
+// Decimal text of n, or NULL when out of memory; the caller frees it
+static char *decimal_text(const BigNum *n) {
+    char *text = (char *)malloc(bn_decimal_size(n) + 1);
+    if (text != NULL) {
+        text[bn_to_chars(text, n)] = '\0';
+    }
+    return text;
+}
+
+// Append an expression and its expected output line to a script, which takes both strings (NULL: out of memory)
+static int script_push(Script *s, char *line, char *expected) {
+    if (s->count == s->cap && line != NULL && expected != NULL) {
+        size_t cap = s->cap ? 2 * s->cap : 64;
+        char **lines = (char **)realloc(s->lines, cap * sizeof(char *));
+        if (lines != NULL) {
+            s->lines = lines;
+            char **grown = (char **)realloc(s->expected, cap * sizeof(char *));
+            if (grown != NULL) {
+                s->expected = grown;
+                s->cap = cap;
+            }
+        }
+    }
+    if (s->count == s->cap || line == NULL || expected == NULL) {
+        free(line);
+        free(expected);
+        return 0;
+    }
+    s->lines[s->count] = line;
+    s->expected[s->count] = expected;
+    s->count++;
+    return 1;
+}
+
+// Append the expression `a op b` and its expected output line to a script
+static int script_add(Script *s, const BigNum *a, char op, const BigNum *b, const BigNum *result, const char *error) {
+    char *ta = decimal_text(a), *tb = decimal_text(b);
+    char *line = (ta != NULL && tb != NULL) ? (char *)malloc(strlen(ta) + strlen(tb) + 8) : NULL;
+    char *expected = (error != NULL) ? strdup(error) : decimal_text(result);
+    if (line != NULL) {
+        // Negative operands are parenthesized so that `^` applies to the whole number
+        sprintf(line, a->neg ? "(%s)%c" : "%s%c", ta, op);
+        sprintf(line + strlen(line), b->neg ? "(%s)" : "%s", tb);
+    }
+    free(ta);
+    free(tb);
+    return script_push(s, line, expected);
+}
+
+// Append a number as an expression that evaluates to itself
+static int script_add_number(Script *s, const BigNum *n) {
+    return script_push(s, decimal_text(n), decimal_text(n));
+}
+
+// Append an expression given as text and its expected output line
+static int script_add_text(Script *s, const char *line, const char *expected) {
+    return script_push(s, strdup(line), strdup(expected));
+}
+
+static void script_free(Script *s) {
+    for (size_t i = 0; i < s->count; i++) {
+        free(s->lines[i]);
+        free(s->expected[i]);
+    }
+    free(s->lines);
+    free(s->expected);
+}
+
+// Add `a op b` with the result of the basecase algorithms
+static int script_add_reference(Script *s, const BigNum *a, char op, const BigNum *b) {
+    BigNum r;
+    const char *error = NULL;
+
+    bn_init(&r);
+    use_reference(1);
+    int status = evaluate(op, a, b, &r, &error);
+    use_reference(0);
+    status = script_add(s, a, op, b, &r, status ? NULL : error);
+    bn_free(&r);
+    return status;
+}
+
+// Expressions with operands around every crossover point, answered by the basecase algorithms
+static int build_bignum_script(Script *s) {
+    const size_t sizes[] = {
+        1, 5, default_karatsuba - 1, default_karatsuba, default_toom3, default_toom3 + 1,
+        default_ntt - 1, default_ntt, default_newton, default_newton + 1, default_parallel
+    };
+    const char operators[] = "+-*";
+    BigNum a, b, e;
+    int status = 1;
+
+    bn_init(&a);
+    bn_init(&b);
+    bn_init(&e);
+    for (size_t i = 0; status && i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t len = sizes[i];
+        for (const char *op = operators; status && *op != '\0'; op++) {
+            status = random_operand(&a, len, 1) && random_operand(&b, len, 1) && script_add_reference(s, &a, *op, &b);
+        }
+
+        // Quotient and divisor both of `len` limbs
+        status = status && random_operand(&a, 2 * len, 1) && random_operand(&b, len, 1) &&
+                 script_add_reference(s, &a, '/', &b) && script_add_reference(s, &a, '%', &b);
+
+        // A cube stays affordable for the schoolbook reference below the parallel tier
+        if (status && len < default_parallel) {
+            status = random_operand(&a, len, 1) && set_small(&e, 3) && script_add_reference(s, &a, '^', &e);
+        }
+    }
+    bn_free(&a);
+    bn_free(&b);
+    bn_free(&e);
+    return status;
+}
+
+// Expressions on values below 2^bits, answered by BigNum arithmetic reduced modulo 2^bits
+static int build_fixed_script(Script *s, int bits) {
+    const char operators[] = "+-*/%^";
+    BigNum a, b, r, m, modulus;
+    int status;
+
+    bn_init(&a);
+    bn_init(&b);
+    bn_init(&r);
+    bn_init(&m);
+    bn_init(&modulus);
+    status = set_small(&r, 2) && set_small(&m, bits) && bn_pow(&modulus, &r, &m);
+    for (int trial = 0; status && trial < 16; trial++) {
+        for (const char *op = operators; status && *op != '\0'; op++) {
+            const char *error = NULL;
+            status = random_fixed(&a, &modulus, bits) && random_fixed(&b, &modulus, bits);
+            if (status && *op == '^') {
+                status = bn_powmod(&r, &a, &b, &modulus);
+            } else if (status && !evaluate(*op, &a, &b, &r, &error)) {
+                status = script_add(s, &a, *op, &b, NULL, error); // Division by zero
+                continue;
+            }
+            status = status && reduce_fixed(&r, &modulus) && script_add(s, &a, *op, &b, &r, NULL);
+        }
+    }
+    bn_free(&a);
+    bn_free(&b);
+    bn_free(&r);
+    bn_free(&m);
+    bn_free(&modulus);
+    return status;
+}
+
+// Precedence, associativity, variables and malformed lines, then `a ^ e % m` lines answered by bn_powmod
+static int build_parser_script(Script *s) {
+    static const char *const cases[][2] = {
+        { "2+3*4", "14" }, { "2*3+4", "10" }, { "(2+3)*4", "20" }, { "10-4-3", "3" }, { "100/10/5", "2" },
+        { "7 % 3 * 2", "2" }, { "2^3^2", "512" }, { "(2^3)^2", "64" }, { "-2^2", "-4" }, { "(-2)^2", "4" },
+        { "2^3!", "64" }, { "2^-1", "Error: Negative exponent" }, { "2 ^ 10 % 1000", "24" },
+        { "x = 6", "6" }, { "x * x", "36" }, { "ans + x", "42" }, { "y = ans - 2", "40" }, { "y / x", "6" },
+        { "z", "Error: Undefined variable" }, { "ans", "6" },
+        { "3+", "Invalid Input Format." }, { "((1)", "Invalid Input Format." }, { "1)", "Invalid Input Format." },
+        { "2**3", "Invalid Input Format." }, { "  12  +  3 ", "15" }
+    };
+    const size_t lengths[][2] = { { 1, 1 }, { 3, 2 }, { CHECK_POWMOD_LIMBS, 10 } };
+    BigNum a, e, m, r;
+    int status = 1;
+
+    for (size_t i = 0; status && i < sizeof(cases) / sizeof(cases[0]); i++) {
+        status = script_add_text(s, cases[i][0], cases[i][1]);
+    }
+    bn_init(&a);
+    bn_init(&e);
+    bn_init(&m);
+    bn_init(&r);
+    for (size_t i = 0; status && i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for (int trial = 0; status && trial < CHECK_TRIALS; trial++) {
+            status = random_operand(&a, lengths[i][0], 1) && random_operand(&e, lengths[i][1], 0) &&
+                     random_operand(&m, lengths[i][0], 0) && bn_powmod(&r, &a, &e, &m);
+            char *ta = status ? decimal_text(&a) : NULL, *te = status ? decimal_text(&e) : NULL;
+            char *tm = status ? decimal_text(&m) : NULL;
+            char *line = (ta != NULL && te != NULL && tm != NULL) ?
+                         (char *)malloc(strlen(ta) + strlen(te) + strlen(tm) + 16) : NULL;
+            if (line != NULL) {
+                sprintf(line, a.neg ? "(%s) ^ %s %% %s" : "%s ^ %s %% %s", ta, te, tm);
+            }
+            free(ta);
+            free(te);
+            free(tm);
+            status = status && script_push(s, line, decimal_text(&r));
+        }
+    }
+    bn_free(&a);
+    bn_free(&e);
+    bn_free(&m);
+    bn_free(&r);
+    return status;
+}
+
+// Factorials, binomials and products written with `!`, `binomial(...)` and `product(...)`
+static int build_function_script(Script *s) {
+    static const char *const cases[][2] = {
+        { "0!", "1" }, { "5!", "120" }, { "3!!", "720" }, { "-3!", "-6" },
+        { "(-3)!", "Error: Factorial of a negative number" },
+        { "binomial(10, 3)", "120" }, { "binomial(10, 0)", "1" }, { "binomial(10, 10)", "1" },
+        { "binomial(10, -1)", "0" }, { "binomial(10, 11)", "0" },
+        { "binomial(-10, 3)", "Error: Binomial of a negative number" },
+        { "product(7)", "7" }, { "product(-2, 3, 4)", "-24" }, { "product(-2, 3, -4)", "24" },
+        { "product(-1, -1, -1, 5, 0)", "0" }
+    };
+    BigNum storage[3], *factors[3], r;
+    int status = 1;
+
+    for (size_t i = 0; status && i < sizeof(cases) / sizeof(cases[0]); i++) {
+        status = script_add_text(s, cases[i][0], cases[i][1]);
+    }
+
+    // Factors long enough for a product tree, and n! past the Karatsuba threshold
+    bn_init(&r);
+    for (int i = 0; i < 3; i++) {
+        bn_init(&storage[i]);
+        factors[i] = &storage[i];
+        status = status && random_operand(factors[i], default_karatsuba, 1);
+    }
+    char *ta = status ? decimal_text(factors[0]) : NULL;
+    char *tb = status ? decimal_text(factors[1]) : NULL;
+    char *tc = status ? decimal_text(factors[2]) : NULL;
+    char *line = (ta != NULL && tb != NULL && tc != NULL) ?
+                 (char *)malloc(strlen(ta) + strlen(tb) + strlen(tc) + 16) : NULL;
+    if (line != NULL) {
+        sprintf(line, "product(%s, %s, %s)", ta, tb, tc);
+    }
+    if (status && line != NULL && running_product(&r, factors, 3)) {
+        status = script_push(s, line, decimal_text(&r)) &&
+                 running_factorial(&r, 1000) && script_push(s, strdup("1000!"), decimal_text(&r));
+    } else {
+        free(line);
+        status = 0;
+    }
+    free(ta);
+    free(tb);
+    free(tc);
+    for (int i = 0; i < 3; i++) {
+        bn_free(&storage[i]);
+    }
+    bn_free(&r);
+    return status;
+}
+
+// Create a new scratch file open for writing; returns its path (to unlink and free) or NULL
+static char *scratch_file(FILE **fp) {
+    char *path = (char *)malloc(strlen(scratch_dir()) + 32);
+    int fd = -1;
+
+    *fp = NULL;
+    if (path != NULL) {
+        sprintf(path, "%s/apc_check_XXXXXX", scratch_dir());
+        fd = mkstemp(path);
+    }
+    if (fd >= 0) {
+        *fp = fdopen(fd, "w");
+        if (*fp == NULL) {
+            close(fd);
+            unlink(path);
+        }
+    }
+    if (*fp == NULL) {
+        free(path);
+        path = NULL;
+    }
+    return path;
+}
+
+// Close a scratch file, deleting it unless everything was written; returns its path or NULL
+static char *scratch_close(FILE *fp, char *path, int written) {
+    if (fclose(fp) != 0 || !written) {
+        unlink(path);
+        free(path);
+        path = NULL;
+    }
+    return path;
+}
+
+// Write the expressions of a script to a new scratch file; returns its path (to unlink and free) or NULL
+static char *write_script(const Script *s) {
+    FILE *fp;
+    char *path = scratch_file(&fp);
+    int written = path != NULL;
+
+    for (size_t i = 0; written && i < s->count; i++) {
+        written = fprintf(fp, "%s\n", s->lines[i]) > 0;
+    }
+    return (path != NULL) ? scratch_close(fp, path, written) : NULL;
+}
+
+// Run `apc OPTIONS PATH` and compare its output, decimal lines or binary records, with the expected lines
+static void check_output(const char *apc, const char *options, const char *path, const Script *s, int binary) {
+    char *command = (char *)malloc(strlen(apc) + strlen(options) + strlen(path) + 3);
+    FILE *out = NULL;
+
+    if (command != NULL) {
+        sprintf(command, "%s %s %s", apc, options, path);
+        out = popen(command, "r");
+    }
+    if (out == NULL) {
+        fail_line(options, 0);
+        free(command);
+        return;
+    }
+    char *line = NULL;
+    size_t cap = 0, count = 0;
+    ssize_t len;
+    BigNum r;
+    int got;
+    bn_init(&r);
+    while (binary ? (got = bn_read_binary(&r, out)) == 1 : (len = getline(&line, &cap, out)) >= 0) {
+        if (binary) {
+            free(line);
+            line = decimal_text(&r);
+        } else if (len > 0 && line[len - 1] == '\n') {
+            line[len - 1] = '\0';
+        }
+        if (line == NULL || count >= s->count || strcmp(line, s->expected[count]) != 0) {
+            fail_line(options, count + 1);
+        }
+        count++;
+    }
+    if (count < s->count || (binary && got == 0)) {
+        fail_line(options, count + 1); // Missing output, or a malformed record
+    }
+    bn_free(&r);
+    free(line);
+    free(command);
+    pclose(out); // Exits with 1 when a line was an error, as the division by zero lines are
+}
+
+// Run `apc OPTIONS FILE` on a script and compare its output with the expected lines
+static void check_mode(const char *apc, const Script *s, const char *options) {
+    char *path = write_script(s);
+
+    if (path == NULL) {
+        fail_line(options, 0);
+        return;
+    }
+    check_output(apc, options, path, s, 0);
+    unlink(path);
+    free(path);
+}
+
+// Results written as binary records by file mode, and records read back as decimal lines and as records
+static void check_binary_modes(const char *apc) {
+    Script script = { NULL, NULL, 0, 0 };
+    BigNum n;
+    FILE *fp;
+    char *records = scratch_file(&fp);
+    int status = records != NULL;
+
+    bn_init(&n);
+    for (int i = 0; status && i < CHECK_BINARY_SAMPLES; i++) {
+        status = binary_sample(&n, i) && script_add_number(&script, &n) && bn_write_binary(fp, &n);
+    }
+    if (records != NULL) {
+        records = scratch_close(fp, records, status);
+    }
+    char *path = (records != NULL) ? write_script(&script) : NULL;
+    if (path == NULL) {
+        fail_line("(writing the binary records)", 0);
+    } else {
+        check_output(apc, "--out-format binary --file", path, &script, 1);
+        check_output(apc, "--in-format binary --file", records, &script, 0);
+        check_output(apc, "--in-format binary --out-format binary --file", records, &script, 1);
+        unlink(path);
+    }
+    if (records != NULL) {
+        unlink(records);
+    }
+    free(path);
+    free(records);
+    script_free(&script);
+    bn_free(&n);
+}
+
+// Write all of buf to a socket; returns 0 on failure
+static int send_all(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Read exactly len bytes from a socket; returns 0 on failure or end of stream
+static int recv_all(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+// Send one request frame and check that the response carries the expected text
+static int serve_exchange(int fd, const char *request, const char *expected) {
+    size_t len = strlen(request);
+    unsigned char header[4] = {
+        (unsigned char)(len >> 24), (unsigned char)(len >> 16), (unsigned char)(len >> 8), (unsigned char)len
+    };
+    if (!send_all(fd, header, sizeof(header)) || !send_all(fd, request, len) || !recv_all(fd, header, sizeof(header))) {
+        return 0;
+    }
+    size_t size = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) | ((size_t)header[2] << 8) | header[3];
+    char *response = (size > 0) ? (char *)malloc(size) : NULL;
+    int match = response != NULL && recv_all(fd, response, size) &&
+                size - 1 == strlen(expected) && memcmp(response + 1, expected, size - 1) == 0;
+    free(response);
+    return match;
+}
+
+// Run `apc --serve` and send it every expression of a script, one request at a time
+static void check_serve(const char *apc, const Script *s) {
+    struct sockaddr_un addr;
+    int status, fd = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if ((size_t)snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/apc_check_%d.sock", scratch_dir(),
+                         (int)getpid()) >= sizeof(addr.sun_path)) {
+        fail_line("--serve", 0);
+        return;
+    }
+    fflush(stdout); // The child must not write the failures reported so far a second time
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (freopen("/dev/null", "w", stdout) != NULL) {
+            execl(apc, apc, "--serve", addr.sun_path, "--threads", CHECK_THREADS_TEXT, (char *)NULL);
+        }
+        _exit(127);
+    }
+    if (pid < 0) {
+        fail_line("--serve", 0);
+        return;
+    }
+
+    // Wait for the server to listen
+    for (int tries = 0; fd < 0 && tries < CHECK_CONNECT_TRIES; tries++) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+            usleep(10000);
+        }
+    }
+    if (fd < 0) {
+        fail_line("--serve", 0);
+    }
+    for (size_t i = 0; fd >= 0 && i < s->count; i++) {
+        if (!serve_exchange(fd, s->lines[i], s->expected[i])) {
+            fail_line("--serve", i + 1);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    kill(pid, SIGTERM);
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fail_line("--serve (exit status)", 0);
+    }
+}
+
+// The calculator: batch and server mode against the reference, every width, the binary formats and function calls
+static void check_modes(const char *apc) {
+    Script script = { NULL, NULL, 0, 0 };
+
+    if (!build_bignum_script(&script)) {
+        fail_line("(building the expressions)", 0);
+    } else {
+        check_mode(apc, &script, "--file");
+        check_mode(apc, &script, "--threads " CHECK_THREADS_TEXT " --batch");
+        check_serve(apc, &script);
+    }
+    script_free(&script);
+    check_binary_modes(apc);
+
+    Script parser = { NULL, NULL, 0, 0 };
+    if (!build_parser_script(&parser)) {
+        fail_line("(building the parser expressions)", 0);
+    } else {
+        check_mode(apc, &parser, "--file");
+    }
+    script_free(&parser);
+
+    Script functions = { NULL, NULL, 0, 0 };
+    if (!build_function_script(&functions)) {
+        fail_line("(building the function expressions)", 0);
+    } else {
+        check_mode(apc, &functions, "--file");
+    }
+    script_free(&functions);
+
+    for (size_t w = 0; w < sizeof(check_widths) / sizeof(check_widths[0]); w++) {
+        char options[64];
+        Script fixed = { NULL, NULL, 0, 0 };
+        if (!build_fixed_script(&fixed, check_widths[w])) {
+            fail_line("(building the fixed-width expressions)", 0);
+        } else {
+            snprintf(options, sizeof(options), "--width %d --file", check_widths[w]);
+            check_mode(apc, &fixed, options);
+            snprintf(options, sizeof(options), "--width %d --threads " CHECK_THREADS_TEXT " --batch", check_widths[w]);
+            check_mode(apc, &fixed, options);
+        }
+        script_free(&fixed);
+    }
+}
+
+// Parse options and run every check
+int main(int argc, char *argv[]) {
+    const char *apc = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--apc") == 0 && i + 1 < argc) {
+            apc = argv[++i];
+        } else {
+            printf("Usage: %s [--seed N] [--apc PATH]\n", argv[0]);
+            return 1;
+        }
+    }
+    state = seed ? seed : 1;
+    default_karatsuba = bn_karatsuba_threshold;
+    default_toom3 = bn_toom3_threshold;
+    default_ntt = bn_ntt_threshold;
+    default_newton = bn_newton_threshold;
+    default_parallel = bn_parallel_threshold;
+
+    check_compare_dlists();
+    check_small_multiplier();
+    check_karatsuba_toom3();
+    check_ntt();
+    check_parallel();
+    check_division();
+    check_fixed_width();
+    check_gcdext();
+    check_products();
+    check_binary_format();
+    check_cache();
+    dlist_pool_release();
+    if (apc != NULL) {
+        check_modes(apc);
+    }
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
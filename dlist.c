@@ -9,8 +9,16 @@
  * - Printing the list for debugging
  * - Freeing memory allocated for the list
  *
+ * Nodes and lists are carved out of slab pools instead of being allocated one
+ * at a time with malloc. Freed nodes and lists go onto a free-list and are
+ * handed out again by the next create call, and `dlist_pool_reset` recycles
+ * every slab in one shot once a calculation is finished, so in steady state the
+ * list functions do not call malloc at all. The pools are not thread-safe.
+ * Only users of the DList API need them: the calculator works on BigNums.
+ *
  * Data Structures:
- * - DList: Represents the doubly linked list, containing pointers to the head and tail nodes.
+ * - DList: Represents the doubly linked list, containing pointers to the head and tail nodes,
+ *          its length and the sign of the number it holds.
  * - Node: Represents a node in the list, containing data and pointers to the previous and next nodes.
  *
  * Functions:
@@ -20,23 +28,107 @@
  * - void insert_at_tail(DList **list, Node *new_node): Inserts a new node at the tail of the list.
  * - void print_list(DList *list): Prints the list contents from head to tail.
  * - void free_list(DList *list): Frees all memory allocated for the list.
+ * - void dlist_normalize(DList *list): Strips leading zeros.
+ * - void dlist_pool_reset(): Recycles every node and list handed out so far.
+ * - void dlist_pool_release(): Returns the pooled memory to the system.
 */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include "dlist.h"
+#include "stats.h"
+
+#define POOL_SLAB_OBJECTS 4096  // Objects carved out of each slab
+
+// A slab is one malloc'd block holding many fixed-size objects
+typedef struct Slab {
+    struct Slab *next;      // Next slab in the pool
+    size_t used;            // Objects handed out from this slab
+    max_align_t storage[];  // Object storage
+} Slab;
+
+// Entry of a pool's free-list, overlaid on a released object
+typedef struct FreeObject {
+    struct FreeObject *next;
+} FreeObject;
+
+typedef struct Pool {
+    size_t object_size;     // Size of each object
+    Slab *slabs;            // All slabs owned by the pool
+    Slab *current;          // Slab currently being carved
+    FreeObject *free_objects; // Objects released for reuse
+} Pool;
+
+static Pool node_pool = { sizeof(Node), NULL, NULL, NULL };
+static Pool list_pool = { sizeof(DList), NULL, NULL, NULL };
+
+// Take one object from a pool, reusing released objects first
+static void* pool_alloc(Pool *pool) {
+    if (pool->free_objects != NULL) {
+        FreeObject *object = pool->free_objects;
+        pool->free_objects = object->next;
+        return object;
+    }
+    if (pool->current == NULL || pool->current->used == POOL_SLAB_OBJECTS) {
+        Slab *next = (pool->current != NULL) ? pool->current->next : pool->slabs;
+        if (next == NULL) {
+            next = (Slab *)malloc(sizeof(Slab) + POOL_SLAB_OBJECTS * pool->object_size);
+            if (next == NULL) {
+                return NULL;
+            }
+            next->next = NULL;
+            if (pool->current != NULL) {
+                pool->current->next = next;
+            } else {
+                pool->slabs = next;
+            }
+        }
+        next->used = 0;
+        pool->current = next;
+    }
+    return (char *)pool->current->storage + pool->current->used++ * pool->object_size;
+}
+
+// Put an object back on the pool's free-list
+static void pool_free(Pool *pool, void *object) {
+    FreeObject *entry = (FreeObject *)object;
+    entry->next = pool->free_objects;
+    pool->free_objects = entry;
+}
+
+// Rewind a pool so all of its slabs can be carved again
+static void pool_reset(Pool *pool) {
+    pool->current = NULL;
+    pool->free_objects = NULL;
+}
+
+// Free every slab owned by a pool
+static void pool_release(Pool *pool) {
+    Slab *slab = pool->slabs;
+    while (slab != NULL) {
+        Slab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    pool->slabs = NULL;
+    pool_reset(pool);
+}
 
 // Create an empty doubly linked list
 DList* create_empty_list() {
-    DList *list = (DList *)malloc(sizeof(DList));
+    DList *list = (DList *)pool_alloc(&list_pool);
     list->head = NULL;
     list->tail = NULL;
+    list->length = 0;
+    list->sign = 0;
     return list;
 }
 
 // Create a new node with the given data
 Node* create_node(int data) {
-    Node *new_node = (Node *)malloc(sizeof(Node));
+    Node *new_node = (Node *)pool_alloc(&node_pool);
+    STATS_NODE();
     new_node->data = data;
     new_node->prev = NULL;
     new_node->next = NULL;
@@ -55,6 +147,7 @@ void insert_at_head(DList **list, Node *new_node) {
         (*list)->tail = new_node; // If the list was empty, tail is also new_node
     }
     (*list)->head = new_node;
+    (*list)->length++;
 }
 
 // Insert a new node at the tail of the list
@@ -69,16 +162,35 @@ void insert_at_tail(DList **list, Node *new_node) {
         (*list)->head = new_node; // If the list was empty, head is also new_node
     }
     (*list)->tail = new_node;
+    (*list)->length++;
 }
 
 // Print the list for debugging
 void print_list(DList *list) {
-    Node *current = list->head;
-    while (current != NULL) {
-        printf("%d", current->data);
-        current = current->next;
+    size_t count = list->length + list->sign;
+
+    // Render every digit into one buffer and write it with a single call
+    char *buffer = (char *)malloc(count + 1);
+    if (buffer == NULL) {
+        if (list->sign) {
+            putchar('-');
+        }
+        for (Node *current = list->head; current != NULL; current = current->next) {
+            putchar('0' + current->data);
+        }
+        putchar('\n');
+        return;
     }
-    printf("\n");
+    size_t pos = 0;
+    if (list->sign) {
+        buffer[pos++] = '-';
+    }
+    for (Node *current = list->head; current != NULL; current = current->next) {
+        buffer[pos++] = (char)('0' + current->data);
+    }
+    buffer[pos++] = '\n';
+    fwrite(buffer, 1, pos, stdout);
+    free(buffer);
 }
 
 // Free allocated memory for the list
@@ -86,8 +198,34 @@ void free_list(DList *list) {
     Node *current = list->head;
     while (current != NULL) {
         Node *next = current->next;
-        free(current);
+        pool_free(&node_pool, current);
         current = next;
     }
-    free(list);
-}
\ No newline at end of file
+    pool_free(&list_pool, list);
+}
+
+// Remove the zero digits in front of the first nonzero one, keeping at least one digit
+void dlist_normalize(DList *list) {
+    while (list->head != NULL && list->head->next != NULL && list->head->data == 0) {
+        Node *zero = list->head;
+        list->head = zero->next;
+        list->head->prev = NULL;
+        list->length--;
+        pool_free(&node_pool, zero);
+    }
+    if (list->head == NULL || (list->head->next == NULL && list->head->data == 0)) {
+        list->sign = 0; // Zero has no sign
+    }
+}
+
+// Recycle every node and list in one shot (all outstanding lists become invalid)
+void dlist_pool_reset() {
+    pool_reset(&node_pool);
+    pool_reset(&list_pool);
+}
+
+// Release the memory held by the pools
+void dlist_pool_release() {
+    pool_release(&node_pool);
+    pool_release(&list_pool);
+}
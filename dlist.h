@@ -11,7 +11,9 @@
  * - Node: Represents an element of the doubly linked list, storing data
  *         and pointers to the previous and next nodes.
  * - DList: Represents the doubly linked list, with pointers to the head
- *          and tail nodes.
+ *          and tail nodes, the number of nodes and the sign of the number
+ *          it holds. Both are kept up to date by the insert functions, so
+ *          the length of a number is known without walking its digits.
  *
  * Function Declarations:
  * - DList* create_empty_list(): Creates and initializes an empty doubly linked list.
@@ -20,6 +22,18 @@
  * - void insert_at_tail(DList **list, Node *new_node): Adds a new node to the end of the list.
  * - void print_list(DList *list): Prints the contents of the list (for debugging purposes).
  * - void free_list(DList *list): Frees the memory allocated for the list and its nodes.
+ * - void dlist_normalize(DList *list): Removes leading zero digits (keeping one) and the sign of zero.
+ * - void dlist_pool_reset(): Recycles every node and list in one shot.
+ * - void dlist_pool_release(): Returns the memory held by the node and list pools.
+ *
+ * Memory:
+ * Nodes and lists come from slab pools. `free_list` makes them available for
+ * reuse, `dlist_pool_reset` recycles everything at once at the end of a
+ * calculation (invalidating any list still held), and `dlist_pool_release`
+ * frees the pools before the program exits. The calculator itself evaluates
+ * on BigNums and creates no lists; the pools are kept for programs that use
+ * the DList functions of `operations.h`, such as `check.c`, which resets them
+ * after each checked operation and releases them at exit.
  *
  * Usage:
  * Include this header file in your implementation to use the doubly linked
@@ -31,6 +45,8 @@
 #ifndef DLIST_H
 #define DLIST_H
 
+#include <stddef.h>
+
 typedef struct Node {
     int data;                // Value stored in the node
     struct Node *prev;      // Pointer to the previous node
@@ -40,6 +56,8 @@ typedef struct Node {
 typedef struct DList {
     Node *head;             // Pointer to the head of the list
     Node *tail;             // Pointer to the tail of the list
+    size_t length;          // Number of nodes in the list
+    int sign;               // 1 if the number is negative
 } DList;
 
 // Function declarations
@@ -49,5 +67,8 @@ void insert_at_head(DList **list, Node *new_node);
 void insert_at_tail(DList **list, Node *new_node);
 void print_list(DList *list); // For debugging
 void free_list(DList *list);   // To free allocated memory
+void dlist_normalize(DList *list);
+void dlist_pool_reset();        // Recycle all nodes and lists at once
+void dlist_pool_release();      // Free the pooled memory
 
 #endif // DLIST_H
@@ -0,0 +1,485 @@
+/*
+ * File: expr.c
+ * Description: Expression trees and their evaluation, e.g. for the line
+ *              "x = (a + 12345) * b % 97".
+ *
+ * The parser in `input.c` builds an Expr by appending nodes to a flat array;
+ * nodes refer to their operands by index and number literals are parsed
+ * straight from the input into BigNums owned by the Expr.
+ *
+ * Nodes are created operands first, so the node array is the line in postfix
+ * order and is evaluated with a loop over a stack of values, however long the
+ * line. A number or variable is pushed where it is, without copying. An
+ * operator pops its operands and writes its result into the temporary BigNum
+ * belonging to its stack position; when the left operand was itself computed
+ * there, additions, subtractions and products by a one-limb number update it
+ * in place. A unary minus only flips the sign of its operand's temporary, and
+ * a minus in front of a number literal costs nothing at all, since the parser
+ * stores the literal negative. A product of many arguments pops them all at
+ * once and hands them to a product tree. The temporaries survive between lines, so steady-state evaluation
+ * reuses the same buffers over and over, and no intermediate value is ever
+ * converted to decimal.
+ *
+ * With a fixed width selected, the same postfix loop runs over a stack of
+ * fixed-width word arrays instead: operands are reduced modulo 2^bits as they
+ * are pushed, every operator overwrites its left operand's entry, and only the
+ * final value is converted back into a BigNum.
+ *
+ * With a result cache selected (see `cache.h`), every operation whose
+ * operands, or estimated result, reach EXPR_CACHE_MIN_LIMBS limbs is first
+ * looked up by its key and stored after it has been computed. Operations
+ * that take linear time (additions, subtractions, products by a one-limb
+ * number, divisions by one with a quotient of at most two limbs) are never
+ * cached, and neither are fixed-width lines.
+ *
+ * Functions:
+ * - void expr_init(Expr *e): Initializes an empty expression.
+ * - void expr_free(Expr *e): Releases an expression.
+ * - void expr_clear(Expr *e): Empties an expression for the next line.
+ * - int expr_add_number(Expr *e, BigNum **literal): Appends a number node.
+ * - int expr_add_variable(Expr *e, const char *name): Appends a variable node.
+ * - int expr_add_operator(Expr *e, char operator, int left, int right): Appends an operator node.
+ * - int expr_add_negate(Expr *e, int operand): Appends a unary minus.
+ * - int expr_add_powmod(Expr *e, int power, int modulus): Fuses a power and a modulus.
+ * - int expr_add_factorial(Expr *e, int operand): Appends a factorial.
+ * - int expr_add_product(Expr *e, int first, size_t count): Appends an n-ary product.
+ * - void expr_env_init(ExprEnv *env): Initializes an environment.
+ * - void expr_env_free(ExprEnv *env): Releases an environment.
+ * - int expr_env_set_width(ExprEnv *env, int bits): Selects fixed-width or BigNum evaluation.
+ * - void expr_env_set_cache(ExprEnv *env, const char *dir): Selects a result cache.
+ * - int expr_evaluate(const Expr *e, ExprEnv *env, const char **error): Evaluates a line.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "expr.h"
+#include "operations.h"
+#include "cache.h"
+
+#define EXPR_CACHE_MIN_LIMBS 2048   // Operand or estimated result size from which results are cached
+
+void expr_init(Expr *e) {
+    memset(e, 0, sizeof(*e));
+}
+
+void expr_free(Expr *e) {
+    for (size_t i = 0; i < e->literal_cap; i++) {
+        bn_free(&e->literals[i]);
+    }
+    free(e->nodes);
+    free(e->literals);
+    free(e->names);
+    expr_init(e);
+}
+
+// Grow an array of `size`-byte elements to hold at least `needed` of them
+static int grow_array(void **array, size_t *cap, size_t needed, size_t size) {
+    if (needed <= *cap) {
+        return 1;
+    }
+    size_t new_cap = (*cap < 8) ? 8 : *cap;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+    void *grown = realloc(*array, new_cap * size);
+    if (grown == NULL) {
+        return 0;
+    }
+    *array = grown;
+    *cap = new_cap;
+    return 1;
+}
+
+// Append a node; returns its index or -1 when out of memory
+static int add_node(Expr *e, char kind, int left, int right, size_t index) {
+    if (e->node_count == e->node_cap &&
+        !grow_array((void **)&e->nodes, &e->node_cap, e->node_count + 1, sizeof(ExprNode))) {
+        return -1;
+    }
+    ExprNode *node = &e->nodes[e->node_count];
+    node->kind = kind;
+    node->left = left;
+    node->right = right;
+    node->index = index;
+
+    // Track the evaluation stack: leaves push a value, operators replace two (or more) by one
+    if (kind == EXPR_NUMBER || kind == EXPR_VARIABLE) {
+        e->depth++;
+    } else if (kind == EXPR_PRODUCT) {
+        e->depth -= index - 1;
+    } else if (kind != EXPR_NEGATE && kind != EXPR_FACTORIAL) {
+        e->depth -= (kind == EXPR_POWMOD) ? 2 : 1;
+    }
+    e->max_depth = (e->depth > e->max_depth) ? e->depth : e->max_depth;
+    return (int)e->node_count++;
+}
+
+// Forget the previous line, keeping all storage
+void expr_clear(Expr *e) {
+    e->node_count = 0;
+    e->literal_count = 0;
+    e->name_count = 0;
+    e->depth = 0;
+    e->max_depth = 0;
+    e->target[0] = '\0';
+    e->uses_variables = 0;
+}
+
+// Add a number node; the caller parses the value into *literal
+int expr_add_number(Expr *e, BigNum **literal) {
+    if (e->literal_count == e->literal_cap) {
+        size_t old_cap = e->literal_cap;
+        if (!grow_array((void **)&e->literals, &e->literal_cap, e->literal_count + 1, sizeof(BigNum))) {
+            return -1;
+        }
+        for (size_t i = old_cap; i < e->literal_cap; i++) {
+            bn_init(&e->literals[i]);
+        }
+    }
+    *literal = &e->literals[e->literal_count];
+    return add_node(e, EXPR_NUMBER, -1, -1, e->literal_count++);
+}
+
+// Add a node reading a variable
+int expr_add_variable(Expr *e, const char *name) {
+    if (!grow_array((void **)&e->names, &e->name_cap, e->name_count + 1, sizeof(e->names[0]))) {
+        return -1;
+    }
+    strcpy(e->names[e->name_count], name);
+    e->uses_variables = 1;
+    return add_node(e, EXPR_VARIABLE, -1, -1, e->name_count++);
+}
+
+// Add an operator node; its operands must already have been added
+int expr_add_operator(Expr *e, char operator, int left, int right) {
+    return add_node(e, operator, left, right, 0);
+}
+
+// Add a unary minus; a number literal is negated where it is
+int expr_add_negate(Expr *e, int operand) {
+    if (e->nodes[operand].kind == EXPR_NUMBER) {
+        bn_negate(&e->literals[e->nodes[operand].index]);
+        return operand;
+    }
+    return add_node(e, EXPR_NEGATE, operand, -1, 0);
+}
+
+// Fuse "power % modulus" into a modular exponentiation; `power` must be a '^' node
+int expr_add_powmod(Expr *e, int power, int modulus) {
+    // The '^' now leaves base and exponent on the stack, one entry deeper than counted so far
+    e->nodes[power].kind = EXPR_HELD;
+    e->depth++;
+    e->max_depth++;
+    return add_node(e, EXPR_POWMOD, power, modulus, 0);
+}
+
+// Add a factorial of a node added earlier
+int expr_add_factorial(Expr *e, int operand) {
+    return add_node(e, EXPR_FACTORIAL, operand, -1, 0);
+}
+
+// Add the product of the last `count` values; `first` is the node of the first one
+int expr_add_product(Expr *e, int first, size_t count) {
+    return add_node(e, EXPR_PRODUCT, first, -1, count);
+}
+
+void expr_env_init(ExprEnv *env) {
+    memset(env, 0, sizeof(*env));
+    bn_init(&env->spare);
+    bn_init(&env->ans);
+}
+
+void expr_env_free(ExprEnv *env) {
+    for (size_t i = 0; i < env->variable_count; i++) {
+        bn_free(&env->variables[i].value);
+    }
+    for (size_t i = 0; i < env->temp_count; i++) {
+        bn_free(&env->temps[i]);
+    }
+    bn_free(&env->spare);
+    bn_free(&env->ans);
+    free(env->variables);
+    free(env->temps);
+    free(env->stack);
+    free(env->fixed_stack);
+    expr_env_init(env);
+}
+
+// Evaluate on `bits`-bit values from now on, or on BigNums for 0
+int expr_env_set_width(ExprEnv *env, int bits) {
+    const BnFixedOps *f = NULL;
+    if (bits != 0 && (f = bn_fixed_ops(bits)) == NULL) {
+        return 0;
+    }
+    env->fixed = f;
+    return 1;
+}
+
+// Look up expensive results in the cache in `dir` from now on, or stop for NULL
+void expr_env_set_cache(ExprEnv *env, const char *dir) {
+    env->cache = dir;
+}
+
+// Value of a variable, or NULL if it has never been assigned
+static const BigNum *lookup_variable(const ExprEnv *env, const char *name) {
+    if (strcmp(name, "ans") == 0) {
+        return &env->ans;
+    }
+    for (size_t i = 0; i < env->variable_count; i++) {
+        if (strcmp(env->variables[i].name, name) == 0) {
+            return &env->variables[i].value;
+        }
+    }
+    return NULL;
+}
+
+// Grow the evaluation stack and its temporaries to `depth` entries
+static int reserve_stack(ExprEnv *env, size_t depth) {
+    size_t old_count = env->temp_count;
+    if (!grow_array((void **)&env->temps, &env->temp_count, depth, sizeof(BigNum))) {
+        return 0;
+    }
+    for (size_t i = old_count; i < env->temp_count; i++) {
+        bn_init(&env->temps[i]);
+    }
+    return grow_array((void **)&env->stack, &env->stack_cap, depth, sizeof(const BigNum *));
+}
+
+// Copy env->ans into the line's target variable, if any
+static int assign_result(const Expr *e, ExprEnv *env, const char **error) {
+    if (e->target[0] != '\0' && strcmp(e->target, "ans") != 0) {
+        ExprVariable *var = NULL;
+        for (size_t i = 0; i < env->variable_count && var == NULL; i++) {
+            if (strcmp(env->variables[i].name, e->target) == 0) {
+                var = &env->variables[i];
+            }
+        }
+        if (var == NULL) {
+            if (!grow_array((void **)&env->variables, &env->variable_cap, env->variable_count + 1,
+                            sizeof(ExprVariable))) {
+                *error = "Error: Out of memory";
+                return 0;
+            }
+            var = &env->variables[env->variable_count++];
+            strcpy(var->name, e->target);
+            bn_init(&var->value);
+        }
+        if (!bn_copy(&var->value, &env->ans)) {
+            *error = "Error: Out of memory";
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Evaluate a parsed line on fixed-width values into env->ans
+static int expr_evaluate_fixed(const Expr *e, ExprEnv *env, const char **error) {
+    const BnFixedOps *f = env->fixed;
+    size_t words = f->words;
+    size_t sp = 0;
+
+    if (!grow_array((void **)&env->fixed_stack, &env->fixed_cap, e->max_depth * words, sizeof(uint64_t))) {
+        *error = "Error: Out of memory";
+        return 0;
+    }
+
+    // Stack entry i is the value in words [i * words, (i + 1) * words)
+    uint64_t *stack = env->fixed_stack;
+    for (size_t i = 0; i < e->node_count; i++) {
+        const ExprNode *node = &e->nodes[i];
+        if (node->kind == EXPR_NUMBER) {
+            bn_fixed_from_bignum(f, &stack[sp++ * words], &e->literals[node->index]);
+        } else if (node->kind == EXPR_VARIABLE) {
+            const BigNum *value = lookup_variable(env, e->names[node->index]);
+            if (value == NULL) {
+                *error = "Error: Undefined variable";
+                return 0;
+            }
+            bn_fixed_from_bignum(f, &stack[sp++ * words], value);
+        } else if (node->kind == EXPR_NEGATE) {
+            bn_fixed_negate(f, &stack[(sp - 1) * words]);
+        } else if (node->kind == EXPR_FACTORIAL) {
+            *error = "Error!!! Unsupported Operation";
+            return 0;
+        } else if (node->kind == EXPR_PRODUCT) {
+            sp -= node->index - 1;
+            uint64_t *product = &stack[(sp - 1) * words];
+            for (size_t k = 1; k < node->index; k++) {
+                f->mul(product, product, &stack[(sp - 1 + k) * words]);
+            }
+        } else if (node->kind == EXPR_HELD) {
+            continue; // Its operands are consumed by the EXPR_POWMOD node
+        } else if (node->kind == EXPR_POWMOD) {
+            sp -= 2;
+            uint64_t *base = &stack[(sp - 1) * words];
+            if (!evaluate_fixed_powmod(f, base, base, &stack[sp * words], &stack[(sp + 1) * words], error)) {
+                return 0;
+            }
+        } else {
+            sp--;
+            uint64_t *left = &stack[(sp - 1) * words];
+            if (!evaluate_fixed(f, node->kind, left, left, &stack[sp * words], error)) {
+                return 0;
+            }
+        }
+    }
+
+    if (!bn_fixed_to_bignum(f, &env->ans, stack)) {
+        *error = "Error: Out of memory";
+        return 0;
+    }
+    return assign_result(e, env, error);
+}
+
+// Approximate number of limbs of |n|, with the fraction of the top limb
+static double approx_limbs(const BigNum *n) {
+    if (n->len == 0) {
+        return 0;
+    }
+    int top_digits = 0;
+    for (limb_t top = n->limbs[n->len - 1]; top > 0; top /= 10) {
+        top_digits++;
+    }
+    return (double)(n->len - 1) + (double)top_digits / BN_BASE_DIGITS;
+}
+
+// Approximate value of |n|
+static double approx_value(const BigNum *n) {
+    double value = 0;
+    for (size_t i = n->len; i-- > 0;) {
+        value = value * BN_BASE + n->limbs[i];
+    }
+    return value;
+}
+
+// Whether an operation can take long enough for the result cache to pay off
+static int worth_caching(char kind, const BigNum *const *operands, size_t count) {
+    size_t a = operands[0]->len;
+    size_t b = (count > 1) ? operands[1]->len : 0;
+    if (kind == '+' || kind == '-' || (kind == '*' && (a <= 1 || b <= 1)) ||
+        ((kind == '/' || kind == '%') && (b <= 1 || a <= b + 1))) {
+        return 0; // Linear time: hashing the operands would cost as much
+    }
+    if (kind == '^' || kind == EXPR_FACTORIAL || kind == EXPR_BINOMIAL) {
+        // Small operands can give a huge result: estimate its size
+        const BigNum *base = operands[0];
+        const BigNum *times = operands[count - 1];
+        return approx_limbs(base) * approx_value(times) >= EXPR_CACHE_MIN_LIMBS;
+    }
+    size_t limbs = 0;
+    for (size_t i = 0; i < count; i++) {
+        limbs += operands[i]->len;
+    }
+    return limbs >= EXPR_CACHE_MIN_LIMBS;
+}
+
+// Compute one operation into dest, through the result cache when one is set and the operation is large
+static int evaluate_node(const ExprEnv *env, char kind, const BigNum *const *operands, size_t count, BigNum *dest,
+                         const char **error) {
+    CacheKey key;
+    int cached = env->cache != NULL && worth_caching(kind, operands, count);
+    int status;
+
+    if (cached) {
+        // The key is taken first, since dest may be one of the operands
+        cache_key(&key, kind, operands, count);
+        if (cache_lookup(env->cache, &key, dest)) {
+            return 1;
+        }
+    }
+    if (kind == EXPR_FACTORIAL) {
+        status = evaluate_factorial(operands[0], dest, error);
+    } else if (kind == EXPR_PRODUCT) {
+        status = evaluate_product(operands, count, dest, error);
+    } else if (kind == EXPR_POWMOD) {
+        status = evaluate_powmod(operands[0], operands[1], operands[2], dest, error);
+    } else {
+        status = evaluate(kind, operands[0], operands[1], dest, error);
+    }
+    if (status && cached) {
+        cache_store(env->cache, &key, dest);
+    }
+    return status;
+}
+
+// Evaluate a parsed line into env->ans and assign it to the target variable, if any
+int expr_evaluate(const Expr *e, ExprEnv *env, const char **error) {
+    size_t sp = 0;
+
+    if (env->fixed != NULL) {
+        return expr_evaluate_fixed(e, env, error);
+    }
+    if (!reserve_stack(env, e->max_depth)) {
+        *error = "Error: Out of memory";
+        return 0;
+    }
+
+    // Nodes are in postfix order: operands always precede their operator
+    for (size_t i = 0; i < e->node_count; i++) {
+        const ExprNode *node = &e->nodes[i];
+        if (node->kind == EXPR_NUMBER) {
+            env->stack[sp++] = &e->literals[node->index];
+        } else if (node->kind == EXPR_VARIABLE) {
+            const BigNum *value = lookup_variable(env, e->names[node->index]);
+            if (value == NULL) {
+                *error = "Error: Undefined variable";
+                return 0;
+            }
+            env->stack[sp++] = value;
+        } else if (node->kind == EXPR_NEGATE) {
+            BigNum *dest = &env->temps[sp - 1];
+            if (env->stack[sp - 1] != dest && !bn_copy(dest, env->stack[sp - 1])) {
+                *error = "Error: Out of memory";
+                return 0;
+            }
+            bn_negate(dest);
+            env->stack[sp - 1] = dest;
+        } else if (node->kind == EXPR_FACTORIAL) {
+            if (!evaluate_node(env, node->kind, &env->stack[sp - 1], 1, &env->temps[sp - 1], error)) {
+                return 0;
+            }
+            env->stack[sp - 1] = &env->temps[sp - 1];
+        } else if (node->kind == EXPR_PRODUCT) {
+            // The arguments are the top entries of the stack; the product replaces them all
+            sp -= node->index - 1;
+            if (!evaluate_node(env, node->kind, &env->stack[sp - 1], node->index, &env->temps[sp - 1], error)) {
+                return 0;
+            }
+            env->stack[sp - 1] = &env->temps[sp - 1];
+        } else if (node->kind == EXPR_HELD) {
+            continue; // Its operands are consumed by the EXPR_POWMOD node
+        } else if (node->kind == EXPR_POWMOD) {
+            // Base, exponent and modulus are the top three entries
+            sp -= 2;
+            if (!evaluate_node(env, node->kind, &env->stack[sp - 1], 3, &env->temps[sp - 1], error)) {
+                return 0;
+            }
+            env->stack[sp - 1] = &env->temps[sp - 1];
+        } else {
+            const BigNum *right = env->stack[--sp];
+            const BigNum *left = env->stack[sp - 1];
+            BigNum *dest = &env->temps[sp - 1];
+            int in_place = node->kind == '+' || node->kind == '-' || (node->kind == '*' && right->len == 1);
+            if (left == dest && !in_place) {
+                // Products and quotients are built in fresh storage; hand them the old buffer
+                bn_swap(dest, &env->spare);
+                left = &env->spare;
+            }
+            const BigNum *operands[2] = { left, right };
+            if (!evaluate_node(env, node->kind, operands, 2, dest, error)) {
+                return 0;
+            }
+            env->stack[sp - 1] = dest;
+        }
+    }
+
+    const BigNum *value = env->stack[0];
+    if (value == &env->temps[0]) {
+        bn_swap(&env->ans, &env->temps[0]);
+    } else if (!bn_copy(&env->ans, value)) {
+        *error = "Error: Out of memory";
+        return 0;
+    }
+    return assign_result(e, env, error);
+}
@@ -0,0 +1,141 @@
+/*
+ * File: expr.h
+ * Description: Header file for expression trees and their evaluator.
+ *
+ * An input line is an arithmetic expression over decimal numbers and variables,
+ * optionally assigned to a variable, e.g. "x = (a + 12345) * b % 97" (the
+ * grammar is given in `input.h`). The usual precedence applies; `^` binds
+ * tightest and associates to the right, the other operators associate to the
+ * left, and a unary minus applies to a whole power (-2^2 = -4). Values are
+ * signed. `ans` names the result of the previous line.
+ *
+ * A line is parsed (by `input_read_expression` in `input.h`) into a tree, an
+ * Expr, whose number literals are parsed straight from the input into BigNums.
+ * Evaluating the tree never converts an intermediate value back to decimal:
+ * every operator writes its result into a temporary BigNum of the ExprEnv, and
+ * both the tree and the temporaries keep their storage from line to line.
+ *
+ * Data Structures:
+ * - ExprNode: One number, variable or operator of a parsed line.
+ * - Expr: A parsed line (tree, literals, variable names, assignment target).
+ * - ExprEnv: Variables, the previous result and the evaluation temporaries.
+ *
+ * Function Declarations:
+ * - void expr_init(Expr *e): Initializes an empty expression.
+ * - void expr_free(Expr *e): Releases an expression.
+ * - void expr_clear(Expr *e): Empties an expression, keeping its storage for the next line.
+ * - int expr_add_number(Expr *e, BigNum **literal):
+ *     Appends a number node and points *literal at the BigNum to parse it into.
+ * - int expr_add_variable(Expr *e, const char *name): Appends a variable node.
+ * - int expr_add_operator(Expr *e, char operator, int left, int right):
+ *     Appends an operator node over two nodes added earlier.
+ * - int expr_add_negate(Expr *e, int operand):
+ *     Appends a unary minus over a node added earlier. A negated number literal
+ *     is folded into the literal instead.
+ * - int expr_add_powmod(Expr *e, int power, int modulus):
+ *     Appends "power % modulus", where `power` is a '^' node, as one modular
+ *     exponentiation, so a^e itself is never computed.
+ * - int expr_add_factorial(Expr *e, int operand): Appends a factorial of a node added earlier.
+ * - int expr_add_product(Expr *e, int first, size_t count):
+ *     Appends the product of the values of the last `count` argument nodes,
+ *     `first` being the node of the first one; it is evaluated by a product
+ *     tree (see `bn_prod.c`) rather than as count - 1 multiplications.
+ *   The expr_add_* functions return the index of the new node, or -1 when out
+ *   of memory.
+ * - void expr_env_init(ExprEnv *env): Initializes an environment with no variables.
+ * - void expr_env_free(ExprEnv *env): Releases an environment.
+ * - int expr_env_set_width(ExprEnv *env, int bits):
+ *     Makes later lines evaluate on `bits`-bit unsigned values that wrap around
+ *     (see `bn_fixed.h`), or on BigNums again for 0. Literals and variables are
+ *     reduced modulo 2^bits as they are read, and results are stored back as
+ *     BigNums. Returns 0 if no kernels exist for that width.
+ * - void expr_env_set_cache(ExprEnv *env, const char *dir):
+ *     Makes later lines look up and store the results of large operations in
+ *     the cache directory `dir` (see `cache.h`), which must outlive the
+ *     environment, or stops using a cache for NULL.
+ * - int expr_evaluate(const Expr *e, ExprEnv *env, const char **error):
+ *     Evaluates a parsed line into `env->ans` and performs its assignment.
+ *     Returns 0 with a static message in `error` on failure, leaving `ans`
+ *     and the variables unchanged.
+*/
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdint.h>
+#include "bignum.h"
+#include "bn_fixed.h"
+#include "operations.h"
+
+#define EXPR_NAME_MAX 31        // Longest variable name
+
+// Kinds of node besides the operator characters
+#define EXPR_NUMBER 'n'
+#define EXPR_VARIABLE 'v'
+#define EXPR_NEGATE 'u'           // Unary minus
+#define EXPR_POWMOD 'p'           // a ^ e % m as one operation over three operands
+#define EXPR_HELD 'h'             // A '^' fused into the EXPR_POWMOD node after it
+#define EXPR_GCD OP_GCD           // gcd(a, b), evaluated like a binary operator
+#define EXPR_MODINV OP_MODINV     // modinv(a, m), evaluated like a binary operator
+#define EXPR_BINOMIAL OP_BINOMIAL // binomial(n, k), evaluated like a binary operator
+#define EXPR_FACTORIAL '!'        // n!
+#define EXPR_PRODUCT OP_PRODUCT   // product(a, b, ...) over `index` arguments
+
+typedef struct ExprNode {
+    char kind;              // One of the EXPR_ kinds above or an operator character
+    int left, right;        // Operand nodes of an operator (left only for EXPR_NEGATE and EXPR_FACTORIAL,
+                            // the first argument for EXPR_PRODUCT)
+    size_t index;           // Literal of a number, name of a variable, arguments of EXPR_PRODUCT
+} ExprNode;
+
+typedef struct Expr {
+    ExprNode *nodes;
+    size_t node_count, node_cap;
+    BigNum *literals;       // Parsed numbers; storage is kept for the next line
+    size_t literal_count, literal_cap;
+    char (*names)[EXPR_NAME_MAX + 1];
+    size_t name_count, name_cap;
+    size_t depth;           // Values on the evaluation stack after the last node
+    size_t max_depth;       // Evaluation stack entries the line needs
+    char target[EXPR_NAME_MAX + 1];     // Variable assigned by the line, or ""
+    int uses_variables;     // 1 if the line reads or assigns a variable
+} Expr;
+
+typedef struct ExprVariable {
+    char name[EXPR_NAME_MAX + 1];
+    BigNum value;
+} ExprVariable;
+
+typedef struct ExprEnv {
+    ExprVariable *variables;
+    size_t variable_count, variable_cap;
+    const BigNum **stack;   // Evaluation stack of operand values
+    size_t stack_cap;
+    BigNum *temps;          // temps[i] holds an operator's result at stack position i
+    size_t temp_count;
+    BigNum spare;           // Scratch for operators that cannot work in place
+    BigNum ans;             // Result of the last successful line
+    const BnFixedOps *fixed;    // Fixed-width kernels, or NULL to evaluate on BigNums
+    uint64_t *fixed_stack;      // Evaluation stack of fixed-width values, `fixed->words` words per entry
+    size_t fixed_cap;           // Words allocated in fixed_stack
+    const char *cache;          // Directory of the result cache, or NULL
+} ExprEnv;
+
+// Function declarations
+void expr_init(Expr *e);
+void expr_free(Expr *e);
+void expr_clear(Expr *e);
+int expr_add_number(Expr *e, BigNum **literal);
+int expr_add_variable(Expr *e, const char *name);
+int expr_add_operator(Expr *e, char operator, int left, int right);
+int expr_add_negate(Expr *e, int operand);
+int expr_add_powmod(Expr *e, int power, int modulus);
+int expr_add_factorial(Expr *e, int operand);
+int expr_add_product(Expr *e, int first, size_t count);
+void expr_env_init(ExprEnv *env);
+void expr_env_free(ExprEnv *env);
+int expr_env_set_width(ExprEnv *env, int bits);
+void expr_env_set_cache(ExprEnv *env, const char *dir);
+int expr_evaluate(const Expr *e, ExprEnv *env, const char **error);
+
+#endif // EXPR_H
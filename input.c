@@ -0,0 +1,379 @@
+/*
+ * File: input.c
+ * Description: Streaming reader and recursive-descent parser for expressions.
+ *
+ * Operands are parsed straight from the input chunks into BigNums with the
+ * incremental parser in `bn_io.c`, so there is no limit on their length and no
+ * intermediate copy of the digits is ever made. Streams are read one line piece
+ * at a time through a fixed-size buffer (a line longer than the buffer simply
+ * arrives in several pieces). Regular files given with `--file` are
+ * memory-mapped and parsed in place; if mapping fails they are streamed instead.
+ *
+ * Each line is parsed by recursive descent, one function per precedence level,
+ * into an Expr (see `expr.h`). A name followed by '(' calls one of the
+ * functions in `input_functions`, whose arguments are full expressions, and a
+ * postfix '!' takes the factorial of the factor before it. Nodes are appended
+ * operands first, so the tree comes out in postfix order. Parentheses, unary minus and chains of the
+ * right-associative `^` may nest INPUT_MAX_NESTING deep, which bounds the
+ * recursion; chains of the other operators are parsed iteratively and may be
+ * of any length. A power directly followed by `% m` is fused into one modular
+ * exponentiation.
+ *
+ * Functions:
+ * - void input_open_stream(InputSource *src, FILE *fp): Reads from a stdio stream.
+ * - int input_open_file(InputSource *src, const char *path): Opens a file for reading.
+ * - void input_open_memory(InputSource *src, const char *data, size_t len): Reads from memory.
+ * - void input_close(InputSource *src): Releases the buffer, mapping or file.
+ * - int input_read_expression(InputSource *src, Expr *e):
+ *     Parses one expression line (1 = ok, 0 = malformed line skipped, -1 = end of input).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+
+#define INPUT_CHUNK_SIZE 65536  // Size of the stream buffer
+#define INPUT_MAX_NESTING 256   // Deepest nesting of parentheses
+
+// Read from an already open stream
+void input_open_stream(InputSource *src, FILE *fp) {
+    memset(src, 0, sizeof(*src));
+    src->fp = fp;
+}
+
+// Map a file into memory, or stream it when it cannot be mapped (e.g. a pipe)
+int input_open_file(InputSource *src, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    memset(src, 0, sizeof(*src));
+    if (fd < 0) {
+        printf("Error: Cannot open '%s'\n", path);
+        return 0;
+    }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            src->map = map;
+            src->map_len = (size_t)st.st_size;
+            src->data = (const char *)map;
+            src->len = src->map_len;
+            return 1;
+        }
+    }
+
+    FILE *fp = fdopen(fd, "r");
+    if (fp == NULL) {
+        close(fd);
+        printf("Error: Cannot read '%s'\n", path);
+        return 0;
+    }
+    src->fp = fp;
+    src->owns_fp = 1;
+    return 1;
+}
+
+// Read from memory owned by the caller (e.g. one line of a mapped file)
+void input_open_memory(InputSource *src, const char *data, size_t len) {
+    memset(src, 0, sizeof(*src));
+    src->data = data;
+    src->len = len;
+}
+
+// Release everything held by the source
+void input_close(InputSource *src) {
+    if (src->map != NULL) {
+        munmap(src->map, src->map_len);
+    }
+    if (src->owns_fp) {
+        fclose(src->fp);
+    }
+    free(src->buffer);
+    memset(src, 0, sizeof(*src));
+}
+
+// Make sure unread input is available; returns 0 at the end of the input
+static int input_fill(InputSource *src) {
+    if (src->pos < src->len) {
+        return 1;
+    }
+    if (src->fp == NULL) {
+        return 0;
+    }
+    if (src->buffer == NULL) {
+        src->buffer = (char *)malloc(INPUT_CHUNK_SIZE);
+        if (src->buffer == NULL) {
+            return 0;
+        }
+    }
+    // fgets stops at a newline, so interactive input is returned as soon as a line is typed
+    if (fgets(src->buffer, INPUT_CHUNK_SIZE, src->fp) == NULL) {
+        return 0;
+    }
+    src->data = src->buffer;
+    src->len = strlen(src->buffer);
+    src->pos = 0;
+    return src->len > 0;
+}
+
+// Next character without consuming it, or EOF
+static int input_peek(InputSource *src) {
+    return input_fill(src) ? (unsigned char)src->data[src->pos] : EOF;
+}
+
+// Skip spaces, tabs and carriage returns
+static void input_skip_blanks(InputSource *src) {
+    int c;
+    while ((c = input_peek(src)) == ' ' || c == '\t' || c == '\r') {
+        src->pos++;
+    }
+}
+
+// Discard the rest of the current line, including its newline
+static void input_skip_line(InputSource *src) {
+    while (input_fill(src)) {
+        const char *newline = memchr(src->data + src->pos, '\n', src->len - src->pos);
+        if (newline != NULL) {
+            src->pos = (size_t)(newline - src->data) + 1;
+            return;
+        }
+        src->pos = src->len;
+    }
+}
+
+// Parse a run of digits into n, feeding the parser one chunk at a time, and skip the blanks after it
+static int input_read_number(InputSource *src, BigNum *n) {
+    BnParser parser;
+
+    bn_parse_begin(&parser, n);
+    while (input_fill(src)) {
+        const char *start = src->data + src->pos;
+        const char *end = src->data + src->len;
+        const char *p = start;
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (p > start && !bn_parse_chunk(&parser, start, (size_t)(p - start))) {
+            return 0;
+        }
+        src->pos += (size_t)(p - start);
+        if (p < end) {
+            break; // Stopped at a non-digit
+        }
+    }
+    if (parser.digits == 0 || !bn_parse_end(&parser)) {
+        return 0;
+    }
+    input_skip_blanks(src);
+    return 1;
+}
+
+static int is_name_start(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int is_name_char(int c) {
+    return is_name_start(c) || (c >= '0' && c <= '9');
+}
+
+// Read a variable name into buf; returns 0 if it is too long
+static int input_read_name(InputSource *src, char buf[EXPR_NAME_MAX + 1]) {
+    size_t len = 0;
+    int c;
+    while (is_name_char(c = input_peek(src))) {
+        if (len == EXPR_NAME_MAX) {
+            return 0;
+        }
+        buf[len++] = (char)c;
+        src->pos++;
+    }
+    buf[len] = '\0';
+    input_skip_blanks(src);
+    return 1;
+}
+
+static int parse_expr(InputSource *src, Expr *e, int depth, int first);
+
+// Functions that can be called in expressions and the node kind they evaluate as. A function of
+// two arguments is evaluated like a binary operator; `product` takes any number from one up.
+static const struct {
+    const char *name;
+    char kind;
+    int arity;              // Number of arguments, or 0 for one or more
+} input_functions[] = {
+    { "gcd", EXPR_GCD, 2 },
+    { "modinv", EXPR_MODINV, 2 },
+    { "binomial", EXPR_BINOMIAL, 2 },
+    { "product", EXPR_PRODUCT, 0 },
+};
+
+// call := name '(' expr (',' expr)* ')', with the name already read
+static int parse_call(InputSource *src, Expr *e, int depth, char kind, int arity) {
+    int first = -1, last = -1;
+    size_t count = 0;
+    int c;
+
+    do {
+        src->pos++; // '(' or ','
+        last = parse_expr(src, e, depth, -1);
+        if (last < 0) {
+            return -1;
+        }
+        first = (count++ == 0) ? last : first;
+    } while ((c = input_peek(src)) == ',');
+    if (c != ')' || (arity > 0 && count != (size_t)arity)) {
+        return -1;
+    }
+    src->pos++;
+    input_skip_blanks(src);
+    return (arity == 0) ? expr_add_product(e, first, count) : expr_add_operator(e, kind, first, last);
+}
+
+// A name just read: a function call if '(' follows, otherwise a variable
+static int parse_name(InputSource *src, Expr *e, int depth, const char *name) {
+    if (input_peek(src) != '(') {
+        return expr_add_variable(e, name);
+    }
+    for (size_t i = 0; i < sizeof(input_functions) / sizeof(input_functions[0]); i++) {
+        if (strcmp(name, input_functions[i].name) == 0) {
+            return (depth < INPUT_MAX_NESTING) ? parse_call(src, e, depth + 1, input_functions[i].kind, input_functions[i].arity) : -1;
+        }
+    }
+    return -1; // Unknown function
+}
+
+// factor := number | name | call | '(' expr ')'; returns the node or -1
+static int parse_factor(InputSource *src, Expr *e, int depth) {
+    int c;
+
+    input_skip_blanks(src);
+    c = input_peek(src);
+    if (c >= '0' && c <= '9') {
+        BigNum *literal;
+        int node = expr_add_number(e, &literal);
+        return (node >= 0 && input_read_number(src, literal)) ? node : -1;
+    }
+    if (is_name_start(c)) {
+        char name[EXPR_NAME_MAX + 1];
+        return input_read_name(src, name) ? parse_name(src, e, depth, name) : -1;
+    }
+    if (c == '(' && depth < INPUT_MAX_NESTING) {
+        src->pos++;
+        int inner = parse_expr(src, e, depth + 1, -1);
+        if (inner < 0 || input_peek(src) != ')') {
+            return -1;
+        }
+        src->pos++;
+        input_skip_blanks(src);
+        return inner;
+    }
+    return -1;
+}
+
+static int parse_unary(InputSource *src, Expr *e, int depth, int first);
+
+// power := factor '!'* ['^' unary]; right-associative, so each '^' counts as a nesting level
+static int parse_power(InputSource *src, Expr *e, int depth, int first) {
+    int base = (first >= 0) ? first : parse_factor(src, e, depth);
+
+    while (base >= 0 && input_peek(src) == '!') {
+        src->pos++;
+        input_skip_blanks(src);
+        base = expr_add_factorial(e, base);
+    }
+    if (base < 0 || input_peek(src) != '^') {
+        return base;
+    }
+    src->pos++;
+    int exponent = (depth < INPUT_MAX_NESTING) ? parse_unary(src, e, depth + 1, -1) : -1;
+    return (exponent < 0) ? -1 : expr_add_operator(e, '^', base, exponent);
+}
+
+// unary := '-' unary | power; the minus applies to the whole power, so -2^2 = -4
+static int parse_unary(InputSource *src, Expr *e, int depth, int first) {
+    if (first < 0) {
+        input_skip_blanks(src);
+        if (input_peek(src) == '-') {
+            src->pos++;
+            int operand = (depth < INPUT_MAX_NESTING) ? parse_unary(src, e, depth + 1, -1) : -1;
+            return (operand < 0) ? -1 : expr_add_negate(e, operand);
+        }
+    }
+    return parse_power(src, e, depth, first);
+}
+
+// term := unary (('*' | '/' | '%') unary)*; `first` is an already parsed factor or -1
+static int parse_term(InputSource *src, Expr *e, int depth, int first) {
+    int left = parse_unary(src, e, depth, first);
+    int c;
+
+    while (left >= 0 && ((c = input_peek(src)) == '*' || c == '/' || c == '%')) {
+        src->pos++;
+        int right = parse_unary(src, e, depth, -1);
+        if (right < 0) {
+            left = -1;
+        } else if (c == '%' && e->nodes[left].kind == '^') {
+            left = expr_add_powmod(e, left, right); // a ^ e % m never forms a^e
+        } else {
+            left = expr_add_operator(e, (char)c, left, right);
+        }
+    }
+    return left;
+}
+
+// expr := term (('+' | '-') term)*
+static int parse_expr(InputSource *src, Expr *e, int depth, int first) {
+    int left = parse_term(src, e, depth, first);
+    int c;
+
+    while (left >= 0 && ((c = input_peek(src)) == '+' || c == '-')) {
+        src->pos++;
+        int right = parse_term(src, e, depth, -1);
+        left = (right < 0) ? -1 : expr_add_operator(e, (char)c, left, right);
+    }
+    return left;
+}
+
+// Read one expression line such as "x = (a + 12345) * b % 97"
+int input_read_expression(InputSource *src, Expr *e) {
+    int first = -1;
+
+    if (!input_fill(src)) {
+        return -1;
+    }
+    expr_clear(e);
+
+    // A leading name is either the assignment target or the first operand
+    input_skip_blanks(src);
+    if (is_name_start(input_peek(src))) {
+        char name[EXPR_NAME_MAX + 1];
+        if (!input_read_name(src, name)) {
+            input_skip_line(src);
+            return 0;
+        }
+        if (input_peek(src) == '=') {
+            src->pos++;
+            strcpy(e->target, name);
+            e->uses_variables = 1;
+        } else if ((first = parse_name(src, e, 0, name)) < 0) {
+            input_skip_line(src);
+            return 0;
+        }
+    }
+
+    int root = parse_expr(src, e, 0, first);
+    int c = input_peek(src);
+    if (root < 0 || (c != '\n' && c != EOF)) {
+        input_skip_line(src); // Malformed, or trailing garbage after the expression
+        return 0;
+    }
+    input_skip_line(src);
+    return 1;
+}
@@ -0,0 +1,67 @@
+/*
+ * File: input.h
+ * Description: Header file for the streaming expression reader and parser.
+ *
+ * An InputSource hands out the bytes of an input in chunks, either from a stdio
+ * stream (read through a fixed-size buffer, so a line of any length can be
+ * consumed without being copied as a whole) or from a memory-mapped file. The
+ * expression reader parses operands straight out of those chunks into BigNums
+ * and builds the expression tree described in `expr.h`:
+ *
+ *     line    := [name '='] expr
+ *     expr    := term (('+' | '-') term)*
+ *     term    := unary (('*' | '/' | '%') unary)*
+ *     unary   := '-' unary | power
+ *     power   := factor '!'* ['^' unary]
+ *     factor  := number | name | call | '(' expr ')'
+ *     call    := ('gcd' | 'modinv' | 'binomial') '(' expr ',' expr ')'
+ *              | 'product' '(' expr (',' expr)* ')'
+ *
+ * `^` is right-associative (2^3^2 = 2^9) and binds tighter than unary minus
+ * (-2^2 = -4), and `a ^ e % m` is computed as a modular exponentiation without
+ * forming a^e. `gcd(a, b)` is the greatest common divisor and `modinv(a, m)`
+ * the inverse of a modulo m. `n!` is a factorial and binds tightest
+ * (2^3! = 2^6, -3! = -6), `binomial(n, k)` is n choose k and
+ * `product(a, b, ...)` multiplies all of its arguments.
+ *
+ * Data Structures:
+ * - InputSource: Current chunk of input plus the stream or mapping it comes from.
+ *
+ * Function Declarations:
+ * - void input_open_stream(InputSource *src, FILE *fp): Reads from a stdio stream.
+ * - int input_open_file(InputSource *src, const char *path):
+ *     Memory-maps a file, falling back to streaming it when it cannot be mapped.
+ * - void input_open_memory(InputSource *src, const char *data, size_t len):
+ *     Reads from a block of memory that stays owned by the caller.
+ * - void input_close(InputSource *src): Releases the buffer, mapping or file.
+ * - int input_read_expression(InputSource *src, Expr *e):
+ *     Parses one expression line into e. Returns 1 on success, 0 for a
+ *     malformed line (which is skipped) and -1 at the end of the input.
+*/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include "bignum.h"
+#include "expr.h"
+
+typedef struct InputSource {
+    FILE *fp;               // Stream being read, NULL for mapped input
+    int owns_fp;            // 1 if the stream was opened by input_open_file
+    char *buffer;           // Chunk buffer for streamed input
+    const char *data;       // Current chunk
+    size_t len;             // Bytes in the current chunk
+    size_t pos;             // Read position inside the current chunk
+    void *map;              // Start of the memory mapping, if any
+    size_t map_len;         // Length of the memory mapping
+} InputSource;
+
+// Function declarations
+void input_open_stream(InputSource *src, FILE *fp);
+int input_open_file(InputSource *src, const char *path);
+void input_open_memory(InputSource *src, const char *data, size_t len);
+void input_close(InputSource *src);
+int input_read_expression(InputSource *src, Expr *e);
+
+#endif // INPUT_H
@@ -1,128 +1,328 @@
 /*
  * File: main.c
- * Description: Arbitrary precision arithmetic application that performs basic
- *              arithmetic operations (+, -, *, /, %) on two large numbers represented
- *              using doubly linked lists.
+ * Description: Arbitrary precision arithmetic application that evaluates
+ *              arithmetic expressions (+, -, *, /, %, ^) over signed large numbers.
  *
  * Features:
- * - Accepts large numbers and an operator as input (e.g., 123456789+987654321).
- * - Uses doubly linked lists to represent numbers for efficient manipulation.
+ * - Accepts expressions over large numbers as input (e.g., 123456789+987654321
+ *   or "x = (a + 1) * b % 97"), with the usual precedence, parentheses and
+ *   variables assigned on earlier lines; `ans` is the previous result.
+ *   Intermediate results stay in binary form (see `expr.c`).
+ * - Operands may be of any length: input is streamed and parsed directly into
+ *   the BigNum limb representation (see `input.c`).
  * - Supports the following operations:
  *   - Addition (+)
- *   - Subtraction (-)
+ *   - Subtraction (-), which may give a negative result
+ *   - Negation (unary -)
  *   - Multiplication (*)
- *   - Division (/)
- *   - Modulus (%)
+ *   - Division (/), truncated toward zero
+ *   - Modulus (%), with the sign of the dividend
+ *   - Exponentiation (^)
  * - Handles user input validation and provides feedback for incorrect formats.
  * - Allows the user to perform multiple calculations in a single session.
+ * - With `--file PATH`, evaluates every line of a file (memory-mapped when
+ *   possible) and prints one result per line.
+ * - With `--batch PATH`, evaluates the lines of a file in parallel on a pool of
+ *   worker threads, printing the results in input order.
+ * - With `--serve PATH`, runs as a server answering expressions sent over a
+ *   Unix domain socket until interrupted (see `serve.h`).
+ * - `--threads N` sets the number of threads used by batch mode and by very
+ *   large multiplications (default one per CPU).
+ * - `--width N` evaluates on N-bit unsigned integers that wrap around (N is
+ *   256, 512, 1024 or 4096) instead of unbounded signed numbers.
+ * - `--out-format binary` writes the results of file and batch mode as binary
+ *   records (see `bignum.h`) instead of decimal lines, and `--in-format
+ *   binary` makes file mode read such records (memory-mapped, used in place)
+ *   instead of expressions, so large values move between jobs without a
+ *   decimal round trip.
+ * - `--cache DIR` keeps the results of large operations in DIR and reuses
+ *   them in later lines and runs (see `cache.h`).
+ * - In builds made with `make STATS=1`, `--stats` prints the time, sizes,
+ *   allocations and algorithm tiers of every operation plus a summary at exit,
+ *   and `--stats-json PATH` writes the summary as JSON.
  * - Frees all dynamically allocated memory to prevent memory leaks.
  *
  * Functions:
- * - void handle_operation(char operator, DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
- *     Dispatches the appropriate arithmetic operation based on the given operator.
- * - int main():
+ * - int handle_expression(const Expr *e, ExprEnv *env):
+ *     Evaluates a parsed line into `env->ans`, printing any error.
+ *     Returns 1 on success and 0 on failure (e.g., division by zero).
+ * - int write_result(const BigNum *n, int binary):
+ *     Writes a result to standard output as a decimal line or a binary record.
+ * - int run_records(InputSource *src, int binary_out):
+ *     Copies the binary records of an input to the output, validating them.
+ * - int run_file(const char *path, int width, const char *cache, int binary_in, int binary_out):
+ *     Evaluates every expression in a file, or converts its records with
+ *     `binary_in`. Returns 1 if all lines succeeded.
+ * - int report_stats(int print, const char *json_path):
+ *     Prints the operation statistics and/or writes them as JSON (STATS=1 builds).
+ * - int main(int argc, char *argv[]):
  *     Handles user input, processes operations, displays results, and manages program flow.
  *
  * Usage:
- * - Compile the program with its dependencies (`dlist.h` and `operations.h`).
- * - Run the executable and enter input in the specified format (e.g., "12345+67890").
- * - Follow prompts to continue or exit the application.
+ * - Compile the program with `make`.
+ * - Run `./apc` and enter input in the specified format (e.g., "12345+67890"),
+ *   then follow prompts to continue or exit the application.
+ * - Run `./apc --file expressions.txt` to evaluate a file of expressions.
+ * - Run `./apc --batch expressions.txt [--threads N]` to evaluate it in parallel.
+ * - Run `./apc --serve /tmp/apc.sock` to serve clients until Ctrl-C.
+ * - Any mode accepts `--threads N`, `--width N` and `--cache DIR`.
+ * - Run `./apc --file big.txt --out-format binary > big.apcn` to save results
+ *   as binary records and `./apc --file big.apcn --in-format binary` to print them.
  *
  * Dependencies:
- * - dlist.h: Provides definitions and functions for managing doubly linked lists.
- * - operations.h: Contains implementations of arithmetic operations for large numbers.
+ * - bignum.h: Contiguous big-number representation and arithmetic.
+ * - input.h: Streaming input tokenizer.
+ * - expr.h: Expression parser and evaluator.
+ * - batch.h: Parallel batch mode.
+ * - serve.h: Server mode.
+ * - bn_fixed.h: Fixed-width integers for `--width`.
+ * - stats.h: Optional operation statistics.
+ * - cache.h: On-disk result cache.
 */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "dlist.h"
-#include "operations.h"
-
-// Updated handle_operation to accept Node pointers directly
-void handle_operation(char operator, DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
-    switch (operator) {
-        case '+':
-            addition(&head1, tail1, &head2, tail2, headR);
-            break;
-        case '-':
-            subtraction(head1, tail1, head2, tail2, headR);
-            break;
-        case '*':
-            multiplication(head1, tail1, head2, tail2, headR);
-            break;
-        case '/':
-            division(head1, tail1, head2, tail2, headR);
-            break;
-        case '%':
-            modulus(head1, tail1, head2, tail2, headR);
-            break;
-        default:
-            printf("Error!!! Unsupported Operation '%c'\n", operator);
-            break;
+#include "bignum.h"
+#include "input.h"
+#include "expr.h"
+#include "batch.h"
+#include "serve.h"
+#include "bn_fixed.h"
+#include "stats.h"
+#include "cache.h"
+
+// Evaluate a parsed line, storing the result in env->ans
+int handle_expression(const Expr *e, ExprEnv *env) {
+    const char *error;
+    if (!expr_evaluate(e, env, &error)) {
+        printf("%s\n", error);
+        return 0;
     }
+    return 1;
 }
 
-int main() {
-    char input[256];
-    char continue_choice;
+// Write a result to standard output as a decimal line or a binary record
+int write_result(const BigNum *n, int binary) {
+    if (binary) {
+        return bn_write_binary(stdout, n);
+    }
+    int ok = bn_print(stdout, n);
+    putchar('\n');
+    return ok;
+}
 
-    do {
-        printf("Enter Your Input (e.g., 123456789012345+67890): ");
-        fgets(input, sizeof(input), stdin);
-        
-        // Remove newline character from input
-        input[strcspn(input, "\n")] = 0;
-
-        // Check for operator presence and split input
-        char *operator_pos = strpbrk(input, "+-*/%");
-        if (operator_pos == NULL) {
-            printf("Invalid Input Format.... Please Try Again.\n");
-            continue;
+// Copy every binary record of an input to the output; mapped records are used in place
+int run_records(InputSource *src, int binary_out) {
+    BigNum value;
+    int status = 1;
+    int all_ok = 1;
+
+    bn_init(&value);
+    if (src->map != NULL) {
+        size_t used;
+        for (size_t pos = 0; pos < src->len; pos += used) {
+            if (!bn_binary_view(&value, src->data + pos, src->len - pos, &used)) {
+                status = 0;
+                break;
+            }
+            all_ok = write_result(&value, binary_out) && all_ok;
         }
+        bn_init(&value); // The view's limbs belong to the mapping
+    } else {
+        while ((status = bn_read_binary(&value, src->fp)) > 0) {
+            all_ok = write_result(&value, binary_out) && all_ok;
+        }
+    }
+    if (status == 0) {
+        // Records have no separators, so nothing after a malformed one can be read
+        fprintf(binary_out ? stderr : stdout, "Error: Malformed binary record\n");
+        all_ok = 0;
+    }
+    bn_free(&value);
+    return all_ok;
+}
 
-        char operator = *operator_pos; // Get the operator
-        *operator_pos = '\0'; // Null terminate the first part to isolate the first number
-        char *first_number = input; // The first number is before the operator
-        char *second_number = operator_pos + 1; // The second number is after the operator
+// Evaluate every line of a file, writing one result per line
+int run_file(const char *path, int width, const char *cache, int binary_in, int binary_out) {
+    InputSource src;
+    Expr expr;
+    ExprEnv env;
+    const char *error;
+    int status;
+    int all_ok = 1;
 
-        // Check if both numbers are provided
-        if (*first_number == '\0' || *second_number == '\0') {
-            printf("Invalid Input Format.... Please Try Again.\n");
-            continue;
+    if (!input_open_file(&src, path)) {
+        return 0;
+    }
+    if (binary_in) {
+        all_ok = run_records(&src, binary_out);
+        input_close(&src);
+        return all_ok;
+    }
+    expr_init(&expr);
+    expr_env_init(&env);
+    expr_env_set_width(&env, width);
+    expr_env_set_cache(&env, cache);
+
+    // Binary output holds only records, so messages go to standard error
+    FILE *messages = binary_out ? stderr : stdout;
+    while ((status = input_read_expression(&src, &expr)) >= 0) {
+        if (status == 0) {
+            fprintf(messages, "Invalid Input Format.\n");
+            all_ok = 0;
+        } else if (expr_evaluate(&expr, &env, &error)) {
+            all_ok = write_result(&env.ans, binary_out) && all_ok;
+        } else {
+            fprintf(messages, "%s\n", error);
+            all_ok = 0;
         }
+    }
 
-        // Create doubly linked lists for both numbers
-        DList *head1 = create_empty_list();
-        DList *head2 = create_empty_list();
-        DList *headR = NULL;
+    expr_free(&expr);
+    expr_env_free(&env);
+    input_close(&src);
+    return all_ok;
+}
 
-        // Convert string numbers to doubly linked lists
-        for (int i = 0; first_number[i] != '\0'; i++) {
-            insert_at_tail(&head1, create_node(first_number[i] - '0')); // Convert char to int
-        }
-        for (int i = 0; second_number[i] != '\0'; i++) {
-            insert_at_tail(&head2, create_node(second_number[i] - '0')); // Convert char to int
+// Print and/or save the operation statistics collected so far
+int report_stats(int print, const char *json_path) {
+#ifdef APC_STATS
+    if (print) {
+        fflush(stdout);
+        stats_report(stderr);
+    }
+    if (json_path != NULL) {
+        return stats_write_json(json_path);
+    }
+#else
+    (void)print;
+    (void)json_path;
+#endif
+    return 1;
+}
+
+// Format named on the command line: 0 for text, 1 for binary, -1 if unknown
+static int parse_format(const char *name) {
+    return (strcmp(name, "text") == 0) ? 0 : (strcmp(name, "binary") == 0) ? 1 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    InputSource src;
+    Expr expr;
+    ExprEnv env;
+    char continue_choice = 'N';
+
+    const char *file_path = NULL;
+    const char *batch_path = NULL;
+    const char *serve_path = NULL;
+    const char *cache_dir = NULL;
+    int binary_in = 0;
+    int binary_out = 0;
+    int threads = 0;
+    int width = 0;
+    int stats = 0;
+    const char *stats_json = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            file_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--in-format") == 0 && i + 1 < argc && parse_format(argv[i + 1]) >= 0) {
+            binary_in = parse_format(argv[++i]);
+        } else if (strcmp(argv[i], "--out-format") == 0 && i + 1 < argc && parse_format(argv[i + 1]) >= 0) {
+            binary_out = parse_format(argv[++i]);
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            width = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+        } else if (strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+            stats_json = argv[++i];
+        } else {
+            printf("Usage: %s [--file PATH | --batch PATH | --serve PATH] [--threads N] [--width N]\n"
+                   "       [--in-format text|binary] [--out-format text|binary] [--cache DIR] [--stats] [--stats-json PATH]\n", argv[0]);
+            return EXIT_FAILURE;
         }
+    }
+    if (width != 0 && bn_fixed_ops(width) == NULL) {
+        printf("Error: Unsupported width; use 256, 512, 1024 or 4096\n");
+        return EXIT_FAILURE;
+    }
+    if (binary_in && file_path == NULL) {
+        printf("Error: --in-format binary needs --file\n");
+        return EXIT_FAILURE;
+    }
+    if (binary_out && file_path == NULL && batch_path == NULL) {
+        printf("Error: --out-format binary needs --file or --batch\n");
+        return EXIT_FAILURE;
+    }
+    if (cache_dir != NULL && !cache_open(cache_dir)) {
+        return EXIT_FAILURE;
+    }
+#ifdef APC_STATS
+    if (stats) {
+        stats_set_trace(stderr);
+    }
+#else
+    if (stats || stats_json != NULL) {
+        printf("Error: Statistics are not compiled in; rebuild with 'make clean && make STATS=1'\n");
+        return EXIT_FAILURE;
+    }
+#endif
 
-        // Perform the operation
-        handle_operation(operator, head1, head1->tail, head2, head2->tail, &headR);
+    // Threads that very large multiplications are split across
+    bn_set_threads(threads);
+    if (batch_path != NULL || file_path != NULL || serve_path != NULL) {
+        int ok = (serve_path != NULL) ? run_server(serve_path, threads, width, cache_dir) :
+                 (batch_path != NULL) ? run_batch(batch_path, threads, width, cache_dir, binary_out, stdout) :
+                 run_file(file_path, width, cache_dir, binary_in, binary_out);
+        bn_set_threads(1);
+        ok = report_stats(stats, stats_json) && ok;
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        // Display result
-        printf("Result: ");
-        print_list(headR); // Assuming print_list prints the content of the list
-        printf("\n");
+    input_open_stream(&src, stdin);
+    expr_init(&expr);
+    expr_env_init(&env);
+    expr_env_set_width(&env, width);
+    expr_env_set_cache(&env, cache_dir);
 
-        // Free memory for the lists
-        free_list(head1);
-        free_list(head2);
-        free_list(headR);
+    do {
+        printf("Enter Your Input (e.g., 123456789012345+67890): ");
+        fflush(stdout);
+
+        int status = input_read_expression(&src, &expr);
+        if (status < 0) {
+            printf("\n");
+            break; // End of input
+        }
+        if (status == 0) {
+            printf("Invalid Input Format.... Please Try Again.\n");
+            continue_choice = 'Y';
+            continue;
+        }
+
+        // Evaluate the expression and display the result if it succeeded
+        if (handle_expression(&expr, &env)) {
+            printf("Result: ");
+            bn_print(stdout, &env.ans);
+            printf("\n");
+        }
 
         // Ask user to continue with validation
         do {
             printf("Want To Continue? Press [Y / N]: ");
-            scanf(" %c", &continue_choice); // The space before %c ignores any whitespace
+            if (scanf(" %c", &continue_choice) != 1) {
+                continue_choice = 'N'; // End of input
+                break;
+            }
             getchar(); // To consume the newline character left in the input buffer
 
             if (continue_choice != 'Y' && continue_choice != 'y' &&
@@ -134,6 +334,11 @@ int main() {
 
     } while (continue_choice == 'Y' || continue_choice == 'y');
 
+    expr_free(&expr);
+    expr_env_free(&env);
+    input_close(&src);
+    bn_set_threads(1);
+    report_stats(stats, stats_json);
     printf("Application Terminated.\n");
     return 0;
 }
@@ -5,27 +5,50 @@
  *              division, and modulus. The code also includes utility functions for
  *              comparing and manipulating doubly linked lists.
  *
+ *              The doubly linked lists act as the interface only: each operation packs
+ *              its operands into contiguous base 10^9 limb arrays (see `bignum.h`), runs
+ *              the arithmetic on those arrays and unpacks the result into `headR`.
+ *
+ *              `evaluate` first tries operands of at most four limbs (below 10^36) in
+ *              128-bit machine integers. Overflow is detected rather than prevented:
+ *              a product, power or modular power that does not fit falls through to
+ *              the BigNum algorithms, so the fast path never changes a result.
+ *
  * Features:
  * - Addition:
  *   Calculates the sum of two large numbers and stores the result in a doubly linked list.
  *
  * - Subtraction:
- *   Performs subtraction of two large numbers. Assumes the first number is greater than
- *   or equal to the second number.
+ *   Performs subtraction of two large numbers. The result may be negative.
  *
  * - Multiplication:
- *   Multiplies two large numbers using digit-wise multiplication and accumulation,
+ *   Multiplies two large numbers using limb-wise multiplication and accumulation,
  *   storing the result in a doubly linked list.
  *
  * - Division:
- *   Divides two large numbers using repeated subtraction and produces the quotient.
+ *   Divides two large numbers using limb-wise long division (Knuth's Algorithm D)
+ *   and produces the quotient, truncated toward zero.
  *   Handles division by zero with appropriate error messages.
  *
  * - Modulus:
- *   Computes the remainder of the division of two large numbers using repeated subtraction.
+ *   Computes the remainder of the division of two large numbers using long division.
+ *   The remainder has the sign of the dividend, as in C.
+ *
+ * - Divmod:
+ *   Computes both quotient and remainder from one long division pass.
+ *
+ * - GCD and modular inverse:
+ *   Greatest common divisor (with or without Bezout cofactors) and modular
+ *   inverse by Lehmer's algorithm, switching to half-GCD for large numbers
+ *   (see `bn_gcd.c`).
+ *
+ * - Products, factorials and binomials:
+ *   Products of many numbers, n! and binomial coefficients by balanced product
+ *   trees, optionally in parallel (see `bn_prod.c`).
  *
  * - Comparison:
- *   Compares two doubly linked lists representing numbers and returns:
+ *   Compares two doubly linked lists representing numbers, using their signs and
+ *   lengths first so only numbers of the same sign and length are walked, and returns:
  *     1  -> If the first number is greater.
  *     -1 -> If the second number is greater.
  *     0  -> If both numbers are equal.
@@ -48,8 +71,57 @@
  *     Calculates the modulus (remainder) of the first number divided by the second
  *     and stores the result in `headR`. Returns 0 for modulus by zero.
  *
+ * - int divmod(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headQ, DList **headRem):
+ *     Computes quotient and remainder with a single long division pass. Either
+ *     output may be NULL. `division` and `modulus` are built on top of it.
+ *
+ * - int gcd(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
+ *     Stores the (non-negative) greatest common divisor in `headR`.
+ *
+ * - int gcdext(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headG, DList **headX, DList **headY):
+ *     Stores the greatest common divisor g and cofactors x and y with
+ *     g = x * first + y * second.
+ *
+ * - int modular_inverse(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
+ *     Stores the inverse of the first number modulo the second, in [0, |second|).
+ *     Returns 0 when it does not exist.
+ *
+ * - int product_of(DList **heads, Node **tails, size_t count, DList **headR):
+ *     Stores the product of `count` numbers in `headR`.
+ *
+ * - int factorial(DList *head, Node *tail, DList **headR):
+ *     Stores n! in `headR`. Returns 0 for a negative or too large n.
+ *
+ * - int binomial(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
+ *     Stores "first choose second" in `headR`. Returns 0 for a negative first
+ *     number or a result too large to compute.
+ *
  * - int compare_dlists(DList *lst1, DList *lst2):
  *     Compares two doubly linked lists and returns the comparison result as described above.
+ *     Leading zeros are skipped without modifying either list.
+ *
+ * - int evaluate(char operator, const BigNum *a, const BigNum *b, BigNum *r, const char **error):
+ *     Applies an operator to two BigNums. Nothing is printed, so several threads
+ *     may evaluate independent expressions at once; failures are returned as a
+ *     static message in `error`. Each call is recorded by the `--stats`
+ *     instrumentation when it is compiled in (see `stats.h`).
+ *
+ * - int evaluate_powmod(const BigNum *a, const BigNum *e, const BigNum *m, BigNum *r, const char **error):
+ *     Computes r = a^e mod m without ever forming a^e (see `bn_pow.c`).
+ *
+ * - int evaluate_factorial(const BigNum *n, BigNum *r, const char **error):
+ *     Computes r = n!.
+ *
+ * - int evaluate_product(const BigNum *const *factors, size_t count, BigNum *r, const char **error):
+ *     Computes the product of `count` (at least one) numbers.
+ *
+ * - int evaluate_fixed(const BnFixedOps *f, char operator, uint64_t *r, const uint64_t *a, const uint64_t *b, const char **error):
+ *     Applies an operator to two fixed-width values (see `bn_fixed.h`); the
+ *     result wraps modulo 2^bits. Fixed-width operations are not recorded by
+ *     the statistics.
+ *
+ * - int evaluate_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m, const char **error):
+ *     Computes r = a^e mod m on fixed-width values.
  *
  * Usage:
  * - Include this file as part of a larger program for arbitrary precision arithmetic.
@@ -57,195 +129,599 @@
  *
  * Dependencies:
  * - Requires `dlist.h` for doubly linked list definitions and utilities.
+ * - Requires `bignum.h` for the limb-array arithmetic kernels.
 */
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include "operations.h"
+#include "bignum.h"
+#include "bn_fixed.h"
+#include "stats.h"
+
+#define POWER_MAX_LIMBS 4294967296.0    // Largest a^e computed (2^32 limbs, about 38.6 billion digits)
+#define NATIVE_MAX_LIMBS 4              // Operands below 10^36 are computed in 128-bit integers
+#define NATIVE_RESULT_LIMBS 5           // Limbs needed for any 128-bit value (2^128 < 10^45)
+#define NATIVE_MAX_MODULUS_LIMBS 2      // Moduli below 10^18 < 2^64 keep products of residues in 128 bits
+#define NATIVE_MAX_FACTORIAL 34         // 34! < 2^128
+
+typedef unsigned __int128 u128;
+
+// Pack both operands into limb arrays
+static int load_operands(DList *head1, Node *tail1, DList *head2, Node *tail2, BigNum *a, BigNum *b) {
+    bn_init(a);
+    bn_init(b);
+    return bn_from_dlist(a, head1, tail1) && bn_from_dlist(b, head2, tail2);
+}
+
+// Release the limb arrays used by an operation
+static void release_operands(BigNum *a, BigNum *b, BigNum *r) {
+    bn_free(a);
+    bn_free(b);
+    bn_free(r);
+}
 
 // Function to add two large numbers represented as doubly linked lists
 int addition(DList **head1, Node *tail1, DList **head2, Node *tail2, DList **headR) {
-    Node *ptr1 = tail1;
-    Node *ptr2 = tail2;
-    int carry = 0;
-
-    while (ptr1 != NULL || ptr2 != NULL || carry) {
-        int sum = carry;
-        if (ptr1 != NULL) {
-            sum += ptr1->data;
-            ptr1 = ptr1->prev;
-        }
-        if (ptr2 != NULL) {
-            sum += ptr2->data;
-            ptr2 = ptr2->prev;
-        }
-        carry = sum / 10;
-        Node *newNode = create_node(sum % 10);
-        insert_at_head(headR, newNode);
-    }
-    return 1; // Indicate success
+    BigNum a, b, r;
+    bn_init(&r);
+
+    int status = load_operands(*head1, tail1, *head2, tail2, &a, &b) &&
+                 bn_add(&r, &a, &b) &&
+                 bn_to_dlist(&r, headR);
+
+    release_operands(&a, &b, &r);
+    return status;
 }
 
 // Function to subtract two large numbers represented as doubly linked lists
 int subtraction(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
-    Node *ptr1 = tail1;
-    Node *ptr2 = tail2;
-    int borrow = 0;
-
-    while (ptr1 != NULL) {
-        int diff = ptr1->data - borrow;
-        if (ptr2 != NULL) {
-            diff -= ptr2->data;
-            ptr2 = ptr2->prev;
-        }
-        if (diff < 0) {
-            diff += 10;
-            borrow = 1;
-        } else {
-            borrow = 0;
-        }
-        Node *newNode = create_node(diff);
-        insert_at_head(headR, newNode);
-        ptr1 = ptr1->prev;
-    }
-    return 1; // Indicate success
+    BigNum a, b, r;
+    bn_init(&r);
+
+    int status = load_operands(head1, tail1, head2, tail2, &a, &b) &&
+                 bn_sub(&r, &a, &b) &&
+                 bn_to_dlist(&r, headR);
+
+    release_operands(&a, &b, &r);
+    return status;
 }
 
 // Function to multiply two large numbers represented as doubly linked lists
 int multiplication(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
-    DList *tempResult = create_empty_list();
-    Node *ptr1 = tail1;
-    int position = 0;
+    BigNum a, b, r;
+    bn_init(&r);
 
-    while (ptr1 != NULL) {
-        DList *partialResult = create_empty_list();
-        Node *ptr2 = tail2;
-        int carry = 0;
+    int status = load_operands(head1, tail1, head2, tail2, &a, &b) &&
+                 bn_mul(&r, &a, &b) &&
+                 bn_to_dlist(&r, headR);
 
-        for (int i = 0; i < position; i++) {
-            insert_at_tail(&partialResult, create_node(0));  // Pass a pointer to the partialResult
-        }
+    release_operands(&a, &b, &r);
+    return status;
+}
 
-        while (ptr2 != NULL) {
-            int product = ptr1->data * ptr2->data + carry;
-            carry = product / 10;
-            insert_at_tail(&partialResult, create_node(product % 10));  // Pass a pointer to the partialResult
-            ptr2 = ptr2->prev;
-        }
-        if (carry) {
-            insert_at_tail(&partialResult, create_node(carry));  // Pass a pointer to the partialResult
-        }
-        addition(&tempResult, tempResult->tail, &partialResult, partialResult->tail, &tempResult);  // No change needed here
-        ptr1 = ptr1->prev;
-        position++;
+// First nonzero digit of a list (NULL for zero), storing the number of digits from it on in `length`
+static Node *significant_digits(const DList *list, size_t *length) {
+    Node *p = list->head;
+    size_t len = list->length;
+    while (p != NULL && p->data == 0) {
+        p = p->next;
+        len--;
     }
-
-    *headR = tempResult;
-    return 1; // Indicate success
+    *length = len;
+    return p;
 }
 
-// Function to compare two doubly linked lists
+// Function to compare two doubly linked lists; leading zeros are skipped, not removed
 int compare_dlists(DList *lst1, DList *lst2) {
-    Node *ptr1 = lst1->tail;
-    Node *ptr2 = lst2->tail;
+    size_t len1, len2;
+    Node *p1 = significant_digits(lst1, &len1);
+    Node *p2 = significant_digits(lst2, &len2);
+    int neg1 = lst1->sign && p1 != NULL; // Zero has no sign
+    int neg2 = lst2->sign && p2 != NULL;
+
+    if (neg1 != neg2) {
+        return neg1 ? -1 : 1;
+    }
+    int direction = neg1 ? -1 : 1; // Larger magnitudes are smaller negative numbers
 
-    while (ptr1 != NULL && ptr2 != NULL) {
-        if (ptr1->data != ptr2->data) {
-            return (ptr1->data > ptr2->data) ? 1 : -1;
+    // Without leading zeros, the longer number has the larger magnitude
+    if (len1 != len2) {
+        return (len1 > len2) ? direction : -direction;
+    }
+    for (; p1 != NULL; p1 = p1->next, p2 = p2->next) {
+        if (p1->data != p2->data) {
+            return (p1->data > p2->data) ? direction : -direction;
         }
-        ptr1 = ptr1->prev;
-        ptr2 = ptr2->prev;
     }
-
-    if (ptr1 != NULL) return 1; // lst1 is longer
-    if (ptr2 != NULL) return -1; // lst2 is longer
-    return 0; // They are equal
+    return 0;
 }
 
-// Function to divide two large numbers represented as doubly linked lists
-int division(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
+// Function to divide two large numbers, producing quotient and remainder in one pass
+int divmod(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headQ, DList **headRem) {
+    BigNum a, b, q, r;
+    bn_init(&q);
+    bn_init(&r);
+
+    int status = load_operands(head1, tail1, head2, tail2, &a, &b);
+
     // Check for division by zero
-    if (head2->head == NULL || (head2->head->data == 0 && head2->head->next == NULL)) {
-        printf("Error: Division by zero\n");
-        return 0; // Indicate failure
-    }
-
-    DList *tempDividend = create_empty_list();
-    Node *ptr1 = tail1; // Pointer to the dividend
-    Node *ptr2 = tail2; // Pointer to the divisor
-    DList *quotient = create_empty_list(); // Resultant quotient
-
-    // Copy the dividend into tempDividend
-    while (ptr1 != NULL) {
-        Node *newNode = create_node(ptr1->data);
-        insert_at_tail(&tempDividend, newNode);
-        ptr1 = ptr1->prev;
-    }
-
-    // Perform the division
-    while (compare_dlists(tempDividend, head2) >= 0) {
-        DList *tempSubtractionResult = create_empty_list();
-        Node *tempPtr1 = tempDividend->tail; // Pointer to the current dividend
-
-        // Subtract the divisor from the current dividend
-        int borrow = 0;
-        while (tempPtr1 != NULL) {
-            int sub = (tempPtr1->data - (ptr2 ? ptr2->data : 0) - borrow);
-            if (sub < 0) {
-                sub += 10;
-                borrow = 1;
-            } else {
-                borrow = 0;
-            }
-            insert_at_head(&tempSubtractionResult, create_node(sub));
-            tempPtr1 = tempPtr1->prev;
-            if (ptr2) ptr2 = ptr2->prev; // Move to the next digit of the divisor
+    if (status && b.len == 0) {
+        printf((headQ != NULL) ? "Error: Division by zero\n" : "Error: Modulus by zero.\n");
+        status = 0; // Indicate failure
+    }
+    status = status &&
+             bn_divmod((headQ != NULL) ? &q : NULL, (headRem != NULL) ? &r : NULL, &a, &b) &&
+             (headQ == NULL || bn_to_dlist(&q, headQ)) &&
+             (headRem == NULL || bn_to_dlist(&r, headRem));
+
+    release_operands(&a, &b, &q);
+    bn_free(&r);
+    return status;
+}
+
+// Greatest common divisor of two large numbers represented as doubly linked lists
+int gcd(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
+    BigNum a, b, r;
+    bn_init(&r);
+
+    int status = load_operands(head1, tail1, head2, tail2, &a, &b) &&
+                 bn_gcd(&r, &a, &b) &&
+                 bn_to_dlist(&r, headR);
+
+    release_operands(&a, &b, &r);
+    return status;
+}
+
+// Greatest common divisor and Bezout cofactors (headG = headX * first + headY * second)
+int gcdext(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headG, DList **headX, DList **headY) {
+    BigNum a, b, g, x, y;
+    bn_init(&g);
+    bn_init(&x);
+    bn_init(&y);
+
+    int status = load_operands(head1, tail1, head2, tail2, &a, &b) &&
+                 bn_gcdext(&g, &x, &y, &a, &b) &&
+                 bn_to_dlist(&g, headG) &&
+                 bn_to_dlist(&x, headX) &&
+                 bn_to_dlist(&y, headY);
+
+    release_operands(&a, &b, &g);
+    bn_free(&x);
+    bn_free(&y);
+    return status;
+}
+
+// Inverse of the first number modulo the second
+int modular_inverse(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
+    BigNum a, m, r;
+    bn_init(&r);
+
+    int status = load_operands(head1, tail1, head2, tail2, &a, &m);
+    if (status) {
+        status = bn_modinv(&r, &a, &m);
+        if (status < 0) {
+            printf("Error: No modular inverse\n");
+            status = 0;
         }
+    }
+    status = status && bn_to_dlist(&r, headR);
 
-        // Set tempDividend to the result of the subtraction
-        free_list(tempDividend);
-        tempDividend = tempSubtractionResult;
+    release_operands(&a, &m, &r);
+    return status;
+}
+
+// Product of `count` large numbers represented as doubly linked lists, by a balanced product tree
+int product_of(DList **heads, Node **tails, size_t count, DList **headR) {
+    BigNum *numbers = malloc(count * sizeof(BigNum));
+    const BigNum **factors = malloc(count * sizeof(BigNum *));
+    BigNum r;
+    size_t loaded = 0;
+    bn_init(&r);
+
+    int status = count == 0 || (numbers != NULL && factors != NULL);
+    for (; status && loaded < count; loaded++) {
+        bn_init(&numbers[loaded]);
+        factors[loaded] = &numbers[loaded];
+        status = bn_from_dlist(&numbers[loaded], heads[loaded], tails[loaded]);
+    }
+    status = status &&
+             bn_product(&r, factors, count) &&
+             bn_to_dlist(&r, headR);
 
-        // Increment the quotient by 1 for each successful subtraction
-        insert_at_tail(&quotient, create_node(1)); // Increment the quotient
+    for (size_t i = 0; i < loaded; i++) {
+        bn_free(&numbers[i]);
     }
+    free(numbers);
+    free(factors);
+    bn_free(&r);
+    return status;
+}
 
-    // Set headR to the resultant quotient
-    *headR = quotient;
+// Factorial of a large number represented as a doubly linked list
+int factorial(DList *head, Node *tail, DList **headR) {
+    BigNum n, r;
+    const char *error = NULL;
+    bn_init(&n);
+    bn_init(&r);
+
+    int status = bn_from_dlist(&n, head, tail);
+    if (status && !evaluate_factorial(&n, &r, &error)) {
+        printf("%s\n", error);
+        status = 0;
+    }
+    status = status && bn_to_dlist(&r, headR);
 
-    // Free memory for tempDividend
-    free_list(tempDividend);
-    
-    return 1; // Indicate success
+    bn_free(&n);
+    bn_free(&r);
+    return status;
 }
 
+// Binomial coefficient "first choose second"
+int binomial(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
+    BigNum n, k, r;
+    const char *error = NULL;
+    bn_init(&r);
+
+    int status = load_operands(head1, tail1, head2, tail2, &n, &k);
+    if (status && !evaluate(OP_BINOMIAL, &n, &k, &r, &error)) {
+        printf("%s\n", error);
+        status = 0;
+    }
+    status = status && bn_to_dlist(&r, headR);
+
+    release_operands(&n, &k, &r);
+    return status;
+}
 
+// Function to divide two large numbers represented as doubly linked lists
+int division(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
+    return divmod(head1, tail1, head2, tail2, headR, NULL);
+}
 
 // Function to calculate modulus of two large numbers represented as doubly linked lists
 int modulus(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR) {
-    if (head2->head == NULL || (head2->head->data == 0 && tail2 == head2->head)) {
-        printf("Error: Modulus by zero.\n");
-        return 0; // Failure
+    return divmod(head1, tail1, head2, tail2, NULL, headR);
+}
+
+// Refuse a^e when the result would exceed POWER_MAX_LIMBS; only bases above 1 grow
+static int power_too_large(const BigNum *a, const BigNum *e) {
+    if (a->len == 0 || (a->len == 1 && a->limbs[0] == 1)) {
+        return 0;
+    }
+    // Upper bound on limbs per factor of a: whole limbs plus the top limb's share
+    int top_digits = 0;
+    for (limb_t top = a->limbs[a->len - 1]; top > 0; top /= 10) {
+        top_digits++;
     }
+    double limbs = (double)(a->len - 1) + (double)top_digits / BN_BASE_DIGITS;
+    double exponent = 0;
+    for (size_t i = e->len; i-- > 0;) {
+        exponent = exponent * BN_BASE + e->limbs[i];
+    }
+    return limbs * exponent > POWER_MAX_LIMBS;
+}
 
-    DList *tempDividend = create_empty_list();
-    Node *ptr1 = head1->head; // Pointer to the dividend
+// Refuse binomial(n, k) when its bound n^min(k, n - k) would exceed POWER_MAX_LIMBS
+static int binomial_too_large(const BigNum *n, const BigNum *k) {
+    if (k->neg || bn_compare(k, n) > 0 || !power_too_large(n, k)) {
+        return 0;
+    }
+    // k itself is too large an exponent, but n - k may be small
+    BigNum rest;
+    bn_init(&rest);
+    int too_large = !bn_sub(&rest, n, k) || power_too_large(n, &rest);
+    bn_free(&rest);
+    return too_large;
+}
+
+// Magnitude of a number of at most NATIVE_MAX_LIMBS limbs
+static u128 native_load(const BigNum *n) {
+    u128 v = 0;
+    for (size_t i = n->len; i-- > 0;) {
+        v = v * BN_BASE + n->limbs[i];
+    }
+    return v;
+}
+
+// r = v with the given sign, in r's own storage (so no allocation once r has grown)
+static int native_store(BigNum *r, u128 v, int neg) {
+    if (!bn_reserve(r, NATIVE_RESULT_LIMBS)) {
+        return 0;
+    }
+    size_t len = 0;
+    while (v >> 64) {
+        r->limbs[len++] = (limb_t)(v % BN_BASE);
+        v /= BN_BASE;
+    }
+    for (uint64_t low = (uint64_t)v; low > 0; low /= BN_BASE) {
+        r->limbs[len++] = (limb_t)(low % BN_BASE);
+    }
+    r->len = len;
+    r->neg = neg && len > 0;
+    return 1;
+}
+
+// Index of the highest set bit of v, or -1 for zero
+static int native_top_bit(u128 v) {
+    uint64_t high = (uint64_t)(v >> 64);
+    if (high != 0) {
+        return 127 - __builtin_clzll(high);
+    }
+    return ((uint64_t)v != 0) ? 63 - __builtin_clzll((uint64_t)v) : -1;
+}
 
-    while (ptr1 != NULL) {
-        // Bring down the next digit
-        insert_at_tail(&tempDividend, create_node(ptr1->data));
+// x / y and x % y, with 64-bit division when both fit
+static void native_divmod(u128 x, u128 y, u128 *q, u128 *rem) {
+    if (((x | y) >> 64) == 0) {
+        *q = (uint64_t)x / (uint64_t)y;
+        *rem = (uint64_t)x % (uint64_t)y;
+    } else {
+        *q = x / y;
+        *rem = x % y;
+    }
+}
 
-        // Perform the subtraction until tempDividend < head2
-        while (compare_dlists(tempDividend, head2) >= 0) {
-            subtraction(tempDividend, tempDividend->tail, head2, tail2, &tempDividend); // tempDividend -= head2
+/*
+ * r = a <operator> b in 128-bit arithmetic, for operands of at most
+ * NATIVE_MAX_LIMBS limbs. Returns 0 without touching r when the result could
+ * overflow or the operation needs an error message; the caller then takes the
+ * BigNum path, which handles both.
+ */
+static int native_operator(char operator, const BigNum *a, const BigNum *b, BigNum *r) {
+    u128 x = native_load(a), y = native_load(b), v, rem;
+    int neg;
+
+    switch (operator) {
+        case '+':
+        case '-': {
+            int yneg = (operator == '-') ? !b->neg : b->neg;
+            if (a->neg == yneg) {
+                v = x + y;          // Below 2 * 10^36, far from overflowing
+                neg = yneg;
+            } else {
+                v = (x >= y) ? x - y : y - x;
+                neg = (x >= y) ? a->neg : yneg;
+            }
+            break;
         }
+        case '*':
+            if (__builtin_mul_overflow(x, y, &v)) {
+                return 0;
+            }
+            neg = a->neg != b->neg;
+            break;
+        case '/':
+        case '%':
+            if (y == 0) {
+                return 0;
+            }
+            native_divmod(x, y, &v, &rem);
+            neg = (operator == '/') ? a->neg != b->neg : a->neg;
+            v = (operator == '/') ? v : rem;
+            break;
+        case '^':
+            if (b->neg) {
+                return 0;
+            }
+            // Square and multiply from the top bit; any overflow hands over to bn_pow
+            v = 1;
+            for (int bit = native_top_bit(y); bit >= 0; bit--) {
+                if (__builtin_mul_overflow(v, v, &v)) {
+                    return 0;
+                }
+                if (((y >> bit) & 1) && __builtin_mul_overflow(v, x, &v)) {
+                    return 0;
+                }
+            }
+            neg = a->neg && (y & 1);
+            break;
+        default:
+            return 0;
+    }
+    STATS_TIER(STATS_NATIVE);
+    return native_store(r, v, neg);
+}
 
-        ptr1 = ptr1->next; // Move to the next digit in the dividend
+// r = a^e mod m in 128-bit arithmetic for a modulus below 10^18; returns 0 when not applicable
+static int native_powmod(const BigNum *a, const BigNum *e, const BigNum *m, BigNum *r) {
+    if (a->len > NATIVE_MAX_LIMBS || e->len > NATIVE_MAX_LIMBS || m->len > NATIVE_MAX_MODULUS_LIMBS) {
+        return 0;
+    }
+    u128 modulus = native_load(m);
+    u128 base = native_load(a) % modulus;
+    u128 exponent = native_load(e);
+    u128 v = 1 % modulus;
+
+    // Residues are below 2^64, so their products fit in 128 bits
+    for (; exponent > 0; exponent >>= 1) {
+        if (exponent & 1) {
+            v = v * base % modulus;
+        }
+        base = base * base % modulus;
     }
+    STATS_TIER(STATS_NATIVE);
+    return native_store(r, v, a->neg && e->len > 0 && (e->limbs[0] & 1));
+}
 
-    // Assign the remainder to the result
-    *headR = tempDividend; // The remainder is the final tempDividend
-    return 1; // Indicate success
+// Apply an operator to two BigNums; the statistics wrapper is evaluate() below
+static int apply_operator(char operator, const BigNum *a, const BigNum *b, BigNum *r, const char **error) {
+    int status;
+
+    // Small operands never leave machine integers
+    if (a->len <= NATIVE_MAX_LIMBS && b->len <= NATIVE_MAX_LIMBS && native_operator(operator, a, b, r)) {
+        return 1;
+    }
+
+    switch (operator) {
+        case '+':
+            status = bn_add(r, a, b);
+            break;
+        case '-':
+            status = bn_sub(r, a, b);
+            break;
+        case '*':
+            status = bn_mul(r, a, b);
+            break;
+        case '^':
+            if (b->neg) {
+                *error = "Error: Negative exponent";
+                return 0;
+            }
+            if (power_too_large(a, b)) {
+                *error = "Error: Result too large";
+                return 0;
+            }
+            status = bn_pow(r, a, b);
+            break;
+        case '/':
+        case '%':
+            if (b->len == 0) {
+                *error = (operator == '/') ? "Error: Division by zero" : "Error: Modulus by zero.";
+                return 0;
+            }
+            status = (operator == '/') ? bn_divmod(r, NULL, a, b) : bn_divmod(NULL, r, a, b);
+            break;
+        case OP_GCD:
+            status = bn_gcd(r, a, b);
+            break;
+        case OP_MODINV:
+            if (b->len == 0) {
+                *error = "Error: Modulus by zero.";
+                return 0;
+            }
+            status = bn_modinv(r, a, b);
+            if (status < 0) {
+                *error = "Error: No modular inverse";
+                return 0;
+            }
+            break;
+        case OP_BINOMIAL:
+            if (a->neg) {
+                *error = "Error: Binomial of a negative number";
+                return 0;
+            }
+            if (binomial_too_large(a, b)) {
+                *error = "Error: Result too large";
+                return 0;
+            }
+            status = bn_binomial(r, a, b);
+            break;
+        default:
+            *error = "Error!!! Unsupported Operation";
+            return 0;
+    }
+    if (!status) {
+        *error = "Error: Out of memory";
+    }
+    return status;
+}
+
+// Apply an operator to two BigNums, describing any failure in *error
+int evaluate(char operator, const BigNum *a, const BigNum *b, BigNum *r, const char **error) {
+    STATS_BEGIN(operator, a, b);
+    int status = apply_operator(operator, a, b, r, error);
+    STATS_END(r, status);
+    return status;
+}
+
+// r = a^e mod m, the fused form of "a ^ e % m"; recorded as '^' by the statistics
+int evaluate_powmod(const BigNum *a, const BigNum *e, const BigNum *m, BigNum *r, const char **error) {
+    if (m->len == 0) {
+        *error = "Error: Modulus by zero.";
+        return 0;
+    }
+    if (e->neg) {
+        *error = "Error: Negative exponent";
+        return 0;
+    }
+    STATS_BEGIN('^', a, e);
+    int status = native_powmod(a, e, m, r) || bn_powmod(r, a, e, m);
+    STATS_END(r, status);
+    if (!status) {
+        *error = "Error: Out of memory";
+    }
+    return status;
 }
 
+// r = n!; small ones are computed in 128 bits
+int evaluate_factorial(const BigNum *n, BigNum *r, const char **error) {
+    if (n->neg) {
+        *error = "Error: Factorial of a negative number";
+        return 0;
+    }
+    if (power_too_large(n, n)) { // n! < n^n, which also keeps n within two limbs
+        *error = "Error: Result too large";
+        return 0;
+    }
+    uint64_t value = (uint64_t)native_load(n);
+    int status;
+
+    STATS_BEGIN('!', n, &(const BigNum){ 0 });
+    if (value <= NATIVE_MAX_FACTORIAL) {
+        u128 v = 1;
+        for (uint64_t i = 2; i <= value; i++) {
+            v *= i;
+        }
+        STATS_TIER(STATS_NATIVE);
+        status = native_store(r, v, 0);
+    } else {
+        status = bn_factorial(r, value);
+    }
+    STATS_END(r, status);
+    if (!status) {
+        *error = "Error: Out of memory";
+    }
+    return status;
+}
+
+// r = factors[0] * ... * factors[count - 1] by a product tree; recorded with the first factor
+int evaluate_product(const BigNum *const *factors, size_t count, BigNum *r, const char **error) {
+    STATS_BEGIN(OP_PRODUCT, factors[0], &(const BigNum){ 0 });
+    int status = bn_product(r, factors, count);
+    STATS_END(r, status);
+    if (!status) {
+        *error = "Error: Out of memory";
+    }
+    return status;
+}
+
+// Apply an operator to two fixed-width values, wrapping modulo 2^bits
+int evaluate_fixed(const BnFixedOps *f, char operator, uint64_t *r, const uint64_t *a, const uint64_t *b,
+                   const char **error) {
+    switch (operator) {
+        case '+':
+            f->add(r, a, b);
+            return 1;
+        case '-':
+            f->sub(r, a, b);
+            return 1;
+        case '*':
+            f->mul(r, a, b);
+            return 1;
+        case '^':
+            bn_fixed_pow(f, r, a, b);
+            return 1;
+        case '/':
+        case '%':
+            if (!bn_fixed_divmod(f, (operator == '/') ? r : NULL, (operator == '%') ? r : NULL, a, b)) {
+                *error = (operator == '/') ? "Error: Division by zero" : "Error: Modulus by zero.";
+                return 0;
+            }
+            return 1;
+        default:
+            *error = "Error!!! Unsupported Operation";
+            return 0;
+    }
+}
+
+// r = a^e mod m on fixed-width values, the fused form of "a ^ e % m"
+int evaluate_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m,
+                          const char **error) {
+    if (!bn_fixed_powmod(f, r, a, e, m)) {
+        *error = "Error: Modulus by zero.";
+        return 0;
+    }
+    return 1;
+}
@@ -8,21 +8,45 @@
  *   Adds two large numbers and stores the result in a doubly linked list.
  *
  * - Subtraction:
- *   Subtracts the second large number from the first and stores the result.
+ *   Subtracts the second large number from the first and stores the result,
+ *   which may be negative.
  *
  * - Multiplication:
  *   Multiplies two large numbers and stores the product in a doubly linked list.
  *
  * - Division:
- *   Divides the first large number by the second and stores the quotient.
- *   Includes error handling for division by zero.
+ *   Divides the first large number by the second and stores the quotient,
+ *   truncated toward zero. Includes error handling for division by zero.
  *
  * - Modulus:
  *   Computes the remainder of the division of two large numbers and stores the result.
- *   Includes error handling for modulus by zero.
+ *   The remainder has the sign of the dividend. Includes error handling for modulus by zero.
+ *
+ * - Divmod:
+ *   Computes quotient and remainder together from a single long division pass.
+ *   Either result may be omitted by passing NULL.
+ *
+ * - Evaluation:
+ *   Applies one of the operators +, -, *, /, % or ^, or the functions gcd, modinv
+ *   and binomial, to two BigNums, reporting failures as a message instead of
+ *   printing them, so it can be used from worker threads.
+ *   `a ^ e % m` is evaluated as one modular exponentiation; factorials and
+ *   products of many numbers have their own entry points.
+ *
+ * - Fixed-width evaluation:
+ *   The same operators on 256- to 4096-bit unsigned values that wrap around.
+ *
+ * - GCD and modular inverse:
+ *   Computes greatest common divisors, optionally with Bezout cofactors, and
+ *   modular inverses, in a small multiple of the time of a multiplication.
+ *
+ * - Products, factorials and binomials:
+ *   Multiplies many numbers, or the integers of a range, with a balanced
+ *   product tree instead of one running product.
  *
  * - Comparison:
- *   Compares two large numbers represented as doubly linked lists and returns:
+ *   Compares two large numbers represented as doubly linked lists (in O(1) when their
+ *   signs or lengths differ) and returns:
  *     1  -> If the first number is greater.
  *     -1 -> If the second number is greater.
  *     0  -> If both numbers are equal.
@@ -43,8 +67,49 @@
  * - int modulus(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
  *     Performs modulus operation of two large numbers.
  *
+ * - int divmod(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headQ, DList **headRem):
+ *     Performs division and modulus of two large numbers in one pass.
+ *
+ * - int gcd(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
+ *     Computes the greatest common divisor of two large numbers.
+ *
+ * - int gcdext(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headG, DList **headX, DList **headY):
+ *     Computes the greatest common divisor and its Bezout cofactors.
+ *
+ * - int modular_inverse(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
+ *     Computes the inverse of the first number modulo the second.
+ *
+ * - int product_of(DList **heads, Node **tails, size_t count, DList **headR):
+ *     Computes the product of `count` large numbers.
+ *
+ * - int factorial(DList *head, Node *tail, DList **headR):
+ *     Computes the factorial of a large number.
+ *
+ * - int binomial(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR):
+ *     Computes the binomial coefficient "first choose second".
+ *
  * - int compare_dlists(DList *lst1, DList *lst2):
- *     Compares two large numbers represented as doubly linked lists.
+ *     Compares two large numbers represented as doubly linked lists; neither list is modified.
+ *
+ * - int evaluate(char operator, const BigNum *a, const BigNum *b, BigNum *r, const char **error):
+ *     Computes r = a <operator> b, where the operator is one of + - * / % ^ or
+ *     OP_GCD, OP_MODINV or OP_BINOMIAL. On failure returns 0 and points `error`
+ *     at a static message (e.g. "Error: Division by zero").
+ *
+ * - int evaluate_powmod(const BigNum *a, const BigNum *e, const BigNum *m, BigNum *r, const char **error):
+ *     Computes r = a^e mod m without ever forming a^e (see `bn_pow.c`).
+ *
+ * - int evaluate_factorial(const BigNum *n, BigNum *r, const char **error):
+ *     Computes r = n!, refusing negative n and results beyond the size limit of `^`.
+ *
+ * - int evaluate_product(const BigNum *const *factors, size_t count, BigNum *r, const char **error):
+ *     Computes the product of count >= 1 numbers (see `bn_prod.c`).
+ *
+ * - int evaluate_fixed(const BnFixedOps *f, char operator, uint64_t *r, const uint64_t *a, const uint64_t *b, const char **error):
+ *     Computes r = a <operator> b on fixed-width values, modulo 2^bits (see `bn_fixed.h`).
+ *
+ * - int evaluate_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m, const char **error):
+ *     Computes r = a^e mod m on fixed-width values.
  *
  * Usage:
  * - Include this header in any program requiring arbitrary precision arithmetic operations.
@@ -58,6 +123,14 @@
 #define OPERATIONS_H
 
 #include "dlist.h"
+#include "bignum.h"
+#include "bn_fixed.h"
+
+// Operators of evaluate() for the named functions; the expression parser uses the same codes as node kinds
+#define OP_GCD 'g'              // gcd(a, b)
+#define OP_MODINV 'i'           // modinv(a, m)
+#define OP_BINOMIAL 'c'         // binomial(n, k)
+#define OP_PRODUCT 'm'          // product(a, b, ...), the operator its statistics are recorded under
 
 // Function declarations
 int addition(DList **head1, Node *tail1, DList **head2, Node *tail2, DList **headR);
@@ -65,6 +138,21 @@ int subtraction(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **he
 int multiplication(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR);
 int division(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR);
 int modulus(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR);
+int divmod(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headQ, DList **headRem);
+int gcd(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR);
+int gcdext(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headG, DList **headX, DList **headY);
+int modular_inverse(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR);
+int product_of(DList **heads, Node **tails, size_t count, DList **headR);
+int factorial(DList *head, Node *tail, DList **headR);
+int binomial(DList *head1, Node *tail1, DList *head2, Node *tail2, DList **headR);
 int compare_dlists(DList *lst1, DList *lst2);
+int evaluate(char operator, const BigNum *a, const BigNum *b, BigNum *r, const char **error);
+int evaluate_powmod(const BigNum *a, const BigNum *e, const BigNum *m, BigNum *r, const char **error);
+int evaluate_factorial(const BigNum *n, BigNum *r, const char **error);
+int evaluate_product(const BigNum *const *factors, size_t count, BigNum *r, const char **error);
+int evaluate_fixed(const BnFixedOps *f, char operator, uint64_t *r, const uint64_t *a, const uint64_t *b,
+                   const char **error);
+int evaluate_fixed_powmod(const BnFixedOps *f, uint64_t *r, const uint64_t *a, const uint64_t *e, const uint64_t *m,
+                          const char **error);
 
 #endif // OPERATIONS_H
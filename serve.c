@@ -0,0 +1,722 @@
+/*
+ * File: serve.c
+ * Description: Server mode: evaluates expressions sent by clients over a Unix
+ *              domain socket (the protocol is described in `serve.h`).
+ *
+ * One event-loop thread owns every socket. It accepts clients, cuts the bytes
+ * they send into request frames and writes the response frames back, all
+ * non-blocking through epoll. A pool of worker threads evaluates the requests.
+ * A connection with unanswered requests sits on the run queue at most once,
+ * and the worker that takes it answers its requests in order, so pipelined
+ * requests are answered in the order they were sent while different clients
+ * are evaluated in parallel. After SERVE_MAX_RUN requests a worker puts the
+ * connection back at the end of the queue, so one busy client cannot starve
+ * the others.
+ *
+ * Workers keep their expression trees and evaluation temporaries from request
+ * to request, and the multiplication thread pool lives as long as the server,
+ * so steady-state requests allocate little beyond their results. Each
+ * connection owns its variables and `ans`; they are swapped into the worker's
+ * environment while it evaluates that connection's requests.
+ *
+ * Responses are rendered straight into their frames by the workers and handed
+ * back to the loop through an eventfd; the loop writes as many queued frames
+ * as the socket takes in one call. A client that stops reading its responses
+ * stops being read from once SERVE_MAX_PENDING requests are unanswered.
+ * SIGINT and SIGTERM are turned into a byte on a pipe the loop watches (the
+ * multiplication pool may already be running with them unblocked, so any
+ * thread can take them) and stop the server cleanly.
+ *
+ * Functions:
+ * - int run_server(const char *path, int threads, int width, const char *cache):
+ *     Serves expressions on a Unix domain socket until SIGINT or SIGTERM.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "serve.h"
+#include "bignum.h"
+#include "input.h"
+#include "expr.h"
+
+#define SERVE_READ_CHUNK 65536          // Bytes read from a socket at a time
+#define SERVE_MAX_REQUEST (8u << 20)    // Longest request payload; a longer one closes the connection
+#define SERVE_MAX_RESPONSE 0xfffffff0u // Longest result text the length prefix can describe
+#define SERVE_MAX_PENDING 1024          // Unanswered requests per client before it stops being read
+#define SERVE_MAX_RUN 64                // Requests a worker answers for one client before others get a turn
+#define SERVE_MAX_EVENTS 64             // Events taken from epoll at a time
+#define SERVE_MAX_IOV 64                // Response frames written by one call
+#define SERVE_HEADER 4                  // Bytes of the length prefix
+
+// A request payload, or a complete response frame (length prefix, status byte, text)
+typedef struct Frame {
+    struct Frame *next;
+    size_t len;             // Bytes in `data`
+    size_t done;            // Bytes received (requests) or written (responses) so far
+    size_t cap;             // Bytes allocated for `data` while a request is arriving
+    char data[];
+} Frame;
+
+typedef struct Connection {
+    int fd;
+    unsigned events;                    // Events registered with epoll, 0 if not registered
+    unsigned char header[SERVE_HEADER]; // Length prefix of the next request
+    size_t header_len;
+    Frame *receiving;                   // Request whose payload is still arriving
+    int closing;                        // The client stopped sending or the connection failed
+    int failed;                         // Responses can no longer be delivered
+    int blocked;                        // The socket did not take all queued responses
+
+    // Guarded by the server lock
+    Frame *requests, *requests_tail;    // Complete requests not yet taken by a worker
+    Frame *responses, *responses_tail;  // Responses not yet completely written
+    size_t pending;                     // Requests received and not yet completely answered
+    int busy;                           // On the run queue or held by a worker
+    int notified;                       // On the loop's notify list
+    int lost;                           // A response could not be produced
+    struct Connection *next_run;
+    struct Connection *next_notify;
+
+    // Session state, used only by the worker holding the connection
+    ExprVariable *variables;
+    size_t variable_count, variable_cap;
+    BigNum ans;
+
+    struct Connection *prev, *next;     // Every open connection (event loop only)
+} Connection;
+
+typedef struct Server {
+    int listen_fd, epoll_fd, wake_fd, signal_fd;  // signal_fd: read end of the signal pipe
+    int width;                          // Fixed width in bits, or 0 for BigNums
+    const char *cache;                  // Directory of the result cache, or NULL
+    Connection *connections;            // Open connections (event loop only)
+    Connection *closed;                 // Closed connections to free after the current events
+    char chunk[SERVE_READ_CHUNK];       // Read buffer of the event loop
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;          // A connection was queued or the server is stopping
+    Connection *run_head, *run_tail;    // Connections with requests for the workers
+    Connection *notify;                 // Connections with new responses, or just released by a worker
+    int stopping;
+} Server;
+
+// Free a list of frames
+static void serve_free_frames(Frame *f) {
+    while (f != NULL) {
+        Frame *next = f->next;
+        free(f);
+        f = next;
+    }
+}
+
+static int serve_signal_pipe = -1;     // Write end of the signal pipe
+
+// Signal handler: wake the loop to stop the server
+static void serve_stop(int sig) {
+    int saved = errno;
+    (void)sig;
+    if (write(serve_signal_pipe, "", 1) < 0) {
+        // The pipe is full, so a stop is already pending
+    }
+    errno = saved;
+}
+
+// Put a connection on the loop's notify list and wake the loop; called with the lock held
+static void serve_notify(Server *server, Connection *conn) {
+    if (!conn->notified) {
+        uint64_t one = 1;
+        conn->notified = 1;
+        conn->next_notify = server->notify;
+        server->notify = conn;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+            // The counter is already nonzero, so the loop will wake anyway
+        }
+    }
+}
+
+// Append a connection to the run queue; called with the lock held
+static void serve_schedule(Server *server, Connection *conn) {
+    conn->next_run = NULL;
+    if (server->run_tail != NULL) {
+        server->run_tail->next_run = conn;
+    } else {
+        server->run_head = conn;
+    }
+    server->run_tail = conn;
+    pthread_cond_signal(&server->work_ready);
+}
+
+// Exchange a connection's variables and `ans` with those of a worker's environment
+static void serve_swap_session(ExprEnv *env, Connection *conn) {
+    ExprVariable *variables = env->variables;
+    size_t count = env->variable_count;
+    size_t cap = env->variable_cap;
+
+    env->variables = conn->variables;
+    env->variable_count = conn->variable_count;
+    env->variable_cap = conn->variable_cap;
+    conn->variables = variables;
+    conn->variable_count = count;
+    conn->variable_cap = cap;
+    bn_swap(&env->ans, &conn->ans);
+}
+
+// A response frame with room for `text_len` bytes of text after the status byte
+static Frame *serve_response(size_t text_len) {
+    Frame *f = (Frame *)malloc(sizeof(Frame) + SERVE_HEADER + 1 + text_len);
+    if (f != NULL) {
+        f->next = NULL;
+        f->done = 0;
+    }
+    return f;
+}
+
+// Fill in the length prefix and status byte of a response with `text_len` bytes of text
+static Frame *serve_finish_response(Frame *f, int failed, size_t text_len) {
+    size_t payload = 1 + text_len;
+    f->data[0] = (char)(payload >> 24);
+    f->data[1] = (char)(payload >> 16);
+    f->data[2] = (char)(payload >> 8);
+    f->data[3] = (char)payload;
+    f->data[SERVE_HEADER] = (char)failed;
+    f->len = SERVE_HEADER + payload;
+    return f;
+}
+
+// Parse, evaluate and render one request; returns NULL only when out of memory
+static Frame *serve_evaluate(const Frame *request, Expr *expr, ExprEnv *env) {
+    InputSource src;
+    const char *error = NULL;
+    Frame *f;
+
+    input_open_memory(&src, request->data, request->len);
+    if (input_read_expression(&src, expr) != 1 || src.pos < src.len) {
+        error = "Invalid Input Format."; // Malformed, empty, or more than one line
+    } else if (expr_evaluate(expr, env, &error)) {
+        size_t size = bn_decimal_size(&env->ans);
+        f = (size < SERVE_MAX_RESPONSE) ? serve_response(size) : NULL;
+        if (f != NULL) {
+            return serve_finish_response(f, 0, bn_to_chars(f->data + SERVE_HEADER + 1, &env->ans));
+        }
+        error = (size < SERVE_MAX_RESPONSE) ? "Error: Out of memory" : "Error: Result too large";
+    }
+
+    size_t len = strlen(error);
+    f = serve_response(len);
+    if (f == NULL) {
+        return NULL;
+    }
+    memcpy(f->data + SERVE_HEADER + 1, error, len);
+    return serve_finish_response(f, 1, len);
+}
+
+// Worker thread: take connections from the run queue and answer their requests in order
+static void *serve_worker(void *arg) {
+    Server *server = (Server *)arg;
+    Expr expr;
+    ExprEnv env;
+    expr_init(&expr);
+    expr_env_init(&env);
+    expr_env_set_width(&env, server->width);
+    expr_env_set_cache(&env, server->cache);
+
+    pthread_mutex_lock(&server->lock);
+    for (;;) {
+        while (server->run_head == NULL && !server->stopping) {
+            pthread_cond_wait(&server->work_ready, &server->lock);
+        }
+        if (server->stopping) {
+            break;
+        }
+        Connection *conn = server->run_head;
+        server->run_head = conn->next_run;
+        if (server->run_head == NULL) {
+            server->run_tail = NULL;
+        }
+
+        serve_swap_session(&env, conn);
+        for (int answered = 0; answered < SERVE_MAX_RUN && conn->requests != NULL && !server->stopping; answered++) {
+            Frame *request = conn->requests;
+            conn->requests = request->next;
+            if (conn->requests == NULL) {
+                conn->requests_tail = NULL;
+            }
+            pthread_mutex_unlock(&server->lock);
+
+            Frame *response = serve_evaluate(request, &expr, &env);
+            free(request);
+
+            pthread_mutex_lock(&server->lock);
+            if (response == NULL) {
+                // A missing response would shift every later one: answer no more and close
+                for (Frame *f = conn->requests; f != NULL; f = f->next) {
+                    conn->pending--;
+                }
+                serve_free_frames(conn->requests);
+                conn->requests = conn->requests_tail = NULL;
+                conn->pending--;
+                conn->lost = 1;
+            } else if (conn->responses_tail != NULL) {
+                conn->responses_tail->next = response;
+                conn->responses_tail = response;
+            } else {
+                conn->responses = conn->responses_tail = response;
+            }
+            serve_notify(server, conn);
+        }
+        serve_swap_session(&env, conn);
+
+        if (conn->requests != NULL && !server->stopping) {
+            serve_schedule(server, conn); // Back of the queue; still busy
+        } else {
+            conn->busy = 0;
+            serve_notify(server, conn); // The loop may be waiting to close it
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    expr_free(&expr);
+    expr_env_free(&env);
+    return NULL;
+}
+
+// Release a connection that no worker holds
+static void serve_free_connection(Connection *conn) {
+    serve_free_frames(conn->receiving);
+    serve_free_frames(conn->requests);
+    serve_free_frames(conn->responses);
+    for (size_t i = 0; i < conn->variable_count; i++) {
+        bn_free(&conn->variables[i].value);
+    }
+    free(conn->variables);
+    bn_free(&conn->ans);
+    free(conn);
+}
+
+// Queue a complete request for the workers
+static void serve_queue_request(Server *server, Connection *conn, Frame *request) {
+    pthread_mutex_lock(&server->lock);
+    if (conn->requests_tail != NULL) {
+        conn->requests_tail->next = request;
+    } else {
+        conn->requests = request;
+    }
+    conn->requests_tail = request;
+    conn->pending++;
+    if (!conn->busy) {
+        conn->busy = 1;
+        serve_schedule(server, conn);
+    }
+    pthread_mutex_unlock(&server->lock);
+}
+
+// Cut received bytes into request frames; returns 0 for an oversized request or when out of memory
+static int serve_receive(Server *server, Connection *conn, const char *bytes, size_t len) {
+    for (;;) {
+        if (conn->receiving == NULL) {
+            while (conn->header_len < SERVE_HEADER && len > 0) {
+                conn->header[conn->header_len++] = (unsigned char)*bytes++;
+                len--;
+            }
+            if (conn->header_len < SERVE_HEADER) {
+                return 1;
+            }
+            size_t size = ((size_t)conn->header[0] << 24) | ((size_t)conn->header[1] << 16) |
+                          ((size_t)conn->header[2] << 8) | conn->header[3];
+            if (size > SERVE_MAX_REQUEST) {
+                return 0;
+            }
+            // Storage grows with the bytes that arrive, not with the length the client claims
+            size_t cap = (size < SERVE_READ_CHUNK) ? size : SERVE_READ_CHUNK;
+            conn->receiving = (Frame *)malloc(sizeof(Frame) + cap);
+            if (conn->receiving == NULL) {
+                return 0;
+            }
+            conn->receiving->next = NULL;
+            conn->receiving->len = size;
+            conn->receiving->done = 0;
+            conn->receiving->cap = cap;
+            conn->header_len = 0;
+        }
+
+        Frame *request = conn->receiving;
+        size_t take = (request->len - request->done < len) ? request->len - request->done : len;
+        if (request->done + take > request->cap) {
+            size_t cap = (2 * request->cap < request->len) ? 2 * request->cap : request->len;
+            if (cap < request->done + take) {
+                cap = request->done + take;
+            }
+            request = (Frame *)realloc(request, sizeof(Frame) + cap);
+            if (request == NULL) {
+                return 0; // The old frame stays in conn->receiving and is freed with the connection
+            }
+            request->cap = cap;
+            conn->receiving = request;
+        }
+        memcpy(request->data + request->done, bytes, take);
+        request->done += take;
+        bytes += take;
+        len -= take;
+        if (request->done < request->len) {
+            return 1;
+        }
+        conn->receiving = NULL;
+        serve_queue_request(server, conn, request);
+        if (len == 0) {
+            return 1;
+        }
+    }
+}
+
+// Read what the client has sent
+static void serve_read(Server *server, Connection *conn) {
+    ssize_t got = recv(conn->fd, server->chunk, sizeof(server->chunk), 0);
+    if (got > 0) {
+        if (!serve_receive(server, conn, server->chunk, (size_t)got)) {
+            conn->closing = conn->failed = 1;
+        }
+    } else if (got == 0) {
+        conn->closing = 1; // Answer what was sent, then close
+    } else if (errno != EAGAIN && errno != EINTR) {
+        conn->closing = conn->failed = 1;
+    }
+}
+
+// Write queued responses until the socket is full; failed connections discard them
+static void serve_flush(Server *server, Connection *conn) {
+    for (;;) {
+        struct iovec iov[SERVE_MAX_IOV];
+        size_t count = 0;
+
+        pthread_mutex_lock(&server->lock);
+        for (Frame *f = conn->responses; f != NULL && count < SERVE_MAX_IOV; f = f->next) {
+            iov[count].iov_base = f->data + f->done;
+            iov[count].iov_len = f->len - f->done;
+            count++;
+        }
+        pthread_mutex_unlock(&server->lock);
+        if (count == 0) {
+            conn->blocked = 0;
+            return;
+        }
+
+        size_t sent = 0;
+        if (!conn->failed) {
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = count };
+            ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EINTR) {
+                    conn->blocked = (errno == EAGAIN);
+                    return;
+                }
+                conn->closing = conn->failed = 1;
+                continue;
+            }
+            sent = (size_t)n;
+        }
+
+        // Drop the frames written completely (all of them once the connection has failed)
+        pthread_mutex_lock(&server->lock);
+        while (conn->responses != NULL) {
+            Frame *f = conn->responses;
+            size_t left = f->len - f->done;
+            if (!conn->failed && sent < left) {
+                f->done += sent;
+                break;
+            }
+            sent -= conn->failed ? 0 : left;
+            conn->responses = f->next;
+            if (conn->responses == NULL) {
+                conn->responses_tail = NULL;
+            }
+            conn->pending--;
+            free(f);
+            if (!conn->failed && --count == 0) {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&server->lock);
+    }
+}
+
+// Close a connection once it is finished, otherwise register the events it needs
+static void serve_update(Server *server, Connection *conn) {
+    pthread_mutex_lock(&server->lock);
+    if (conn->lost) {
+        conn->closing = 1; // Deliver the responses produced so far, then close
+    }
+    if (conn->failed) {
+        // Nothing more can be delivered: forget the requests no worker has taken
+        for (Frame *f = conn->requests; f != NULL; f = f->next) {
+            conn->pending--;
+        }
+        serve_free_frames(conn->requests);
+        conn->requests = conn->requests_tail = NULL;
+    }
+    int idle = !conn->busy && !conn->notified;
+    int finished = conn->closing && idle && conn->pending == 0;
+    size_t pending = conn->pending;
+    pthread_mutex_unlock(&server->lock);
+
+    if (finished) {
+        close(conn->fd);
+        conn->fd = -1;
+        if (conn->prev != NULL) {
+            conn->prev->next = conn->next;
+        } else {
+            server->connections = conn->next;
+        }
+        if (conn->next != NULL) {
+            conn->next->prev = conn->prev;
+        }
+        conn->next = server->closed;
+        server->closed = conn;
+        return;
+    }
+
+    unsigned events = 0;
+    if (!conn->closing && pending < SERVE_MAX_PENDING) {
+        events |= EPOLLIN;
+    }
+    if (conn->blocked && !conn->failed) {
+        events |= EPOLLOUT;
+    }
+    if (events != conn->events) {
+        // A connection waiting for nothing is removed, so a hang-up cannot wake the loop over and over
+        struct epoll_event ev = { .events = events, .data.ptr = conn };
+        int op = (events == 0) ? EPOLL_CTL_DEL : (conn->events == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        epoll_ctl(server->epoll_fd, op, conn->fd, &ev);
+        conn->events = events;
+    }
+}
+
+// Accept every waiting client
+static void serve_accept(Server *server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        Connection *conn = (Connection *)calloc(1, sizeof(Connection));
+        if (conn == NULL) {
+            close(fd);
+            return;
+        }
+        conn->fd = fd;
+        bn_init(&conn->ans);
+        conn->next = server->connections;
+        if (conn->next != NULL) {
+            conn->next->prev = conn;
+        }
+        server->connections = conn;
+        serve_update(server, conn);
+    }
+}
+
+// Deliver what the workers produced and close connections they have released
+static void serve_wake(Server *server) {
+    uint64_t count;
+    if (read(server->wake_fd, &count, sizeof(count)) < 0) {
+        // Nothing to read: another wake-up already took the notifications
+    }
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        Connection *conn = server->notify;
+        if (conn != NULL) {
+            server->notify = conn->next_notify;
+            conn->notified = 0;
+        }
+        pthread_mutex_unlock(&server->lock);
+        if (conn == NULL) {
+            return;
+        }
+        serve_flush(server, conn);
+        serve_update(server, conn);
+    }
+}
+
+// Create the listening socket, replacing a stale socket file left at `path`
+static int serve_listen(const char *path) {
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Error: Socket path too long\n");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        printf("Error: Cannot listen on '%s'\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Register a descriptor of the server itself; `tag` identifies it in events
+static int serve_watch(Server *server, int fd, void *tag) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = tag };
+    return fd >= 0 && epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+// Serve expressions on a Unix domain socket until SIGINT or SIGTERM
+int run_server(const char *path, int threads, int width, const char *cache) {
+    struct sigaction stop, saved_int, saved_term;
+    int signal_pipe[2] = { -1, -1 };
+    pthread_t *pool;
+    Server *server;
+    int started = 0;
+    int ok = 1;
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int)cpus : 1;
+    }
+    server = (Server *)calloc(1, sizeof(Server));
+    pool = (pthread_t *)malloc((size_t)threads * sizeof(pthread_t));
+    if (server == NULL || pool == NULL) {
+        printf("Error: Out of memory\n");
+        free(server);
+        free(pool);
+        return 0;
+    }
+
+    // SIGINT and SIGTERM write to a pipe; the loop stops when it becomes readable
+    if (pipe2(signal_pipe, O_NONBLOCK | O_CLOEXEC) == 0) {
+        serve_signal_pipe = signal_pipe[1];
+    }
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = serve_stop;
+    stop.sa_flags = SA_RESTART;
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, &saved_int);
+    sigaction(SIGTERM, &stop, &saved_term);
+
+    server->width = width;
+    server->cache = cache;
+    server->listen_fd = serve_listen(path);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    server->signal_fd = signal_pipe[0];
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->work_ready, NULL);
+    if (server->listen_fd < 0) {
+        ok = 0;
+    } else if (server->epoll_fd < 0 ||
+               !serve_watch(server, server->listen_fd, &server->listen_fd) ||
+               !serve_watch(server, server->wake_fd, &server->wake_fd) ||
+               !serve_watch(server, server->signal_fd, &server->signal_fd)) {
+        printf("Error: Cannot start the event loop\n");
+        ok = 0;
+    }
+    for (int i = 0; ok && i < threads; i++) {
+        if (pthread_create(&pool[started], NULL, serve_worker, server) == 0) {
+            started++;
+        }
+    }
+    if (ok && started == 0) {
+        printf("Error: Cannot start worker threads\n");
+        ok = 0;
+    }
+
+    while (ok) {
+        struct epoll_event events[SERVE_MAX_EVENTS];
+        int n = epoll_wait(server->epoll_fd, events, SERVE_MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR) {
+            printf("Error: Event loop failed\n");
+            ok = 0;
+            break;
+        }
+        int stop = 0;
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &server->listen_fd) {
+                serve_accept(server);
+            } else if (tag == &server->wake_fd) {
+                serve_wake(server);
+            } else if (tag == &server->signal_fd) {
+                stop = 1;
+            } else {
+                Connection *conn = (Connection *)tag;
+                if (conn->fd < 0) {
+                    continue; // Closed earlier in this round
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    serve_read(server, conn);
+                }
+                if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                    serve_flush(server, conn);
+                }
+                serve_update(server, conn);
+            }
+        }
+        while (server->closed != NULL) {
+            Connection *conn = server->closed;
+            server->closed = conn->next;
+            serve_free_connection(conn);
+        }
+        if (stop) {
+            break;
+        }
+    }
+
+    // Workers stop between requests; then no connection is held and all can be freed
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_cond_broadcast(&server->work_ready);
+    pthread_mutex_unlock(&server->lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    while (server->connections != NULL) {
+        Connection *conn = server->connections;
+        server->connections = conn->next;
+        close(conn->fd);
+        serve_free_connection(conn);
+    }
+
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        unlink(path);
+    }
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    if (server->wake_fd >= 0) {
+        close(server->wake_fd);
+    }
+    sigaction(SIGINT, &saved_int, NULL);
+    sigaction(SIGTERM, &saved_term, NULL);
+    serve_signal_pipe = -1;
+    if (signal_pipe[0] >= 0) {
+        close(signal_pipe[0]);
+        close(signal_pipe[1]);
+    }
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->work_ready);
+    free(server);
+    free(pool);
+    return ok;
+}
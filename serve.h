@@ -0,0 +1,36 @@
+/*
+ * File: serve.h
+ * Description: Header file for the long-running server mode.
+ *
+ * `apc --serve PATH` listens on a Unix domain socket at PATH and evaluates
+ * expressions sent by any number of local clients, so a caller pays for one
+ * connect instead of one process start per expression.
+ *
+ * Protocol: every message in either direction is a frame made of a 4-byte
+ * big-endian payload length followed by the payload.
+ * - A request payload is one expression line (see `input.h`), with or without
+ *   a trailing newline.
+ * - A response payload is a status byte, 0 for success or 1 for failure,
+ *   followed by the decimal result or the error message (no newline).
+ * A client may send any number of requests without waiting (pipelining); the
+ * responses come back in the order of the requests. Each connection has its
+ * own variables and `ans`, kept until it closes. Requests over 8 MiB close
+ * the connection.
+ *
+ * Function Declarations:
+ * - int run_server(const char *path, int threads, int width, const char *cache):
+ *     Serves on the socket at `path` with `threads` worker threads (0 picks
+ *     one per online CPU) until SIGINT or SIGTERM, then removes the socket.
+ *     A nonzero `width` evaluates on fixed-width values (see
+ *     `expr_env_set_width`), and a non-NULL `cache` keeps large results in
+ *     that directory (see `cache.h`). Returns 0 if the server could not be
+ *     started.
+*/
+
+#ifndef SERVE_H
+#define SERVE_H
+
+// Function declarations
+int run_server(const char *path, int threads, int width, const char *cache);
+
+#endif // SERVE_H
@@ -0,0 +1,222 @@
+/*
+ * File: stats.c
+ * Description: Operation statistics collected when built with APC_STATS.
+ *
+ * Each thread keeps the record of the operation it is evaluating in
+ * thread-local storage, so recording a tier or an allocation is a plain
+ * increment. When an operation ends its record is added to per-operator totals
+ * under a mutex, once per operation.
+ *
+ * Allocations are counted by the allocator wrappers of `alloc_count.c`, which
+ * the statistics build links in. An operation's allocations and peak heap
+ * growth are the difference between the counts of its thread when it begins
+ * and when it ends.
+ *
+ * Functions:
+ * - void stats_begin(char operator, const BigNum *a, const BigNum *b): Starts an operation.
+ * - void stats_end(const BigNum *r, int ok): Ends it and updates the totals.
+ * - void stats_tier(StatsTier tier): Counts one use of an algorithm tier.
+ * - void stats_node(void): Counts one DList node.
+ * - void stats_set_trace(FILE *fp): Enables per-operation lines.
+ * - void stats_report(FILE *fp): Prints the totals as text.
+ * - int stats_write_json(const char *path): Writes the totals as JSON.
+*/
+
+#include "stats.h"
+
+#ifdef APC_STATS
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "alloc_count.h"
+
+static const char *const tier_names[STATS_TIER_COUNT] = {
+    "basecase", "karatsuba", "toom3", "ntt", "ntt_parallel", "short_division", "knuth", "newton", "native",
+    "binary_gcd", "lehmer", "hgcd"
+};
+
+// Record of the operation running on one thread
+typedef struct OpRecord {
+    char operator;
+    size_t digits_a, digits_b;
+    double start;
+    AllocCounts heap;           // Allocation counts of this thread when the operation began
+    size_t tiers[STATS_TIER_COUNT];
+} OpRecord;
+
+// Totals for one operator
+typedef struct OpTotals {
+    size_t count, failed;
+    double seconds, max_seconds;
+    size_t digits_in, digits_out;
+    size_t allocs, bytes;
+    long long max_peak;
+    size_t tiers[STATS_TIER_COUNT];
+} OpTotals;
+
+static __thread OpRecord current;
+static OpTotals totals[256];
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace = NULL;
+
+static size_t list_nodes = 0;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Exact number of decimal digits of n (0 for zero)
+static size_t digit_count(const BigNum *n) {
+    if (n->len == 0) {
+        return 0;
+    }
+    size_t digits = (n->len - 1) * BN_BASE_DIGITS;
+    for (limb_t top = n->limbs[n->len - 1]; top > 0; top /= 10) {
+        digits++;
+    }
+    return digits;
+}
+
+// Start recording an operation on the calling thread
+void stats_begin(char operator, const BigNum *a, const BigNum *b) {
+    current.operator = operator;
+    current.digits_a = digit_count(a);
+    current.digits_b = digit_count(b);
+    alloc_reset_peak();
+    alloc_thread(&current.heap);
+    memset(current.tiers, 0, sizeof(current.tiers));
+    current.start = now();
+}
+
+// Finish the operation started on this thread and add it to the totals
+void stats_end(const BigNum *r, int ok) {
+    double seconds = now() - current.start;
+    size_t digits_r = ok ? digit_count(r) : 0;
+    AllocCounts heap;
+    alloc_thread(&heap);
+    size_t allocs = heap.count - current.heap.count, bytes = heap.bytes - current.heap.bytes;
+    long long peak = heap.peak - current.heap.live;
+    OpTotals *t = &totals[(unsigned char)current.operator];
+
+    pthread_mutex_lock(&totals_lock);
+    t->count++;
+    t->failed += !ok;
+    t->seconds += seconds;
+    t->max_seconds = (seconds > t->max_seconds) ? seconds : t->max_seconds;
+    t->digits_in += current.digits_a + current.digits_b;
+    t->digits_out += digits_r;
+    t->allocs += allocs;
+    t->bytes += bytes;
+    t->max_peak = (peak > t->max_peak) ? peak : t->max_peak;
+    for (int i = 0; i < STATS_TIER_COUNT; i++) {
+        t->tiers[i] += current.tiers[i];
+    }
+    if (trace != NULL) {
+        fprintf(trace, "stats: %zu %c %zu digits -> %zu digits%s, %.1f us, %zu allocs (%zu bytes), peak %lld bytes",
+                current.digits_a, current.operator, current.digits_b, digits_r, ok ? "" : " (failed)",
+                seconds * 1e6, allocs, bytes, peak);
+        const char *separator = ", tiers:";
+        for (int i = 0; i < STATS_TIER_COUNT; i++) {
+            if (current.tiers[i] > 0) {
+                fprintf(trace, "%s %s x%zu", separator, tier_names[i], current.tiers[i]);
+                separator = ",";
+            }
+        }
+        fputc('\n', trace);
+    }
+    pthread_mutex_unlock(&totals_lock);
+}
+
+void stats_tier(StatsTier tier) {
+    current.tiers[tier]++;
+}
+
+void stats_node(void) {
+    __atomic_add_fetch(&list_nodes, 1, __ATOMIC_RELAXED);
+}
+
+// Print one line per operation to fp, or nothing if fp is NULL
+void stats_set_trace(FILE *fp) {
+    trace = fp;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    return (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : 0;
+}
+
+// Print the per-operator totals
+void stats_report(FILE *fp) {
+    AllocCounts heap;
+    alloc_totals(&heap);
+    pthread_mutex_lock(&totals_lock);
+    fprintf(fp, "%-8s %10s %8s %14s %14s %14s %12s %14s\n",
+            "operator", "count", "failed", "total ms", "mean us", "max us", "allocs", "max peak");
+    for (int op = 0; op < 256; op++) {
+        const OpTotals *t = &totals[op];
+        if (t->count == 0) {
+            continue;
+        }
+        fprintf(fp, "%-8c %10zu %8zu %14.3f %14.1f %14.1f %12zu %14lld\n",
+                op, t->count, t->failed, t->seconds * 1e3, t->seconds * 1e6 / t->count,
+                t->max_seconds * 1e6, t->allocs, t->max_peak);
+        int listed = 0;
+        for (int i = 0; i < STATS_TIER_COUNT; i++) {
+            if (t->tiers[i] > 0) {
+                fprintf(fp, "%s %s x%zu", listed ? "," : "         tiers:", tier_names[i], t->tiers[i]);
+                listed = 1;
+            }
+        }
+        if (listed) {
+            fputc('\n', fp);
+        }
+    }
+    fprintf(fp, "heap: %zu allocations, %zu bytes, peak %lld bytes; peak RSS %ld KB; list nodes %zu\n",
+            heap.count, heap.bytes, heap.peak, peak_rss_kb(), list_nodes);
+    pthread_mutex_unlock(&totals_lock);
+}
+
+// Write the totals to a file as JSON; returns 0 if the file cannot be written
+int stats_write_json(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("Error: Cannot open %s\n", path);
+        return 0;
+    }
+
+    AllocCounts heap;
+    alloc_totals(&heap);
+    pthread_mutex_lock(&totals_lock);
+    const char *separator = "\n    ";
+    fprintf(fp, "{\n  \"operations\": [");
+    for (int op = 0; op < 256; op++) {
+        const OpTotals *t = &totals[op];
+        if (t->count == 0) {
+            continue;
+        }
+        fprintf(fp, "%s{\"operator\": \"%c\", \"count\": %zu, \"failed\": %zu, \"total_ns\": %.0f, "
+                    "\"mean_ns\": %.0f, \"max_ns\": %.0f, \"digits_in\": %zu, \"digits_out\": %zu, "
+                    "\"allocs\": %zu, \"bytes\": %zu, \"max_peak_bytes\": %lld, \"tiers\": {",
+                separator, op, t->count, t->failed, t->seconds * 1e9, t->seconds * 1e9 / t->count,
+                t->max_seconds * 1e9, t->digits_in, t->digits_out, t->allocs, t->bytes, t->max_peak);
+        for (int i = 0; i < STATS_TIER_COUNT; i++) {
+            fprintf(fp, "%s\"%s\": %zu", (i > 0) ? ", " : "", tier_names[i], t->tiers[i]);
+        }
+        fprintf(fp, "}}");
+        separator = ",\n    ";
+    }
+    fprintf(fp, "\n  ],\n  \"heap_allocations\": %zu,\n  \"heap_bytes\": %zu,\n  \"heap_peak_bytes\": %lld,\n"
+                "  \"peak_rss_kb\": %ld,\n  \"list_nodes\": %zu\n}\n",
+            heap.count, heap.bytes, heap.peak, peak_rss_kb(), list_nodes);
+    pthread_mutex_unlock(&totals_lock);
+
+    int ok = !ferror(fp);
+    return (fclose(fp) == 0) && ok;
+}
+
+#endif // APC_STATS
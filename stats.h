@@ -0,0 +1,76 @@
+/*
+ * File: stats.h
+ * Description: Header file for the optional operation statistics (`--stats`).
+ *
+ * The instrumentation is compiled in only when APC_STATS is defined (build with
+ * `make clean && make STATS=1`). Otherwise every STATS_* macro below expands to
+ * nothing, so the hot paths carry no cost at all.
+ *
+ * When enabled, every operator evaluation records its wall time, operand and
+ * result sizes, the heap allocations made by the evaluating thread, the peak
+ * heap growth during the operation and the algorithm tiers that ran (e.g. one
+ * Toom-3 split into Karatsuba and schoolbook products). Allocations are counted
+ * by wrapping malloc, calloc, realloc and free at link time (see
+ * `alloc_count.h`), so no allocation site needs to change. Results are aggregated per operator and can be printed
+ * as text or written as JSON.
+ *
+ * Macros (no-ops without APC_STATS):
+ * - STATS_BEGIN(operator, a, b): Starts recording an operation on this thread.
+ * - STATS_END(r, ok): Finishes the operation and adds it to the totals.
+ * - STATS_TIER(tier): Counts one use of an algorithm tier (StatsTier).
+ * - STATS_NODE(): Counts one DList node handed out.
+ *
+ * Function Declarations (APC_STATS builds only):
+ * - void stats_set_trace(FILE *fp): Prints one line per operation to fp (NULL: off).
+ * - void stats_report(FILE *fp): Prints the per-operator totals.
+ * - int stats_write_json(const char *path): Writes the totals as JSON.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "bignum.h"
+
+// Algorithm tiers that can be chosen inside an operation
+typedef enum StatsTier {
+    STATS_MUL_BASECASE,
+    STATS_MUL_KARATSUBA,
+    STATS_MUL_TOOM3,
+    STATS_MUL_NTT,
+    STATS_MUL_NTT_PARALLEL,
+    STATS_DIV_SHORT,
+    STATS_DIV_KNUTH,
+    STATS_DIV_NEWTON,
+    STATS_NATIVE,
+    STATS_GCD_BINARY,
+    STATS_GCD_LEHMER,
+    STATS_GCD_HGCD,
+    STATS_TIER_COUNT
+} StatsTier;
+
+#ifdef APC_STATS
+
+void stats_begin(char operator, const BigNum *a, const BigNum *b);
+void stats_end(const BigNum *r, int ok);
+void stats_tier(StatsTier tier);
+void stats_node(void);
+void stats_set_trace(FILE *fp);
+void stats_report(FILE *fp);
+int stats_write_json(const char *path);
+
+#define STATS_BEGIN(operator, a, b) stats_begin(operator, a, b)
+#define STATS_END(r, ok) stats_end(r, ok)
+#define STATS_TIER(tier) stats_tier(tier)
+#define STATS_NODE() stats_node()
+
+#else
+
+#define STATS_BEGIN(operator, a, b) ((void)0)
+#define STATS_END(r, ok) ((void)0)
+#define STATS_TIER(tier) ((void)0)
+#define STATS_NODE() ((void)0)
+
+#endif // APC_STATS
+
+#endif // STATS_H